@@ -6,11 +6,14 @@ from pathlib import Path
 from typing import Literal
 
 import numpy as np
-from fastapi import BackgroundTasks, FastAPI, HTTPException
-from fastapi.responses import FileResponse
+from fastapi import FastAPI, HTTPException
+from fastapi.responses import FileResponse, Response
 from pydantic import BaseModel, Field
 
+from sim.frame_archive import FrameArchive
+from sim.lbm_native import NATIVE_AVAILABLE
 from sim.run_store import RunStore
+from sim.scheduler import RunScheduler, estimate_peak_bytes
 from sim.simulate import simulate_run
 
 ROOT = Path(__file__).resolve().parent
@@ -20,6 +23,7 @@ DEFAULT_STL = TEST_CFD / "SmallRiffleLotsFlume.stl"
 
 app = FastAPI(title="Fluid App Backend", version="0.1.0")
 store = RunStore(ROOT / "runs")
+scheduler = RunScheduler(store)
 
 
 class SimRequest(BaseModel):
@@ -28,6 +32,16 @@ class SimRequest(BaseModel):
     sourcePointMm: list[float] = Field(..., min_length=3, max_length=3)
     flowGph: float = Field(default=200.0, ge=0.0)
     quality: Literal["low", "medium", "high"] = "medium"
+    solver: Literal["auto", "torch", "native"] = "auto"
+    precision: Literal["fp32", "fp16", "bf16"] = Field(
+        default="fp32", description="Native solver population storage (fp16/bf16 halve its memory)"
+    )
+    integrator: Literal["euler", "rk2", "rk4"] = Field(
+        default="euler", description="Particle integrator (rk2/rk4 sub-step adaptively, native only)"
+    )
+    ranks: int = Field(
+        default=1, ge=1, le=64, description="Native solver processes (slab decomposition along x, dense layout)"
+    )
 
 
 @app.get("/api/stl")
@@ -39,7 +53,7 @@ def get_stl():
 
 
 @app.post("/api/simulate")
-def start_simulation(req: SimRequest, bg: BackgroundTasks):
+def start_simulation(req: SimRequest):
     stl_path = Path(req.stlPath) if req.stlPath else DEFAULT_STL
     if not stl_path.is_absolute():
         stl_path = (TEST_CFD / stl_path).resolve()
@@ -53,18 +67,31 @@ def start_simulation(req: SimRequest, bg: BackgroundTasks):
             "sourcePointMm": req.sourcePointMm,
             "flowGph": req.flowGph,
             "quality": req.quality,
+            "solver": req.solver,
+            "precision": req.precision,
+            "integrator": req.integrator,
+            "ranks": req.ranks,
         }
     )
 
-    bg.add_task(
+    scheduler.submit(
+        run_id,
         simulate_run,
-        store=store,
-        run_id=run_id,
-        stl_path=str(stl_path),
-        gravity=np.array(req.gravity, dtype=np.float32),
-        source_point_mm=np.array(req.sourcePointMm, dtype=np.float32),
-        flow_gph=float(req.flowGph),
+        dict(
+            store=store,
+            run_id=run_id,
+            stl_path=str(stl_path),
+            gravity=np.array(req.gravity, dtype=np.float32),
+            source_point_mm=np.array(req.sourcePointMm, dtype=np.float32),
+            flow_gph=float(req.flowGph),
+            quality=req.quality,
+            solver=req.solver,
+            precision=req.precision,
+            integrator=req.integrator,
+            ranks=req.ranks,
+        ),
         quality=req.quality,
+        peak_bytes=estimate_peak_bytes(req.quality, req.solver, req.precision),
     )
 
     return {"runId": run_id}
@@ -78,6 +105,16 @@ def run_status(run_id: str):
     return status
 
 
+@app.post("/api/run/{run_id}/cancel")
+def cancel_run(run_id: str):
+    """Drops a queued run or stops a running one at its next checkpoint of progress."""
+    if store.read_status(run_id) is None:
+        raise HTTPException(status_code=404, detail="Unknown runId")
+    if not scheduler.cancel(run_id):
+        raise HTTPException(status_code=409, detail="Run is not queued or running")
+    return {"runId": run_id, "cancelling": True}
+
+
 @app.get("/api/run/{run_id}/result")
 def run_result(run_id: str):
     path = store.result_path(run_id)
@@ -89,10 +126,48 @@ def run_result(run_id: str):
     return FileResponse(str(path), media_type="application/octet-stream", filename=f"{run_id}.npz")
 
 
+@app.get("/api/run/{run_id}/preview")
+def run_preview(run_id: str):
+    """Coarse velocity field of a run still in the LBM phase (see simulate.py)."""
+    path = store.preview_path(run_id)
+    if not path.exists():
+        status = store.read_status(run_id)
+        if status is None:
+            raise HTTPException(status_code=404, detail="Unknown runId")
+        raise HTTPException(status_code=409, detail=f"No preview yet (state={status.get('state')})")
+    return FileResponse(str(path), media_type="application/octet-stream", filename=f"{run_id}-preview.npz")
+
+
+def _frame_archive(run_id: str) -> FrameArchive:
+    path = store.frames_path(run_id)
+    if not path.exists():
+        status = store.read_status(run_id)
+        if status is None:
+            raise HTTPException(status_code=404, detail="Unknown runId")
+        raise HTTPException(status_code=409, detail=f"No frames yet (state={status.get('state')})")
+    return FrameArchive(path)
+
+
+@app.get("/api/run/{run_id}/frames")
+def run_frames_index(run_id: str):
+    """Header and chunk index of the particle frames (see sim/frame_archive.py)."""
+    return _frame_archive(run_id).describe()
+
+
+@app.get("/api/run/{run_id}/frames/{chunk}")
+def run_frames_chunk(run_id: str, chunk: int):
+    try:
+        payload = _frame_archive(run_id).chunk_payload(chunk)
+    except IndexError as ex:
+        raise HTTPException(status_code=404, detail=str(ex))
+    return Response(content=payload, media_type="application/octet-stream")
+
+
 @app.get("/api/health")
 def health():
     return {
         "ok": True,
         "stlExists": DEFAULT_STL.exists(),
         "cudaVisible": os.environ.get("CUDA_VISIBLE_DEVICES", None),
+        "nativeSolver": NATIVE_AVAILABLE,
     }
@@ -0,0 +1,114 @@
+"""
+Particle advection benchmark: native ParticleAdvector vs the numpy/scipy loop.
+
+Builds the STL domain, puts a steady synthetic flow in it (fluid cells move
+from the source towards the outlet) and times advect_particles() both ways at
+each particle count. The two paths draw different random numbers, so the
+clouds are compared statistically: mean distance travelled and centroid of the
+last frame. The native run is repeated to check that its output is bitwise
+reproducible. --integrator picks the native integrator (the numpy loop is
+always Euler).
+
+Run from the backend folder:
+
+    python -m bench.bench_advect                            # 15k/40k/80k particles, 120 frames
+    python -m bench.bench_advect --particles 200000 --frames 60 --skip-python
+    python -m bench.bench_advect --threads 1
+    python -m bench.bench_advect --integrator rk4 --frames 60
+"""
+from __future__ import annotations
+
+import argparse
+import contextlib
+import io
+import sys
+import time
+from pathlib import Path
+
+import numpy as np
+
+import sim.advect as advect
+from sim.domain import build_domain_from_stl
+from sim.lbm_native import NATIVE_AVAILABLE, fluid_native
+
+DEFAULT_STL = Path(__file__).resolve().parents[3] / "SmallRiffleLotsFlume.stl"
+
+
+def synthetic_flow(domain, speed=0.02):
+    """Uniform lattice velocity from the source towards the outlet, zero in solid."""
+    idx = domain.outlet.argwhere()
+    outlet = np.array([domain.x_coords[idx[:, 0]].mean(), domain.y_coords[idx[:, 1]].mean(),
+                       domain.z_coords[idx[:, 2]].mean()], np.float32)
+    d = outlet - np.asarray(domain.source_point_mm, np.float32)
+    d /= np.linalg.norm(d) + 1e-9
+    fluid = (~domain.solid).to_bool().astype(np.float32)
+    return tuple(fluid * (speed * d[k]) for k in range(3))
+
+
+def run(domain, flow, particles, frames, native, integrator="euler", **kwargs):
+    saved = advect.NATIVE_AVAILABLE
+    advect.NATIVE_AVAILABLE = native
+    try:
+        t0 = time.perf_counter()
+        with contextlib.redirect_stdout(io.StringIO()):
+            out = advect.advect_particles(
+                x_coords=domain.x_coords, y_coords=domain.y_coords, z_coords=domain.z_coords,
+                ux=flow[0], uy=flow[1], uz=flow[2], solid=domain.solid,
+                source_point_mm=domain.source_point_mm, gravity_dir=domain.gravity_dir,
+                n_particles=particles, n_frames=frames, integrator=integrator, **kwargs)
+        return out, time.perf_counter() - t0
+    finally:
+        advect.NATIVE_AVAILABLE = saved
+
+
+def summary(frames):
+    travelled = np.linalg.norm(frames[-1] - frames[0], axis=1).mean()
+    centroid = frames[-1].mean(axis=0)
+    return f"travelled {travelled:6.1f}mm  centroid ({centroid[0]:6.1f}, {centroid[1]:6.1f}, {centroid[2]:6.1f})"
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--stl", type=str, default=str(DEFAULT_STL))
+    ap.add_argument("--base-res", type=int, default=192)
+    ap.add_argument("--particles", type=int, nargs="+", default=[15_000, 40_000, 80_000])
+    ap.add_argument("--frames", type=int, default=120)
+    ap.add_argument("--threads", type=int, default=0, help="native OpenMP threads (0 = default)")
+    ap.add_argument("--integrator", choices=["euler", "rk2", "rk4"], default="euler")
+    ap.add_argument("--skip-python", action="store_true", help="time the native path only")
+    args = ap.parse_args()
+
+    if not NATIVE_AVAILABLE:
+        print("[Bench] fluid_native not built - see backend/README.md")
+        return 1
+    if args.threads:
+        fluid_native.set_num_threads(args.threads)
+
+    with contextlib.redirect_stdout(io.StringIO()):
+        probe = build_domain_from_stl(stl_path=args.stl, base_resolution=args.base_res,
+                                      gravity=np.array([0.0, 0.0, -1.0]), source_point_mm=np.zeros(3))
+        lo = np.array([probe.x_coords[0], probe.y_coords[0], probe.z_coords[0]])
+        hi = np.array([probe.x_coords[-1], probe.y_coords[-1], probe.z_coords[-1]])
+        source = np.array([(lo[0] + hi[0]) / 2, (lo[1] + hi[1]) / 2, hi[2] - 0.1 * (hi[2] - lo[2])])
+        domain = build_domain_from_stl(stl_path=args.stl, base_resolution=args.base_res,
+                                       gravity=np.array([0.0, 0.0, -1.0]), source_point_mm=source)
+    flow = synthetic_flow(domain)
+    grid = "x".join(str(n) for n in domain.solid.shape)
+    print(f"[Bench] grid {grid}, {args.frames} frames, {fluid_native.max_threads()} native threads,"
+          f" {args.integrator} integrator")
+
+    print(f"  {'particles':>9s} {'path':7s} {'time':>9s} {'per frame':>10s}  cloud")
+    for n in args.particles:
+        out, secs = run(domain, flow, n, args.frames, native=True, integrator=args.integrator)
+        again, _ = run(domain, flow, n, args.frames, native=True, integrator=args.integrator)
+        repro = "reproducible" if np.array_equal(out, again) else "NOT REPRODUCIBLE"
+        print(f"  {n:9,d} {'native':7s} {secs:8.2f}s {secs / args.frames * 1e3:8.2f}ms  {summary(out)}  {repro}")
+        if not args.skip_python:
+            ref, t_ref = run(domain, flow, n, args.frames, native=False)
+            print(f"  {'':9s} {'python':7s} {t_ref:8.2f}s {t_ref / args.frames * 1e3:8.2f}ms  {summary(ref)}"
+                  f"  ({t_ref / secs:.1f}x)")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,102 @@
+"""
+Particle frame storage benchmark: chunked 16-bit archive vs float32 in savez_compressed.
+
+Advects particles through the synthetic flume flow of bench_advect, then writes
+the frames both ways and reports file size, write time, time to decode every
+frame and time to decode only the first chunk (what a client needs before it
+can start playback), plus the largest position error of the archive. Last,
+advection is rerun writing the archive as frames are produced, the way a run
+streams them, to time the first playable chunk against the whole run.
+
+Run from the backend folder:
+
+    python -m bench.bench_frames                          # 40k particles, 300 frames
+    python -m bench.bench_frames --particles 80000 --frames 600
+"""
+from __future__ import annotations
+
+import argparse
+import contextlib
+import io
+import sys
+import tempfile
+import time
+from pathlib import Path
+
+import numpy as np
+
+from bench.bench_advect import DEFAULT_STL, run, synthetic_flow
+from sim.domain import build_domain_from_stl
+from sim.frame_archive import CHUNK_FRAMES, FrameArchive, FrameArchiveWriter, quantization_step
+from sim.simulate import _frame_bounds
+
+
+def timed(fn):
+    t0 = time.perf_counter()
+    out = fn()
+    return out, time.perf_counter() - t0
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--stl", type=str, default=str(DEFAULT_STL))
+    ap.add_argument("--base-res", type=int, default=128)
+    ap.add_argument("--particles", type=int, default=40_000)
+    ap.add_argument("--frames", type=int, default=300)
+    args = ap.parse_args()
+
+    with contextlib.redirect_stdout(io.StringIO()):
+        domain = build_domain_from_stl(stl_path=args.stl, base_resolution=args.base_res,
+                                       gravity=np.array([0.0, 0.0, -1.0]),
+                                       source_point_mm=np.array([-245.0, -15.0, 120.0]))
+    frames, secs = run(domain, synthetic_flow(domain), args.particles, args.frames,
+                       native=True, integrator="euler")
+    print(f"[Bench] {args.particles:,} particles x {args.frames} frames ({frames.nbytes / 1e6:.0f} MB float32),"
+          f" advected in {secs:.1f}s")
+    lo, hi = _frame_bounds(domain)
+
+    with tempfile.TemporaryDirectory() as tmp:
+        npz_path = Path(tmp) / "frames.npz"
+        _, t_npz_write = timed(lambda: np.savez_compressed(npz_path, frames=frames))
+        _, t_npz_read = timed(lambda: np.load(npz_path)["frames"])
+        npz_bytes = npz_path.stat().st_size
+
+        arc_path = Path(tmp) / "frames.bin"
+
+        def write():
+            w = FrameArchiveWriter(arc_path, n_frames=args.frames, n_particles=args.particles, lo=lo, hi=hi)
+            w.append(frames)
+            w.close()
+
+        _, t_arc_write = timed(write)
+        decoded, t_arc_read = timed(lambda: FrameArchive(arc_path).frames())
+        _, t_first = timed(lambda: FrameArchive(arc_path).chunk(0))
+        arc_bytes = arc_path.stat().st_size
+
+        stream = FrameArchiveWriter(Path(tmp) / "stream.bin", n_frames=args.frames, n_particles=args.particles,
+                                    lo=lo, hi=hi)
+        first_chunk = []
+        t0 = time.perf_counter()
+
+        def publish(block):
+            stream.append(block)
+            if stream.frames_written and not first_chunk:
+                first_chunk.append(time.perf_counter() - t0)
+
+        _, t_stream = run(domain, synthetic_flow(domain), args.particles, args.frames, native=True,
+                          integrator="euler", frame_batch=CHUNK_FRAMES, on_frames=publish)
+        stream.close()
+
+    err = float(np.abs(decoded - frames).max())
+    print(f"  {'format':10s} {'size':>9s} {'write':>8s} {'decode all':>11s} {'first chunk':>12s}")
+    print(f"  {'npz f32':10s} {npz_bytes / 1e6:7.1f}MB {t_npz_write:7.2f}s {t_npz_read:10.2f}s {t_npz_read:11.2f}s")
+    print(f"  {'chunked':10s} {arc_bytes / 1e6:7.1f}MB {t_arc_write:7.2f}s {t_arc_read:10.2f}s {t_first:11.3f}s")
+    print(f"[Bench] {npz_bytes / arc_bytes:.1f}x smaller, first frames {t_npz_read / t_first:.0f}x sooner;"
+          f" max error {err:.4f} mm (step {quantization_step(lo, hi):.4f} mm)")
+    print(f"[Bench] Streamed: first chunk after {first_chunk[0]:.2f}s of {t_stream:.2f}s"
+          f" ({100 * first_chunk[0] / t_stream:.0f}% of the advection)")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,86 @@
+"""
+Collision kernel throughput for every instruction set fluid_native supports.
+
+Each kernel (scalar / avx2 / avx512) runs the native collide_block() on an
+in-cache block of populations with solid, inlet and outlet cells mixed in
+(Mcells/s, collision only - the full-step figure is bench_lbm --isa).
+Accuracy against LbmD3Q19Torch, per kernel and on wall links, is checked by
+tests/test_collide_kernels.py.
+
+Run from the backend folder:
+
+    python -m bench.bench_kernels
+    python -m bench.bench_kernels --cells 8192 --repeats 2000
+"""
+from __future__ import annotations
+
+import argparse
+import sys
+import time
+
+import numpy as np
+
+from sim.lbm_native import NATIVE_AVAILABLE, fluid_native
+from sim.lbm_torch import LbmD3Q19Torch
+
+OMEGA = 1.0 / (3.0 * 0.06 + 0.5)
+GRAVITY = np.array([2e-4, -1e-4, -3e-4], dtype=np.float32)
+INLET_SPEED = 0.05
+INLET_DIR = np.array([0.6, 0.0, -0.8], dtype=np.float32)
+
+
+def random_block(n: int, seed: int = 0):
+    """Populations near equilibrium plus noise, and per-cell masks (10% solid, 5% inlet, 5% outlet)."""
+    rng = np.random.default_rng(seed)
+    w = LbmD3Q19Torch._w_np.astype(np.float32)
+    f = (w[:, None] * (1.0 + 0.2 * rng.standard_normal((19, n)))).astype(np.float32)
+    kind = rng.random(n)
+    solid = kind < 0.10
+    inlet = (kind >= 0.10) & (kind < 0.15)
+    outlet = (kind >= 0.15) & (kind < 0.20)
+    return f, solid, inlet, outlet
+
+
+def native_collide(f, solid, inlet, outlet):
+    flags = (solid.astype(np.uint8) * 1) | (inlet.astype(np.uint8) * 2) | (outlet.astype(np.uint8) * 4)
+    d = INLET_DIR / np.linalg.norm(INLET_DIR)
+    return fluid_native.collide_block(
+        f, flags, OMEGA, GRAVITY.tolist(), (d * INLET_SPEED).astype(np.float32).tolist()
+    )
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--cells", type=int, default=4096,
+                    help="cells per block (19*cells*4 bytes should fit in L2)")
+    ap.add_argument("--repeats", type=int, default=1000)
+    args = ap.parse_args()
+
+    if not NATIVE_AVAILABLE:
+        print("[Bench] fluid_native not built - see backend/README.md")
+        return 1
+
+    isas = fluid_native.supported_kernel_isas()
+    default_isa = fluid_native.kernel_isa()
+    print(f"[Bench] Kernel ISAs on this CPU: {', '.join(isas)} (default {default_isa})")
+
+    f, solid, inlet, outlet = random_block(args.cells, seed=1)
+    print(f"\n[Bench] Collision throughput ({args.cells:,} cells x {args.repeats} calls):")
+    base = None
+    for isa in isas:
+        fluid_native.set_kernel_isa(isa)
+        native_collide(f, solid, inlet, outlet)
+        t0 = time.perf_counter()
+        for _ in range(args.repeats):
+            native_collide(f, solid, inlet, outlet)
+        secs = time.perf_counter() - t0
+        mcells = args.cells * args.repeats / secs / 1e6
+        base = base or mcells
+        print(f"  {isa:8s} {mcells:8.1f} Mcells/s  ({mcells / base:.1f}x scalar)")
+
+    fluid_native.set_kernel_isa(default_isa)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,136 @@
+"""
+MLUPS benchmark: native CPU engine vs LbmD3Q19Torch on the CPU.
+
+MLUPS = million lattice updates per second = nx*ny*nz*steps / seconds / 1e6.
+MFLUPS counts fluid cells only, which is the fair figure for the sparse lattice.
+
+Run from the backend folder:
+
+    python -m bench.bench_lbm                      # synthetic 128^3 channel
+    python -m bench.bench_lbm --grid 96 --steps 50
+    python -m bench.bench_lbm --lattice both --skip-torch
+    python -m bench.bench_lbm --isa all --skip-torch   # scalar vs avx2 vs avx512 kernels
+    python -m bench.bench_lbm --fill-overhead --skip-torch   # cost of the fill-level transport
+    python -m bench.bench_lbm --stl ../../SmallRiffleLotsFlume.stl --base-res 128
+"""
+from __future__ import annotations
+
+import argparse
+import time
+
+import numpy as np
+
+from sim.bitmask import as_bitmask
+from sim.lbm_native import NATIVE_AVAILABLE, LbmD3Q19Native, fluid_native
+from sim.lbm_torch import TORCH_AVAILABLE, LbmD3Q19Torch, torch
+
+
+def synthetic_channel(n: int):
+    """Sloped box channel: walls on the sides/bottom, inlet at one end, outlet at the other."""
+    nx, ny, nz = n, max(n // 2, 8), max(n // 2, 8)
+    solid = np.zeros((nx, ny, nz), dtype=bool)
+    solid[:, :2, :] = True
+    solid[:, -2:, :] = True
+    solid[:, :, :2] = True
+    inlet = np.zeros_like(solid)
+    inlet[2:6, ny // 3: 2 * ny // 3, nz // 2: nz - 2] = True
+    outlet = np.zeros_like(solid)
+    outlet[-6:-2, 2:-2, 2: nz // 3] = True
+    gravity = np.array([2e-4, 0.0, -3e-4], dtype=np.float32)
+    return solid, inlet, outlet, gravity
+
+
+def stl_domain(stl_path: str, base_res: int):
+    from sim.domain import build_domain_from_stl
+
+    domain = build_domain_from_stl(
+        stl_path=stl_path,
+        base_resolution=base_res,
+        gravity=np.array([0.0, 0.0, -1.0], dtype=np.float32),
+        source_point_mm=np.zeros(3, dtype=np.float32),
+    )
+    return domain.solid, domain.inlet, domain.outlet, domain.gravity_lbm
+
+
+def time_solver(lbm, steps: int, warmup: int, update_fill: bool = True) -> float:
+    for _ in range(warmup):
+        lbm.step(inlet_speed=0.05, update_fill=update_fill)
+    t0 = time.perf_counter()
+    for _ in range(steps):
+        lbm.step(inlet_speed=0.05, update_fill=update_fill)
+    return time.perf_counter() - t0
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--grid", type=int, default=128, help="synthetic channel length (cells)")
+    ap.add_argument("--stl", type=str, default=None, help="voxelize this STL instead of the synthetic channel")
+    ap.add_argument("--base-res", type=int, default=128)
+    ap.add_argument("--steps", type=int, default=100)
+    ap.add_argument("--warmup", type=int, default=5)
+    ap.add_argument("--threads", type=int, default=None)
+    ap.add_argument("--lattice", choices=["dense", "sparse", "both"], default="dense", help="native lattice layout")
+    ap.add_argument("--isa", default=None, help="native collision kernel: scalar, avx2, avx512 or all (default: best)")
+    ap.add_argument("--skip-torch", action="store_true")
+    ap.add_argument("--fill-overhead", action="store_true",
+                    help="also time every solver without the fill-level update")
+    args = ap.parse_args()
+
+    if args.stl:
+        solid, inlet, outlet, gravity = stl_domain(args.stl, args.base_res)
+    else:
+        solid, inlet, outlet, gravity = synthetic_channel(args.grid)
+    solid, inlet, outlet = as_bitmask(solid), as_bitmask(inlet), as_bitmask(outlet)
+    nx, ny, nz = solid.shape
+    cells = nx * ny * nz
+    fluid_cells = cells - solid.count()
+    kw = dict(nx=nx, ny=ny, nz=nz, nu_lbm=0.06, solid=solid, inlet=inlet, outlet=outlet, gravity_lbm=gravity)
+
+    results = {}
+    if NATIVE_AVAILABLE:
+        layouts = ["dense", "sparse"] if args.lattice == "both" else [args.lattice]
+        default_isa = fluid_native.kernel_isa()
+        if args.isa == "all":
+            isas = fluid_native.supported_kernel_isas()
+        else:
+            isas = [args.isa or default_isa]
+        for isa in isas:
+            fluid_native.set_kernel_isa(isa)
+            for layout in layouts:
+                name = f"native-{layout}" if len(isas) == 1 else f"native-{layout}-{isa}"
+                lbm = LbmD3Q19Native(threads=args.threads, sparse=(layout == "sparse"), **kw)
+                lbm.set_inlet_direction(np.array([1.0, 0.0, -0.5]))
+                results[name] = time_solver(lbm, args.steps, args.warmup)
+                if args.fill_overhead:
+                    results[f"{name} (no fill)"] = time_solver(lbm, args.steps, args.warmup, update_fill=False)
+                print(f"[Bench] {name} memory: {lbm.engine.memory_bytes / 1e6:.1f} MB")
+                del lbm
+        fluid_native.set_kernel_isa(default_isa)
+    else:
+        print("[Bench] fluid_native not built - skipping native engine")
+
+    if TORCH_AVAILABLE and not args.skip_torch:
+        if args.threads:
+            torch.set_num_threads(args.threads)
+        lbm = LbmD3Q19Torch(**kw)
+        lbm.set_inlet_direction(np.array([1.0, 0.0, -0.5]))
+        results[f"torch-{lbm.device.type}"] = time_solver(lbm, args.steps, args.warmup)
+        if args.fill_overhead:
+            results[f"torch-{lbm.device.type} (no fill)"] = time_solver(lbm, args.steps, args.warmup, update_fill=False)
+
+    print(f"\n[Bench] Grid {nx}x{ny}x{nz} = {cells:,} cells ({fluid_cells:,} fluid), {args.steps} steps")
+    for name, secs in results.items():
+        mlups = cells * args.steps / secs / 1e6
+        mflups = fluid_cells * args.steps / secs / 1e6
+        print(f"  {name:22s} {secs:8.2f} s  {mlups:8.1f} MLUPS  {mflups:8.1f} MFLUPS")
+    for name, secs in results.items():
+        if f"{name} (no fill)" in results:
+            print(f"  {name} fill-level transport: +{100 * (secs / results[f'{name} (no fill)'] - 1):.0f}% per step")
+    if "torch-cpu" in results:
+        for name, secs in results.items():
+            if name.startswith("native") and "(no fill)" not in name:
+                print(f"  {name} speedup vs torch-cpu: {results['torch-cpu'] / secs:.1f}x")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,155 @@
+"""
+NUMA placement benchmark: dense native sweep with and without thread pinning
+and huge pages, and where its memory ends up.
+
+For each setting the synthetic channel from bench_lbm is built and stepped,
+then the population array's pages are looked up (fluid_native.page_nodes,
+Linux move_pages) to show, per NUMA node:
+
+- pages:  share of the population pages on the node,
+- remote: share of the node's pages updated by threads on another node (the
+          static split gives thread t the t-th slice of every array). Only
+          known with pinned threads; unpinned threads may run anywhere.
+- threads: OpenMP threads pinned to the node's CPUs.
+
+With first touch working, each node holds the slice its own threads update:
+pages in proportion to its threads and no remote share. "huge" is the share
+of the array backed by huge pages (/proc/self/smaps). "GB/s" is the whole
+sweep's MLUPS x bytes per update; traffic per node is not measured (the
+kernel's numastat counts page allocations, not memory traffic).
+
+Run from the backend folder:
+
+    python -m bench.bench_numa                         # 256 x 128 x 128, all threads
+    python -m bench.bench_numa --grid 384 --threads 32 --steps 100
+"""
+from __future__ import annotations
+
+import argparse
+import os
+import sys
+import time
+
+import numpy as np
+
+from bench.bench_lbm import synthetic_channel
+from bench.bench_tiling import bytes_per_update
+from sim.bitmask import as_bitmask
+from sim.lbm_native import NATIVE_AVAILABLE, LbmD3Q19Native, fluid_native, numa_nodes
+
+SETTINGS = [
+    ("unpinned", False, "off"),
+    ("pinned", True, "off"),
+    ("pinned + THP", True, "transparent"),
+    ("pinned + hugetlb", True, "explicit"),
+]
+
+
+def static_owner(items: int, threads: int, index: np.ndarray) -> np.ndarray:
+    """Thread that an OpenMP schedule(static) loop over `items` gives each index."""
+    q, r = divmod(items, threads)
+    starts = np.array([t * q + min(t, r) for t in range(threads)])
+    return np.searchsorted(starts, index, side="right") - 1
+
+
+def huge_page_share(array: np.ndarray) -> float | None:
+    """Share of the array's bytes in huge pages, from /proc/self/smaps (None off Linux)."""
+    try:
+        with open("/proc/self/smaps") as f:
+            lines = f.readlines()
+    except OSError:
+        return None
+    lo, hi = array.ctypes.data, array.ctypes.data + array.nbytes
+    huge, inside = 0, False
+    for line in lines:
+        head = line.split()[0]
+        if "-" in head and not head.endswith(":"):
+            start, end = (int(v, 16) for v in head.split("-"))
+            inside = start < hi and end > lo
+        elif inside and head == "AnonHugePages:":
+            huge += int(line.split()[1]) * 1024
+    return min(huge / array.nbytes, 1.0)
+
+
+def placement(lbm: LbmD3Q19Native, nodes: dict[int, list[int]], threads: int):
+    """Per node: (page share, remote share or None, pinned thread count)."""
+    pops = lbm.engine.populations
+    page_node = fluid_native.page_nodes(pops)
+    if len(page_node) == 0:
+        return {}
+    page = os.sysconf("SC_PAGE_SIZE")
+    offset = np.arange(len(page_node), dtype=np.int64) * page - pops.ctypes.data % page
+    cell = (np.maximum(offset, 0) // pops.itemsize) % pops.shape[1]
+    cpus = lbm.engine.thread_cpus
+    owner_node = None
+    if cpus:
+        node_of_cpu = {c: n for n, cs in nodes.items() for c in cs}
+        thread_node = np.array([node_of_cpu.get(cpus[t % len(cpus)], -1) for t in range(threads)])
+        rows = lbm.nx * lbm.ny
+        owner_node = thread_node[static_owner(rows, threads, cell // lbm.nz)]
+    resident = page_node >= 0
+    out = {}
+    for n in sorted(set(nodes) | set(np.unique(page_node[resident]).tolist())):
+        on_node = page_node == n
+        share = on_node.sum() / max(resident.sum(), 1)
+        remote = None
+        if owner_node is not None and on_node.any():
+            remote = float((owner_node[on_node] != n).mean())
+        pinned = sum(1 for t in range(threads) if cpus and cpus[t % len(cpus)] in nodes.get(n, ()))
+        out[n] = (float(share), remote, pinned)
+    return out
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--grid", type=int, default=256, help="synthetic channel length (cells)")
+    ap.add_argument("--precision", choices=["fp32", "fp16", "bf16"], default="fp32")
+    ap.add_argument("--steps", type=int, default=50)
+    ap.add_argument("--warmup", type=int, default=5)
+    ap.add_argument("--threads", type=int, default=None)
+    args = ap.parse_args()
+
+    if not NATIVE_AVAILABLE:
+        print("[Bench] fluid_native not built - see backend/README.md")
+        return 1
+    if args.threads:
+        fluid_native.set_num_threads(args.threads)
+    threads = fluid_native.max_threads()
+    nodes = numa_nodes()
+    print(f"[Bench] {threads} threads, NUMA nodes: "
+          + (", ".join(f"{n}: {len(c)} cpus" for n, c in nodes.items()) or "unknown"))
+
+    solid, inlet, outlet, gravity = synthetic_channel(args.grid)
+    solid, inlet, outlet = as_bitmask(solid), as_bitmask(inlet), as_bitmask(outlet)
+    nx, ny, nz = solid.shape
+    cells = nx * ny * nz
+    per_update = bytes_per_update(args.precision)
+    print(f"[Bench] Grid {nx}x{ny}x{nz} = {cells:,} cells, {args.steps} steps, {per_update} bytes per update")
+
+    print(f"\n  {'setting':18s} {'MLUPS':>7s} {'GB/s':>6s} {'huge':>5s}   {'node':>4s} {'pages':>6s}"
+          f" {'remote':>7s} {'threads':>7s}")
+    for label, pin, huge in SETTINGS:
+        lbm = LbmD3Q19Native(nx=nx, ny=ny, nz=nz, nu_lbm=0.06, solid=solid, inlet=inlet, outlet=outlet,
+                             gravity_lbm=gravity, sparse=False, precision=args.precision,
+                             pin_threads=pin, huge_pages=huge)
+        lbm.set_inlet_direction(np.array([1.0, 0.0, -0.5]))
+        lbm.run(args.warmup, inlet_speed=0.05)
+        t0 = time.perf_counter()
+        lbm.run(args.steps, inlet_speed=0.05)
+        secs = time.perf_counter() - t0
+        mlups = cells * args.steps / secs / 1e6
+        gbs = mlups * per_update / 1e3
+        share = huge_page_share(lbm.engine.populations)
+        head = f"  {label:18s} {mlups:7.1f} {gbs:6.1f} {'-' if share is None else f'{100 * share:.0f}%':>5s}"
+        per_node = placement(lbm, nodes, threads)
+        if not per_node:
+            print(head + "   (page placement unknown on this platform)")
+        for i, (n, (pages, remote, pinned)) in enumerate(per_node.items()):
+            print(f"{head if i == 0 else ' ' * len(head)}   {n:4d} {100 * pages:5.0f}%"
+                  f" {'-' if remote is None else f'{100 * remote:.0f}%':>7s} {pinned if pin else '-':>7}")
+        del lbm
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,115 @@
+"""
+Accuracy harness for reduced-precision population storage in the native engine.
+
+Runs the same domain with fp32, fp16 and bf16 populations (fp32 arithmetic in
+all three) and compares the final velocity and fill fields against fp32:
+
+- rel L2   ||u - u_fp32|| / ||u_fp32|| over fluid cells
+- max |du| largest per-cell velocity difference (lattice units)
+- mean speed and its relative change
+- memory, MLUPS and how many lattice cells fit per GB of population storage
+
+Run from the backend folder:
+
+    python -m bench.bench_precision                                  # SmallRiffleLotsFlume.stl, base-res 128
+    python -m bench.bench_precision --base-res 192 --steps 1500
+    python -m bench.bench_precision --grid 96                        # synthetic channel, no pyvista needed
+"""
+from __future__ import annotations
+
+import argparse
+import sys
+import time
+from pathlib import Path
+
+import numpy as np
+
+from bench.bench_lbm import synthetic_channel
+from sim.bitmask import as_bitmask
+from sim.lbm_native import NATIVE_AVAILABLE, PRECISIONS, LbmD3Q19Native
+
+DEFAULT_STL = Path(__file__).resolve().parents[3] / "SmallRiffleLotsFlume.stl"
+
+
+def flume_domain(stl_path: str, base_res: int, nu_lbm: float, flow_gph: float):
+    from sim.domain import build_domain_from_stl
+
+    domain = build_domain_from_stl(
+        stl_path=stl_path,
+        base_resolution=base_res,
+        gravity=np.array([0.0, 0.0, -1.0], dtype=np.float32),
+        source_point_mm=np.zeros(3, dtype=np.float32),
+        nu_lbm=nu_lbm,
+    )
+    inlet_speed = domain.inlet_speed_lbm(flow_gph=flow_gph, nu_lbm=nu_lbm)
+    return domain.solid, domain.inlet, domain.outlet, domain.gravity_lbm, domain.gravity_dir, inlet_speed
+
+
+def run(precision: str, kw: dict, inlet_dir, inlet_speed: float, steps: int, sparse):
+    lbm = LbmD3Q19Native(precision=precision, sparse=sparse, **kw)
+    lbm.set_inlet_direction(inlet_dir)
+    t0 = time.perf_counter()
+    lbm.run(steps, inlet_speed=inlet_speed)
+    secs = time.perf_counter() - t0
+    u = np.stack(lbm.velocity_cpu())
+    fill = lbm.fill_level_cpu()
+    pop_bytes = 19 * lbm.engine.stored_cells * (4 if precision == "fp32" else 2)
+    return u, fill, secs, lbm.engine.memory_bytes, pop_bytes
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--stl", type=str, default=str(DEFAULT_STL))
+    ap.add_argument("--grid", type=int, default=None, help="use the synthetic channel of this length instead of the STL")
+    ap.add_argument("--base-res", type=int, default=128)
+    ap.add_argument("--steps", type=int, default=800, help="LBM steps (quality=low runs 800)")
+    ap.add_argument("--nu", type=float, default=0.08)
+    ap.add_argument("--flow-gph", type=float, default=200.0)
+    ap.add_argument("--lattice", choices=["auto", "dense", "sparse"], default="auto")
+    ap.add_argument("--precisions", nargs="+", default=list(PRECISIONS), choices=PRECISIONS)
+    args = ap.parse_args()
+
+    if not NATIVE_AVAILABLE:
+        print("[Bench] fluid_native not built - see backend/README.md")
+        return 1
+
+    if args.grid:
+        solid, inlet, outlet, gravity = synthetic_channel(args.grid)
+        inlet_dir, inlet_speed, name = np.array([1.0, 0.0, -0.5]), 0.05, f"synthetic channel {args.grid}"
+    else:
+        solid, inlet, outlet, gravity, inlet_dir, inlet_speed = flume_domain(
+            args.stl, args.base_res, args.nu, args.flow_gph
+        )
+        name = f"{Path(args.stl).name} @ base-res {args.base_res}"
+
+    nx, ny, nz = solid.shape
+    cells = nx * ny * nz
+    fluid = ~as_bitmask(solid).to_bool()
+    sparse = None if args.lattice == "auto" else args.lattice == "sparse"
+    kw = dict(nx=nx, ny=ny, nz=nz, nu_lbm=args.nu, solid=solid, inlet=inlet, outlet=outlet, gravity_lbm=gravity)
+
+    precisions = ["fp32"] + [p for p in args.precisions if p != "fp32"]
+    results = {p: run(p, kw, inlet_dir, float(inlet_speed), args.steps, sparse) for p in precisions}
+
+    u_ref, fill_ref = results["fp32"][0][:, fluid], results["fp32"][1][fluid]
+    speed_ref = np.sqrt((u_ref ** 2).sum(axis=0)).mean()
+
+    print(f"\n[Bench] {name}: {nx}x{ny}x{nz} = {cells:,} cells ({int(fluid.sum()):,} fluid), {args.steps} steps")
+    print(f"  {'storage':8s} {'rel L2':>9s} {'max |du|':>9s} {'mean |u|':>9s} {'d mean':>8s} {'max dfill':>9s}"
+          f" {'memory':>9s} {'MLUPS':>7s} {'Mcells/GB':>9s}")
+    for p, (u, fill, secs, mem, pop_bytes) in results.items():
+        uf = u[:, fluid]
+        rel_l2 = np.linalg.norm(uf - u_ref) / max(np.linalg.norm(u_ref), 1e-30)
+        max_du = np.abs(uf - u_ref).max()
+        speed = np.sqrt((uf ** 2).sum(axis=0)).mean()
+        d_mean = (speed - speed_ref) / max(speed_ref, 1e-30)
+        max_dfill = np.abs(fill[fluid] - fill_ref).max()
+        mlups = cells * args.steps / secs / 1e6
+        per_gb = cells / (pop_bytes / 1e9) / 1e6
+        print(f"  {p:8s} {rel_l2:9.2e} {max_du:9.2e} {speed:9.5f} {100 * d_mean:+7.2f}% {max_dfill:9.2e}"
+              f" {mem / 1e6:7.1f}MB {mlups:7.1f} {per_gb:9.1f}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
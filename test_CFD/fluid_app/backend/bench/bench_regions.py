@@ -0,0 +1,101 @@
+"""
+Inlet/outlet region selection benchmark: box-bounded search vs full grid.
+
+A flume-like mask (fluid tube along x in an N^3 box) at each grid size, and
+the two queries build_domain_from_stl() makes: the cells of a sphere of fixed
+radius in cells, and the nearest fluid cells to a source point in solid a
+fixed distance from the fluid (the fallback when the sphere misses it; with
+one cell, the source snap shared with advection). The full-grid path is what
+the domain and advect_particles() used to do (a distance per lattice point or
+fluid cell, then argsort/argmin); region_select runs in numpy and, when
+fluid_native is built, natively. Its time follows the radius and the
+distance, and should stay flat as the grid grows. "match" compares to full
+grid.
+
+Run from the backend folder:
+
+    python -m bench.bench_regions                   # N = 128/192/256/320
+    python -m bench.bench_regions --grid 320 512 --radius 20 --count 2000
+"""
+from __future__ import annotations
+
+import argparse
+import sys
+import time
+
+import numpy as np
+
+import sim.region_select as region_select
+from sim.bitmask import BitMask
+from sim.lbm_native import NATIVE_AVAILABLE
+
+
+def flume(n):
+    r = np.indices((n, n), dtype=np.float32) - (n - 1) / 2
+    tube = np.sqrt((r ** 2).sum(0)) < 0.2 * n
+    solid = np.broadcast_to(~tube[None], (n, n, n))
+    coords = tuple(np.arange(n, dtype=np.float32) for _ in range(3))  # 1mm cells
+    return BitMask.from_bool(solid), coords
+
+
+def full_grid_sphere(solid, coords, center, radius):
+    x, y, z = coords
+    dist = np.sqrt((x - center[0])[:, None, None] ** 2 + (y - center[1])[None, :, None] ** 2
+                   + (z - center[2])[None, None, :] ** 2)
+    return BitMask.from_bool(dist <= radius).andnot(solid)
+
+
+def full_grid_nearest(solid, coords, point, count):
+    cells = (~solid).argwhere()
+    pts = np.column_stack([coords[a][cells[:, a]] for a in range(3)]).astype(np.float64)
+    d2 = ((pts - point) ** 2).sum(1)
+    flat = np.ravel_multi_index(cells.T, solid.shape)
+    return flat[np.lexsort((flat, d2))[:count]]
+
+
+def timed(fn, repeat, *args):
+    best = float("inf")
+    for _ in range(repeat):
+        t0 = time.perf_counter()
+        out = fn(*args)
+        best = min(best, time.perf_counter() - t0)
+    return out, best
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--grid", type=int, nargs="+", default=[128, 192, 256, 320])
+    ap.add_argument("--radius", type=float, default=10.0, help="sphere radius (cells)")
+    ap.add_argument("--count", type=int, default=100, help="nearest fluid cells to find")
+    ap.add_argument("--gap", type=float, default=8.0, help="source point distance from the fluid (cells)")
+    ap.add_argument("--repeat", type=int, default=3)
+    args = ap.parse_args()
+
+    paths = [("numpy", False)] + ([("native", True)] if NATIVE_AVAILABLE else [])
+    print(f"  {'grid':>12s} {'query':16s} {'path':10s} {'time':>9s}  match")
+    for n in args.grid:
+        solid, coords = flume(n)
+        mid = (n - 1) / 2
+        queries = [
+            (f"sphere r={args.radius:g}", full_grid_sphere, region_select.select_sphere,
+             np.array([mid, mid, mid], dtype=np.float32), args.radius),
+            (f"nearest {args.count}", full_grid_nearest, region_select.nearest_fluid_cells,
+             np.array([mid, mid - 0.2 * n - args.gap, mid], dtype=np.float32), args.count),
+            ("nearest 1 (snap)", full_grid_nearest, region_select.nearest_fluid_cells,
+             np.array([mid, mid - 0.2 * n - args.gap, mid], dtype=np.float32), 1),
+        ]
+        for label, reference, query, point, arg in queries:
+            ref, t_ref = timed(reference, 1, solid, coords, point, arg)
+            print(f"  {f'{n}^3':>12s} {label:16s} {'full grid':10s} {t_ref * 1e3:7.2f}ms")
+            for name, native in paths:
+                region_select.NATIVE_AVAILABLE = native
+                out, secs = timed(query, args.repeat, solid, coords, point, arg)
+                same = np.array_equal(out.words, ref.words) if isinstance(out, BitMask) else np.array_equal(out, ref)
+                print(f"  {'':12s} {'':16s} {name:10s} {secs * 1e3:7.2f}ms  {'yes' if same else 'NO'}"
+                      f"  ({t_ref / secs:.0f}x)")
+    region_select.NATIVE_AVAILABLE = NATIVE_AVAILABLE
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
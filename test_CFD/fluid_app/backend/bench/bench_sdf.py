@@ -0,0 +1,100 @@
+"""
+Signed distance field benchmark: native EDT vs scipy distance_transform_edt.
+
+Builds the solid mask of the STL at each base resolution and times the SDF
+that advect_particles() uses: scipy (two single-threaded EDTs), native over
+the whole grid and native limited to the particle band. Reports the largest
+difference to scipy (clamped to the band for the banded run), which should be 0.
+
+Run from the backend folder:
+
+    python -m bench.bench_sdf                       # SmallRiffleLotsFlume.stl at 128/192/256/320
+    python -m bench.bench_sdf --sphere 256          # hollow sphere in a 256^3 box instead
+    python -m bench.bench_sdf --threads 1 --repeat 5
+"""
+from __future__ import annotations
+
+import argparse
+import contextlib
+import io
+import sys
+import time
+from pathlib import Path
+
+import numpy as np
+
+from sim.advect import SDF_BAND_CELLS
+from sim.bitmask import BitMask
+from sim.domain import build_domain_from_stl
+from sim.lbm_native import NATIVE_AVAILABLE, fluid_native
+
+DEFAULT_STL = Path(__file__).resolve().parents[3] / "SmallRiffleLotsFlume.stl"
+
+
+def scipy_sdf(solid, band_cells):
+    from scipy.ndimage import distance_transform_edt
+    solid = solid.to_bool()
+    fluid = ~solid
+    sd = np.where(fluid, distance_transform_edt(fluid), -distance_transform_edt(solid)).astype(np.float32)
+    if band_cells > 0:
+        np.clip(sd, -band_cells, band_cells, out=sd)
+    return sd
+
+
+def native_sdf(solid, band_cells):
+    return fluid_native.signed_distance(solid.words, solid.shape[2], band_cells, 1.0)
+
+
+def timed(fn, repeat, *args):
+    best = float("inf")
+    for _ in range(repeat):
+        t0 = time.perf_counter()
+        out = fn(*args)
+        best = min(best, time.perf_counter() - t0)
+    return out, best
+
+
+def masks(args):
+    if args.sphere:
+        n = args.sphere
+        r = np.indices((n, n, n), dtype=np.float32) - (n - 1) / 2
+        yield f"sphere {n}^3", BitMask.from_bool(np.sqrt((r ** 2).sum(0)) > 0.4 * n)
+        return
+    for base_res in args.base_res:
+        with contextlib.redirect_stdout(io.StringIO()):
+            domain = build_domain_from_stl(stl_path=args.stl, base_resolution=base_res,
+                                           gravity=np.array([0.0, 0.0, -1.0]), source_point_mm=np.zeros(3))
+        yield f"base-res {base_res}", domain.solid
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--stl", type=str, default=str(DEFAULT_STL))
+    ap.add_argument("--base-res", type=int, nargs="+", default=[128, 192, 256, 320])
+    ap.add_argument("--sphere", type=int, default=0, help="use a hollow sphere in an N^3 box")
+    ap.add_argument("--threads", type=int, default=0, help="native OpenMP threads (0 = default)")
+    ap.add_argument("--repeat", type=int, default=3)
+    args = ap.parse_args()
+
+    if not NATIVE_AVAILABLE:
+        print("[Bench] fluid_native not built - see backend/README.md")
+        return 1
+    if args.threads:
+        fluid_native.set_num_threads(args.threads)
+
+    print(f"  {'case':16s} {'grid':>14s} {'path':14s} {'time':>9s} {'max diff':>9s}")
+    for name, solid in masks(args):
+        grid = "x".join(str(n) for n in solid.shape)
+        ref, t_ref = timed(scipy_sdf, 1, solid, 0)
+        print(f"  {name:16s} {grid:>14s} {'scipy':14s} {t_ref * 1e3:7.1f}ms")
+        for band in (0, SDF_BAND_CELLS):
+            out, secs = timed(native_sdf, args.repeat, solid, band)
+            expect = np.clip(ref, -band, band) if band else ref
+            label = f"native band {band}" if band else "native"
+            print(f"  {'':16s} {'':14s} {label:14s} {secs * 1e3:7.1f}ms {float(np.abs(out - expect).max()):9.2g}"
+                  f"  ({t_ref / secs:.1f}x)")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,130 @@
+"""
+Slab decomposition benchmark: the dense native sweep split over several
+processes on one machine (sim/lbm_slabs.py), strong and weak scaling.
+
+- strong: the synthetic channel from bench_lbm at a fixed size, split over
+          1, 2, 4, ... ranks. Ideal is R times the one-rank MLUPS.
+- weak:   R copies of a base channel laid end to end along x (inlet in the
+          first, outlet in the last), so every rank keeps the same slab.
+          Ideal is flat time per step, i.e. R times the MLUPS.
+
+Every rank gets threads / R OpenMP threads (pinned to its own cores when
+there are enough), so all rows use the same cores. Per row:
+
+- eff:   MLUPS over R times the one-rank MLUPS,
+- halo:  share of the wall time the ranks spent blocked in halo waits
+         (mean over ranks): exchange cost plus load imbalance,
+- match: strong rows only, whether velocity and fill after the run are
+         bitwise those of one dense LbmD3Q19Native run.
+
+Run from the backend folder:
+
+    python -m bench.bench_slabs                        # 128-cell channel, 1, 2, 4 ... ranks
+    python -m bench.bench_slabs --grid 256 --weak-grid 96 --ranks 1,2,4,8 --steps 100
+"""
+from __future__ import annotations
+
+import argparse
+import os
+import sys
+import time
+
+import numpy as np
+
+from bench.bench_lbm import synthetic_channel
+from sim.bitmask import as_bitmask
+from sim.lbm_native import NATIVE_AVAILABLE, LbmD3Q19Native, fluid_native
+from sim.lbm_slabs import LbmD3Q19Slabs
+
+INLET_DIR = np.array([1.0, 0.0, -0.5])
+INLET_SPEED = 0.05
+
+
+def weak_channel(base: int, ranks: int):
+    """`ranks` base channels end to end along x: inlet in the first, outlet in the last."""
+    solid, inlet, outlet, gravity = synthetic_channel(base)
+    long_inlet = np.zeros((ranks * solid.shape[0],) + solid.shape[1:], dtype=bool)
+    long_outlet = long_inlet.copy()
+    long_inlet[:base] = inlet
+    long_outlet[-base:] = outlet
+    return np.tile(solid, (ranks, 1, 1)), long_inlet, long_outlet, gravity
+
+
+def time_slabs(domain, ranks: int, threads: int, args):
+    """(MLUPS, halo wait share, solver) for `ranks` ranks; the caller closes the solver."""
+    solid, inlet, outlet, gravity = domain
+    nx, ny, nz = solid.shape
+    lbm = LbmD3Q19Slabs(nx=nx, ny=ny, nz=nz, nu_lbm=0.06, solid=as_bitmask(solid), inlet=as_bitmask(inlet),
+                        outlet=as_bitmask(outlet), gravity_lbm=gravity, ranks=ranks, threads=threads,
+                        precision=args.precision)
+    lbm.set_inlet_direction(INLET_DIR)
+    lbm.run(args.warmup, inlet_speed=INLET_SPEED)
+    waited = list(lbm.halo_wait_seconds)
+    t0 = time.perf_counter()
+    lbm.run(args.steps, inlet_speed=INLET_SPEED)
+    secs = time.perf_counter() - t0
+    halo = np.mean([w1 - w0 for w0, w1 in zip(waited, lbm.halo_wait_seconds)]) / secs
+    return nx * ny * nz * args.steps / secs / 1e6, float(halo), lbm
+
+
+def reference(domain, args):
+    """Velocity and fill of one dense engine after the same steps."""
+    solid, inlet, outlet, gravity = domain
+    nx, ny, nz = solid.shape
+    lbm = LbmD3Q19Native(nx=nx, ny=ny, nz=nz, nu_lbm=0.06, solid=as_bitmask(solid), inlet=as_bitmask(inlet),
+                         outlet=as_bitmask(outlet), gravity_lbm=gravity, sparse=False, precision=args.precision)
+    lbm.set_inlet_direction(INLET_DIR)
+    lbm.run(args.warmup + args.steps, inlet_speed=INLET_SPEED)
+    return lbm.engine.ux(), lbm.engine.fill_level()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--grid", type=int, default=128, help="strong scaling: synthetic channel length (cells)")
+    ap.add_argument("--weak-grid", type=int, default=64, help="weak scaling: channel length per rank (cells)")
+    ap.add_argument("--ranks", default=None, help="comma-separated rank counts (default 1, 2, 4 ... up to the CPUs)")
+    ap.add_argument("--threads", type=int, default=None, help="total OpenMP threads, split over the ranks")
+    ap.add_argument("--precision", choices=["fp32", "fp16", "bf16"], default="fp32")
+    ap.add_argument("--steps", type=int, default=50)
+    ap.add_argument("--warmup", type=int, default=5)
+    ap.add_argument("--skip-check", action="store_true", help="skip the comparison against one engine")
+    args = ap.parse_args()
+
+    if not NATIVE_AVAILABLE:
+        print("[Bench] fluid_native not built - see backend/README.md")
+        return 1
+    cpus = len(os.sched_getaffinity(0)) if hasattr(os, "sched_getaffinity") else os.cpu_count() or 1
+    threads = args.threads or cpus
+    if args.ranks:
+        rank_counts = [int(r) for r in args.ranks.split(",")]
+    else:
+        rank_counts = [1 << i for i in range(max(threads, 2).bit_length()) if 1 << i <= max(threads, 2)]
+    print(f"[Bench] {threads} threads over {', '.join(map(str, rank_counts))} ranks, "
+          f"{fluid_native.kernel_isa()} kernel, {args.precision} populations, {args.steps} steps")
+    if threads < max(rank_counts):
+        print(f"[Bench] Fewer threads than ranks: ranks share cores and halo waits include time slicing")
+
+    rows = []
+    strong = synthetic_channel(args.grid)
+    ref = None if args.skip_check else reference(strong, args)
+    for kind in ("strong", "weak"):
+        base = None
+        for ranks in rank_counts:
+            domain = strong if kind == "strong" else weak_channel(args.weak_grid, ranks)
+            mlups, halo, lbm = time_slabs(domain, ranks, max(1, threads // ranks), args)
+            match = "-"
+            if kind == "strong" and ref is not None:
+                same = np.array_equal(lbm.velocity_cpu()[0], ref[0]) and np.array_equal(lbm.fill_level_cpu(), ref[1])
+                match = "bitwise" if same else "DIFF"
+            lbm.close()
+            base = base or mlups
+            rows.append((kind, "x".join(map(str, domain[0].shape)), ranks, mlups, mlups / (ranks * base), halo, match))
+
+    print(f"\n  {'scaling':8s} {'grid':>12s} {'ranks':>5s} {'MLUPS':>8s} {'eff':>5s} {'halo':>5s} {'match':>8s}")
+    for kind, grid, ranks, mlups, eff, halo, match in rows:
+        print(f"  {kind:8s} {grid:>12s} {ranks:5d} {mlups:8.1f} {100 * eff:4.0f}% {100 * halo:4.0f}% {match:>8s}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,101 @@
+"""
+STL loading benchmark: native StlMesh vs pyvista read().clean().triangulate().
+
+Reports wall time and the memory held by the loaded mesh (vertices, triangles
+and, for the native mesh, its BVH; pyvista's actual_memory_size for VTK), plus
+the native per-stage breakdown (read, weld, BVH). Both paths should end up with
+the same number of welded vertices and triangles.
+
+Run from the backend folder:
+
+    python -m bench.bench_stl                          # SmallRiffleLotsFlume.stl
+    python -m bench.bench_stl --synthetic 2000000      # tessellated sphere, ~2M triangles
+    python -m bench.bench_stl --skip-pyvista --repeat 5
+"""
+from __future__ import annotations
+
+import argparse
+import sys
+import tempfile
+import time
+from pathlib import Path
+
+import numpy as np
+
+from sim.lbm_native import NATIVE_AVAILABLE, fluid_native
+
+DEFAULT_STL = Path(__file__).resolve().parents[3] / "SmallRiffleLotsFlume.stl"
+
+
+def write_sphere_stl(path: Path, triangles: int, radius_mm: float = 50.0):
+    """Binary STL of a UV sphere with about `triangles` triangles (unwelded, as exporters write them)."""
+    n_lat = max(int(np.sqrt(triangles / 4)), 2)
+    n_lon = max(triangles // (2 * n_lat), 3)
+    theta = np.linspace(0.0, np.pi, n_lat + 1)
+    phi = np.linspace(0.0, 2.0 * np.pi, n_lon + 1)
+    T, P = np.meshgrid(theta, phi, indexing="ij")
+    pts = radius_mm * np.stack([np.sin(T) * np.cos(P), np.sin(T) * np.sin(P), np.cos(T)], axis=-1)
+    a, b = pts[:-1, :-1], pts[1:, :-1]
+    c, d = pts[1:, 1:], pts[:-1, 1:]
+    tris = np.concatenate([np.stack([a, b, c], 2).reshape(-1, 3, 3), np.stack([a, c, d], 2).reshape(-1, 3, 3)])
+    rec = np.zeros(len(tris), np.dtype([("n", "<f4", 3), ("v", "<f4", (3, 3)), ("attr", "<u2")]))
+    rec["v"] = tris
+    with open(path, "wb") as f:
+        f.write(b"bench_stl synthetic sphere".ljust(80, b" "))
+        f.write(np.uint32(len(rec)).tobytes())
+        f.write(rec.tobytes())
+
+
+def load_native(path):
+    return fluid_native.StlMesh(str(path))
+
+
+def load_pyvista(path):
+    import pyvista as pv
+    return pv.read(str(path)).clean().triangulate()
+
+
+def timed(fn, repeat: int, *args):
+    best = float("inf")
+    for _ in range(repeat):
+        t0 = time.perf_counter()
+        out = fn(*args)
+        best = min(best, time.perf_counter() - t0)
+    return out, best
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--stl", type=str, default=str(DEFAULT_STL))
+    ap.add_argument("--synthetic", type=int, default=0, help="benchmark a generated sphere with this many triangles")
+    ap.add_argument("--repeat", type=int, default=3)
+    ap.add_argument("--skip-pyvista", action="store_true")
+    args = ap.parse_args()
+
+    if not NATIVE_AVAILABLE:
+        print("[Bench] fluid_native not built - see backend/README.md")
+        return 1
+
+    with tempfile.TemporaryDirectory() as tmp:
+        path = Path(args.stl)
+        if args.synthetic:
+            path = Path(tmp) / "sphere.stl"
+            write_sphere_stl(path, args.synthetic)
+        print(f"[Bench] {path.name}: {path.stat().st_size / 1e6:.1f}MB")
+        print(f"  {'path':8s} {'time':>9s} {'memory':>9s} {'vertices':>10s} {'triangles':>10s}")
+
+        mesh, secs = timed(load_native, args.repeat, path)
+        stats = mesh.load_stats
+        print(f"  {'native':8s} {secs * 1e3:7.1f}ms {mesh.memory_bytes / 1e6:7.1f}MB {mesh.n_points:10,d} {mesh.n_cells:10,d}"
+              f"   (read {stats['read_ms']:.1f}ms, weld {stats['weld_ms']:.1f}ms,"
+              f" BVH {stats['bvh_ms']:.1f}ms / {mesh.bvh_nodes:,} nodes)")
+        if not args.skip_pyvista:
+            ref, ref_secs = timed(load_pyvista, 1, path)
+            print(f"  {'pyvista':8s} {ref_secs * 1e3:7.1f}ms {ref.actual_memory_size / 1e3:7.1f}MB"
+                  f" {ref.n_points:10,d} {ref.n_cells:10,d}")
+            print(f"  {'speedup':8s} {ref_secs / secs:7.1f}x")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
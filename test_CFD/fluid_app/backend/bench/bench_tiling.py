@@ -0,0 +1,138 @@
+"""
+Temporal blocking benchmark: dense native sweep, plain vs tiled, against a roofline.
+
+Each configuration runs the same steps on the synthetic channel from
+bench_lbm, once plain (one pass over the grid per step) and once per
+(steps, tile_y) pair with LbmEngine.set_temporal_blocking(), which advances
+each y-tile several steps per pass. "match" checks the velocity field against
+the plain run (blocking is meant to be bitwise identical).
+
+"eff GB/s" is MLUPS times the bytes one plain step moves per cell:
+populations read and written (2 * 19 * 4 bytes, 2 * 19 * 2 in 16 bits),
+rho/u written, fill read and written and the flag byte. A blocked pass moves
+them once per `steps` steps when a tile's working set stays in cache, so the
+figure is what a plain sweep would need for the same MLUPS and can exceed
+what memory delivers. The roofline is the lower of:
+
+- compute: collide_block() on an in-cache block, times the thread count
+  (collision only, so a loose upper bound for the full update),
+- memory: a large numpy copy split over the same number of threads (read +
+  write bytes per second) divided by the bytes per update, times `steps`
+  for a blocked run.
+
+Run from the backend folder:
+
+    python -m bench.bench_tiling                          # 192 x 96 x 96, fp32
+    python -m bench.bench_tiling --grid 256 --precision fp16
+    python -m bench.bench_tiling --block 2 4 8 --tile 8 16 32 64 --steps 32
+"""
+from __future__ import annotations
+
+import argparse
+import sys
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+import numpy as np
+
+from bench.bench_lbm import synthetic_channel
+from bench.bench_kernels import native_collide, random_block
+from sim.bitmask import as_bitmask
+from sim.lbm_native import NATIVE_AVAILABLE, LbmD3Q19Native, fluid_native
+
+# rho, ux, uy, uz written (16), fill read + written (8), flags read (1)
+MACRO_BYTES = 16 + 8 + 1
+
+
+def bytes_per_update(precision: str) -> int:
+    return 2 * 19 * (4 if precision == "fp32" else 2) + MACRO_BYTES
+
+
+def stream_bandwidth(mbytes: int, repeat: int, threads: int) -> float:
+    """Bytes/s of np.copyto over two arrays far larger than the caches (read + write),
+    split into one contiguous chunk per thread (numpy drops the GIL while copying)."""
+    src = np.ones(mbytes * (1 << 20) // 8, dtype=np.float64)
+    dst = np.empty_like(src)
+    bounds = np.linspace(0, src.size, threads + 1, dtype=np.int64)
+    chunks = [(dst[a:b], src[a:b]) for a, b in zip(bounds[:-1], bounds[1:])]
+    best = float("inf")
+    with ThreadPoolExecutor(threads) as pool:
+        list(pool.map(lambda c: np.copyto(*c), chunks))  # fault the pages in
+        for _ in range(repeat):
+            t0 = time.perf_counter()
+            list(pool.map(lambda c: np.copyto(*c), chunks))
+            best = min(best, time.perf_counter() - t0)
+    return 2 * src.nbytes / best
+
+
+def collide_rate(cells: int, repeat: int) -> float:
+    """Cells/s of the collision kernel on an in-cache block, one thread."""
+    f, solid, inlet, outlet = random_block(cells)
+    native_collide(f, solid, inlet, outlet)
+    t0 = time.perf_counter()
+    for _ in range(repeat):
+        native_collide(f, solid, inlet, outlet)
+    return cells * repeat / (time.perf_counter() - t0)
+
+
+def run_config(kw, block, steps, warmup):
+    lbm = LbmD3Q19Native(temporal_block=block, **kw)
+    lbm.set_inlet_direction(np.array([1.0, 0.0, -0.5]))
+    lbm.run(warmup, inlet_speed=0.05)
+    t0 = time.perf_counter()
+    lbm.run(steps, inlet_speed=0.05)
+    secs = time.perf_counter() - t0
+    return secs, lbm.engine.ux()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--grid", type=int, default=192, help="synthetic channel length (cells)")
+    ap.add_argument("--precision", choices=["fp32", "fp16", "bf16"], default="fp32")
+    ap.add_argument("--block", type=int, nargs="+", default=[2, 4, 8], help="steps per blocked pass")
+    ap.add_argument("--tile", type=int, nargs="+", default=[16, 32, 64], help="tile height in y rows")
+    ap.add_argument("--steps", type=int, default=48, help="timed steps (a multiple of every --block)")
+    ap.add_argument("--warmup", type=int, default=8)
+    ap.add_argument("--threads", type=int, default=None)
+    ap.add_argument("--stream-mb", type=int, default=512, help="size of each array in the copy test")
+    args = ap.parse_args()
+
+    if not NATIVE_AVAILABLE:
+        print("[Bench] fluid_native not built - see backend/README.md")
+        return 1
+    if args.threads:
+        fluid_native.set_num_threads(args.threads)
+
+    solid, inlet, outlet, gravity = synthetic_channel(args.grid)
+    solid, inlet, outlet = as_bitmask(solid), as_bitmask(inlet), as_bitmask(outlet)
+    nx, ny, nz = solid.shape
+    cells = nx * ny * nz
+    kw = dict(nx=nx, ny=ny, nz=nz, nu_lbm=0.06, solid=solid, inlet=inlet, outlet=outlet,
+              gravity_lbm=gravity, sparse=False, precision=args.precision)
+
+    threads = fluid_native.max_threads()
+    per_update = bytes_per_update(args.precision)
+    bandwidth = stream_bandwidth(args.stream_mb, 3, threads)
+    compute = collide_rate(16384, 200) * threads
+    print(f"[Bench] {threads} threads, {fluid_native.kernel_isa()} kernel")
+    print(f"[Bench] Copy bandwidth {bandwidth / 1e9:.1f} GB/s, collision {compute / 1e6:.0f} Mcells/s in cache"
+          f" ({threads} x one thread)")
+    print(f"[Bench] {per_update} bytes per plain update ({args.precision} populations)")
+
+    configs = [(1, 0)] + [(b, t) for b in args.block for t in args.tile if t >= 2 * b]
+    print(f"\n[Bench] Grid {nx}x{ny}x{nz} = {cells:,} cells, {args.steps} steps")
+    print(f"  {'steps/pass':>10s} {'tile_y':>6s} {'MLUPS':>8s} {'eff GB/s':>8s} {'roofline':>9s} {'of roof':>8s}  match")
+    reference = None
+    for block, tile in configs:
+        secs, ux = run_config(kw, (block, tile) if block > 1 else None, args.steps, args.warmup)
+        if reference is None:
+            reference = ux
+        mlups = cells * args.steps / secs / 1e6
+        roof = min(compute, bandwidth * block / per_update) / 1e6
+        print(f"  {block:10d} {tile or '-':>6} {mlups:8.1f} {mlups * per_update / 1e3:8.1f} {roof:9.1f}"
+              f" {100 * mlups / roof:7.0f}%  {'yes' if np.array_equal(ux, reference) else 'NO'}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
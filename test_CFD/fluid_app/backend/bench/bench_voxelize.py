@@ -0,0 +1,106 @@
+"""
+Voxelizer benchmark: native ray-parity voxelizer vs pyvista select_enclosed_points.
+
+Voxelizes the STL on the same lattice build_domain_from_stl() uses (5 mm
+padding, up to 320 cells per axis) with both paths and reports wall time,
+peak numpy memory (tracemalloc; VTK's own buffers are not included) and how
+many lattice points the two disagree on (popcount of the XOR of the packed masks).
+
+Run from the backend folder:
+
+    python -m bench.bench_voxelize                       # SmallRiffleLotsFlume.stl at 128/192/256/320
+    python -m bench.bench_voxelize --base-res 320 --repeat 5
+    python -m bench.bench_voxelize --skip-pyvista        # native only
+"""
+from __future__ import annotations
+
+import argparse
+import sys
+import time
+import tracemalloc
+from pathlib import Path
+
+import numpy as np
+import pyvista as pv
+
+from sim.bitmask import BitMask
+from sim.domain import _dims_from_bounds
+from sim.lbm_native import NATIVE_AVAILABLE, fluid_native
+
+DEFAULT_STL = Path(__file__).resolve().parents[3] / "SmallRiffleLotsFlume.stl"
+
+
+def lattice(mesh, base_res: int, padding_mm: float = 5.0):
+    b = mesh.bounds
+    nx, ny, nz = _dims_from_bounds(b, base_res, max_cells=320)
+    return (
+        np.linspace(b[0] - padding_mm, b[1] + padding_mm, nx).astype(np.float32),
+        np.linspace(b[2] - padding_mm, b[3] + padding_mm, ny).astype(np.float32),
+        np.linspace(b[4] - padding_mm, b[5] + padding_mm, nz).astype(np.float32),
+    )
+
+
+def pyvista_inside(mesh, x, y, z):
+    X, Y, Z = np.meshgrid(x, y, z, indexing="ij")
+    cloud = pv.PolyData(np.column_stack([X.ravel(), Y.ravel(), Z.ravel()]))
+    sel = cloud.select_enclosed_points(mesh, tolerance=0.0, check_surface=False)
+    inside = np.asarray(sel.point_data["SelectedPoints"]).astype(bool).reshape((len(x), len(y), len(z)))
+    return BitMask.from_bool(inside)
+
+
+def native_inside(mesh, x, y, z):
+    triangles = np.asarray(mesh.faces).reshape(-1, 4)[:, 1:]
+    packed, _ = fluid_native.voxelize(np.asarray(mesh.points, dtype=np.float32), triangles, x, y, z)
+    return BitMask(packed, len(z))
+
+
+def measure(fn, repeat: int, *args):
+    tracemalloc.start()
+    t0 = time.perf_counter()
+    for _ in range(repeat):
+        out = fn(*args)
+    secs = (time.perf_counter() - t0) / repeat
+    _, peak = tracemalloc.get_traced_memory()
+    tracemalloc.stop()
+    return out, secs, peak
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--stl", type=str, default=str(DEFAULT_STL))
+    ap.add_argument("--base-res", type=int, nargs="+", default=[128, 192, 256, 320])
+    ap.add_argument("--repeat", type=int, default=3)
+    ap.add_argument("--skip-pyvista", action="store_true")
+    args = ap.parse_args()
+
+    if not NATIVE_AVAILABLE:
+        print("[Bench] fluid_native not built - see backend/README.md")
+        return 1
+
+    mesh = pv.read(args.stl).clean().triangulate()
+    triangles = np.asarray(mesh.faces).reshape(-1, 4)[:, 1:]
+    _, info = fluid_native.voxelize(np.asarray(mesh.points, dtype=np.float32), triangles, *lattice(mesh, 64))
+    print(f"[Bench] {Path(args.stl).name}: {mesh.n_points:,} vertices, {mesh.n_cells:,} triangles"
+          f" ({info['odd_columns']} open columns at base-res 64)")
+    print(f"  {'base-res':>8s} {'grid':>14s} {'cells':>11s} {'path':8s} {'time':>9s} {'numpy peak':>11s} {'inside':>9s} {'differ':>7s}")
+
+    for base_res in args.base_res:
+        x, y, z = lattice(mesh, base_res)
+        grid = f"{len(x)}x{len(y)}x{len(z)}"
+        cells = len(x) * len(y) * len(z)
+        native, t_native, m_native = measure(native_inside, args.repeat, mesh, x, y, z)
+        rows = [("native", native, t_native, m_native)]
+        if not args.skip_pyvista:
+            ref, t_ref, m_ref = measure(pyvista_inside, 1, mesh, x, y, z)
+            rows.insert(0, ("pyvista", ref, t_ref, m_ref))
+        for name, inside, secs, peak in rows:
+            differ = BitMask(inside.words ^ rows[0][1].words, len(z)).count()
+            print(f"  {base_res:8d} {grid:>14s} {cells:11,d} {name:8s} {secs * 1e3:7.1f}ms {peak / 1e6:9.1f}MB"
+                  f" {inside.count():9,d} {differ:7d}")
+        if not args.skip_pyvista:
+            print(f"  {'':8s} {'':14s} {'':11s} speedup  {t_ref / t_native:7.1f}x")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
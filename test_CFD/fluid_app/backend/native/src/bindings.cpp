@@ -0,0 +1,592 @@
+// pybind11 bindings for the native solver module (imported as sim.fluid_native).
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "bit_mask.hpp"
+#include "collide_kernel.hpp"
+#include "distance_transform.hpp"
+#include "lbm_engine.hpp"
+#include "numa.hpp"
+#include "particle_advect.hpp"
+#include "region_select.hpp"
+#include "slab_lbm.hpp"
+#include "stl_mesh.hpp"
+#include "voxelize.hpp"
+
+namespace py = pybind11;
+
+namespace {
+
+using ByteArray = py::array_t<uint8_t, py::array::c_style | py::array::forcecast>;
+using WordArray = py::array_t<uint64_t, py::array::c_style | py::array::forcecast>;
+
+// View of a (nx, ny, ceil(nz / 64)) uint64 mask bit-packed along z (sim/bitmask.py).
+fluid::BitMaskView mask_view(const WordArray& a, int nx, int ny, int nz, const char* name) {
+  if (a.ndim() != 3 || a.shape(0) != nx || a.shape(1) != ny || a.shape(2) != fluid::packed_words(nz)) {
+    throw std::invalid_argument(std::string(name) + " must have shape (nx, ny, ceil(nz / 64))");
+  }
+  return {a.data(), nx, ny, nz};
+}
+
+py::array_t<uint64_t> mask_array(const fluid::BitMask& mask) {
+  py::array_t<uint64_t> out({mask.nx(), mask.ny(), mask.row_words()});
+  std::copy(mask.words().begin(), mask.words().end(), out.mutable_data());
+  return out;
+}
+
+using GridGetter = void (fluid::LbmEngine::*)(float*) const;
+
+py::array_t<float> grid_copy(const fluid::LbmEngine& e, GridGetter getter) {
+  py::array_t<float> out({e.nx(), e.ny(), e.nz()});
+  (e.*getter)(out.mutable_data());
+  return out;
+}
+
+constexpr fluid::KernelIsa kAllIsas[] = {fluid::KernelIsa::kScalar, fluid::KernelIsa::kAvx2,
+                                         fluid::KernelIsa::kAvx512};
+
+fluid::KernelIsa isa_from_name(const std::string& name) {
+  for (fluid::KernelIsa isa : kAllIsas) {
+    if (name == fluid::kernel_isa_name(isa)) return isa;
+  }
+  throw std::invalid_argument("unknown kernel ISA: " + name);
+}
+
+constexpr fluid::Precision kAllPrecisions[] = {fluid::Precision::kFloat32, fluid::Precision::kFloat16,
+                                               fluid::Precision::kBFloat16};
+
+fluid::Precision precision_from_name(const std::string& name) {
+  for (fluid::Precision p : kAllPrecisions) {
+    if (name == fluid::precision_name(p)) return p;
+  }
+  throw std::invalid_argument("unknown population precision: " + name + " (fp32, fp16 or bf16)");
+}
+
+constexpr fluid::HugePages kAllHugePages[] = {fluid::HugePages::kOff, fluid::HugePages::kTransparent,
+                                              fluid::HugePages::kExplicit};
+
+fluid::HugePages huge_pages_from_name(const std::string& name) {
+  for (fluid::HugePages h : kAllHugePages) {
+    if (name == fluid::huge_pages_name(h)) return h;
+  }
+  throw std::invalid_argument("unknown huge page mode: " + name + " (off, transparent or explicit)");
+}
+
+// NUMA node of each page of a contiguous array (empty where unknown).
+py::array_t<int32_t> page_nodes(const py::array& a) {
+  if (!(a.flags() & py::array::c_style)) {
+    throw std::invalid_argument("array must be C-contiguous");
+  }
+  const std::vector<int> nodes = fluid::page_nodes(a.data(), static_cast<size_t>(a.nbytes()));
+  py::array_t<int32_t> out(static_cast<py::ssize_t>(nodes.size()));
+  std::copy(nodes.begin(), nodes.end(), out.mutable_data());
+  return out;
+}
+
+// Shared halo block for fluid::SharedMemoryHalo: any writable buffer, here a
+// multiprocessing.shared_memory segment mapped by every rank.
+fluid::SharedMemoryHalo* make_shared_halo(const py::buffer& region, int rank, int ranks,
+                                          size_t capacity) {
+  const py::buffer_info info = region.request(true);
+  return new fluid::SharedMemoryHalo(info.ptr, static_cast<size_t>(info.size * info.itemsize),
+                                     rank, ranks, capacity);
+}
+
+constexpr fluid::Integrator kAllIntegrators[] = {fluid::Integrator::kEuler, fluid::Integrator::kRk2,
+                                                 fluid::Integrator::kRk4};
+
+fluid::Integrator integrator_from_name(const std::string& name) {
+  for (fluid::Integrator i : kAllIntegrators) {
+    if (name == fluid::integrator_name(i)) return i;
+  }
+  throw std::invalid_argument("unknown particle integrator: " + name + " (euler, rk2 or rk4)");
+}
+
+using FloatArray = py::array_t<float, py::array::c_style | py::array::forcecast>;
+
+const float* grid_ptr(const FloatArray& a, size_t expected, const char* name) {
+  if (static_cast<size_t>(a.size()) != expected) {
+    throw std::invalid_argument(std::string(name) + " field does not match grid size");
+  }
+  return a.data();
+}
+
+// Run the selected collision kernel on a (19, n) block of populations, the
+// way the engine does after streaming. Used by bench/bench_kernels.py to check
+// every ISA against the torch reference.
+py::tuple collide_block(const FloatArray& f, const ByteArray& flags, float omega,
+                        const std::array<float, 3>& gravity,
+                        const std::array<float, 3>& inlet_velocity) {
+  if (f.ndim() != 2 || f.shape(0) != fluid::kQ) {
+    throw std::invalid_argument("f must have shape (19, n)");
+  }
+  const py::ssize_t n = f.shape(1);
+  if (flags.size() != n) {
+    throw std::invalid_argument("flags must have one entry per cell");
+  }
+
+  fluid::CollideParams p;
+  p.omega = omega;
+  p.gx = gravity[0];
+  p.gy = gravity[1];
+  p.gz = gravity[2];
+  p.forcing = std::sqrt(p.gx * p.gx + p.gy * p.gy + p.gz * p.gz) > 1e-12f;
+  const fluid::BlockParams bp = fluid::make_block_params(p, inlet_velocity.data());
+
+  py::array_t<float> f_out({static_cast<py::ssize_t>(fluid::kQ), n});
+  py::array_t<float> rho(n), ux(n), uy(n), uz(n);
+  std::copy(f.data(), f.data() + f.size(), f_out.mutable_data());
+
+  fluid::BlockOutputs out;
+  out.rho = rho.mutable_data();
+  out.ux = ux.mutable_data();
+  out.uy = uy.mutable_data();
+  out.uz = uz.mutable_data();
+  {
+    py::gil_scoped_release release;
+    fluid::collide_kernel()(f_out.mutable_data(), static_cast<int>(n), static_cast<int>(n),
+                            flags.data(), bp, out);
+  }
+  return py::make_tuple(f_out, rho, ux, uy, uz);
+}
+
+using IndexArray = py::array_t<int32_t, py::array::c_style | py::array::forcecast>;
+
+// Inside/outside of the grid points for a closed triangle mesh, as a
+// (nx, ny, ceil(nz / 64)) uint64 array bit-packed along z (see bit_mask.hpp),
+// plus crossing statistics.
+py::tuple voxelize(const FloatArray& vertices, const IndexArray& triangles, const FloatArray& x,
+                   const FloatArray& y, const FloatArray& z) {
+  if (vertices.ndim() != 2 || vertices.shape(1) != 3) {
+    throw std::invalid_argument("vertices must have shape (n, 3)");
+  }
+  if (triangles.ndim() != 2 || triangles.shape(1) != 3) {
+    throw std::invalid_argument("triangles must have shape (n, 3)");
+  }
+  const int nx = static_cast<int>(x.size());
+  const int ny = static_cast<int>(y.size());
+  const int nz = static_cast<int>(z.size());
+  fluid::VoxelizeStats stats;
+  fluid::BitMask inside;
+  {
+    py::gil_scoped_release release;
+    inside = fluid::voxelize_inside(vertices.data(), static_cast<size_t>(vertices.shape(0)),
+                                    triangles.data(), static_cast<size_t>(triangles.shape(0)),
+                                    x.data(), nx, y.data(), ny, z.data(), nz, &stats);
+  }
+  py::array_t<uint64_t> out = mask_array(inside);
+  py::dict info;
+  info["crossings"] = stats.crossings;
+  info["odd_columns"] = stats.odd_columns;
+  info["disputed_cells"] = stats.disputed_cells;
+  info["unresolved_cells"] = stats.unresolved_cells;
+  return py::make_tuple(out, info);
+}
+
+// Signed distance (cells * scale, + in fluid, - in solid) of a solid mask
+// bit-packed along z as (nx, ny, ceil(nz / 64)) uint64, see distance_transform.hpp.
+py::array_t<float> signed_distance(const WordArray& solid, int nz, int band, float scale) {
+  if (solid.ndim() != 3) {
+    throw std::invalid_argument("solid must have shape (nx, ny, ceil(nz / 64))");
+  }
+  const int nx = static_cast<int>(solid.shape(0));
+  const int ny = static_cast<int>(solid.shape(1));
+  const fluid::BitMaskView view = mask_view(solid, nx, ny, nz, "solid");
+  py::array_t<float> out({nx, ny, nz});
+  float* o = out.mutable_data();
+  {
+    py::gil_scoped_release release;
+    fluid::signed_distance(view, band, scale, o);
+  }
+  return out;
+}
+
+// Cells of the grid x, y, z within `radius` of `center` and clear in the
+// bit-packed `exclude` mask, bit-packed the same way (see region_select.hpp).
+py::array_t<uint64_t> select_sphere(const FloatArray& x, const FloatArray& y, const FloatArray& z,
+                                    const std::array<float, 3>& center, float radius,
+                                    const WordArray& exclude) {
+  const int nx = static_cast<int>(x.size());
+  const int ny = static_cast<int>(y.size());
+  const int nz = static_cast<int>(z.size());
+  const fluid::BitMaskView view = mask_view(exclude, nx, ny, nz, "exclude");
+  fluid::BitMask mask;
+  {
+    py::gil_scoped_release release;
+    mask = fluid::select_sphere(x.data(), nx, y.data(), ny, z.data(), nz, center, radius, view);
+  }
+  return mask_array(mask);
+}
+
+// Flat indices of the `count` fluid cells of the bit-packed solid mask nearest
+// to `point`, nearest first.
+py::array_t<int64_t> nearest_fluid_cells(const WordArray& solid, const FloatArray& x,
+                                         const FloatArray& y, const FloatArray& z,
+                                         const std::array<float, 3>& point, size_t count) {
+  const int nx = static_cast<int>(x.size());
+  const int ny = static_cast<int>(y.size());
+  const int nz = static_cast<int>(z.size());
+  const fluid::BitMaskView view = mask_view(solid, nx, ny, nz, "solid");
+  std::vector<int64_t> cells;
+  {
+    py::gil_scoped_release release;
+    cells = fluid::nearest_fluid_cells(view, x.data(), y.data(), z.data(), point, count);
+  }
+  py::array_t<int64_t> out(static_cast<py::ssize_t>(cells.size()));
+  std::copy(cells.begin(), cells.end(), out.mutable_data());
+  return out;
+}
+
+// Advector over the (nx, ny, nz) velocity and signed distance fields on the
+// grid x, y, z (see particle_advect.hpp).
+fluid::ParticleAdvector* make_advector(const FloatArray& x, const FloatArray& y, const FloatArray& z,
+                                       const FloatArray& ux, const FloatArray& uy,
+                                       const FloatArray& uz, const FloatArray& sdf) {
+  const int nx = static_cast<int>(x.size());
+  const int ny = static_cast<int>(y.size());
+  const int nz = static_cast<int>(z.size());
+  const size_t n = static_cast<size_t>(nx) * ny * nz;
+  return new fluid::ParticleAdvector(x.data(), nx, y.data(), ny, z.data(), nz, grid_ptr(ux, n, "ux"),
+                                     grid_ptr(uy, n, "uy"), grid_ptr(uz, n, "uz"),
+                                     grid_ptr(sdf, n, "sdf"));
+}
+
+py::dict advect_stats(const fluid::AdvectStats& stats) {
+  py::dict info;
+  info["respawned"] = stats.respawned;
+  info["collisions"] = stats.collisions;
+  info["particle_steps"] = stats.particle_steps;
+  info["substeps"] = stats.substeps;
+  return info;
+}
+
+// Next n_frames as (n_frames, n_particles, 3) positions, plus step counts.
+py::tuple advect_advance(fluid::ParticleAdvector& advector, int n_frames) {
+  py::array_t<float> frames({n_frames, advector.num_particles(), 3});
+  float* f = frames.mutable_data();
+  fluid::AdvectStats stats;
+  {
+    py::gil_scoped_release release;
+    stats = advector.advance(n_frames, f);
+  }
+  return py::make_tuple(frames, advect_stats(stats));
+}
+
+py::tuple advect_run(fluid::ParticleAdvector& advector, int n_particles, int n_frames,
+                     const fluid::AdvectParams& params) {
+  advector.start(n_particles, params);
+  return advect_advance(advector, n_frames);
+}
+
+const float* points_ptr(const FloatArray& points) {
+  if (points.ndim() != 2 || points.shape(1) != 3) {
+    throw std::invalid_argument("points must have shape (n, 3)");
+  }
+  return points.data();
+}
+
+py::array_t<bool> mesh_inside(const fluid::TriMesh& mesh, const FloatArray& points) {
+  const float* p = points_ptr(points);
+  const int n = static_cast<int>(points.shape(0));
+  py::array_t<bool> out(n);
+  bool* o = out.mutable_data();
+  {
+    py::gil_scoped_release release;
+#pragma omp parallel for schedule(dynamic, 256)
+    for (int i = 0; i < n; ++i) o[i] = mesh.inside(p + 3 * static_cast<size_t>(i));
+  }
+  return out;
+}
+
+// Closest surface point, distance and triangle index for each query point.
+py::tuple mesh_closest_point(const fluid::TriMesh& mesh, const FloatArray& points) {
+  const float* p = points_ptr(points);
+  const int n = static_cast<int>(points.shape(0));
+  py::array_t<float> closest({n, 3});
+  py::array_t<float> distance(n);
+  py::array_t<int32_t> triangle(n);
+  float* c = closest.mutable_data();
+  float* d = distance.mutable_data();
+  int32_t* t = triangle.mutable_data();
+  {
+    py::gil_scoped_release release;
+#pragma omp parallel for schedule(dynamic, 256)
+    for (int i = 0; i < n; ++i) {
+      const size_t k = 3 * static_cast<size_t>(i);
+      d[i] = static_cast<float>(mesh.closest_point(p + k, c + k, t + i));
+    }
+  }
+  return py::make_tuple(closest, distance, triangle);
+}
+
+}  // namespace
+
+PYBIND11_MODULE(fluid_native, m) {
+  m.doc() = "Native multicore D3Q19 LBM engine";
+
+  m.def("max_threads", []() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+  });
+  m.def("set_num_threads", [](int n) {
+#ifdef _OPENMP
+    omp_set_num_threads(n);
+#else
+    (void)n;
+#endif
+  });
+
+  m.def("kernel_isa", []() { return std::string(fluid::kernel_isa_name(fluid::kernel_isa())); },
+        "Instruction set of the active collision kernel");
+  m.def(
+      "set_kernel_isa",
+      [](const std::string& name) { fluid::set_kernel_isa(isa_from_name(name)); },
+      py::arg("name"), "Select 'scalar', 'avx2' or 'avx512' (must be supported by this CPU)");
+  m.def("supported_kernel_isas", []() {
+    std::vector<std::string> names;
+    for (fluid::KernelIsa isa : kAllIsas) {
+      if (fluid::kernel_isa_supported(isa)) names.emplace_back(fluid::kernel_isa_name(isa));
+    }
+    return names;
+  });
+  m.def("collide_block", &collide_block, py::arg("f"), py::arg("flags"), py::arg("omega"),
+        py::arg("gravity"), py::arg("inlet_velocity") = std::array<float, 3>{0.0f, 0.0f, 0.0f});
+  m.def("page_nodes", &page_nodes, py::arg("array"),
+        "NUMA node of each page of the array (-1 not resident; empty if unknown)");
+  m.def(
+      "halo_capacity",
+      [](int ny, int nz, const std::string& precision) {
+        return fluid::halo_capacity(ny, nz, precision_from_name(precision));
+      },
+      py::arg("ny"), py::arg("nz"), py::arg("precision") = "fp32",
+      "Largest halo message (bytes) of a slab engine with (ny, nz) planes");
+  m.def("halo_region_bytes", &fluid::SharedMemoryHalo::region_bytes, py::arg("ranks"),
+        py::arg("capacity"), "Bytes of the shared block behind SharedMemoryHalo");
+  m.def(
+      "halo_abort",
+      [](const py::buffer& region) {
+        fluid::SharedMemoryHalo::abort_region(region.request(true).ptr);
+      },
+      py::arg("region"), "Abort the halo exchange of every rank on this shared block");
+  m.def("slab_bounds",
+        [](int nx, int rank, int ranks) {
+          const fluid::SlabBounds b = fluid::slab_bounds(nx, rank, ranks);
+          return py::make_tuple(b.x0, b.x1);
+        },
+        py::arg("nx"), py::arg("rank"), py::arg("ranks"), "x planes [x0, x1) owned by a rank");
+  m.def("voxelize", &voxelize, py::arg("vertices"), py::arg("triangles"), py::arg("x"),
+        py::arg("y"), py::arg("z"));
+  m.def("signed_distance", &signed_distance, py::arg("solid"), py::arg("nz"), py::arg("band") = 0,
+        py::arg("scale") = 1.0f);
+  m.def("select_sphere", &select_sphere, py::arg("x"), py::arg("y"), py::arg("z"),
+        py::arg("center"), py::arg("radius"), py::arg("exclude"));
+  m.def("nearest_fluid_cells", &nearest_fluid_cells, py::arg("solid"), py::arg("x"), py::arg("y"),
+        py::arg("z"), py::arg("point"), py::arg("count"));
+
+  // Mirrors the bits of pyvista.PolyData that sim/domain.py uses (points,
+  // bounds, n_points, n_cells) so the two are interchangeable there.
+  py::class_<fluid::TriMesh>(m, "StlMesh")
+      .def(py::init([](const std::string& path, float weld_tolerance) {
+             py::gil_scoped_release release;
+             return new fluid::TriMesh(fluid::TriMesh::load_stl(path, weld_tolerance));
+           }),
+           py::arg("path"), py::arg("weld_tolerance") = 0.0f)
+      .def_property_readonly("points",
+                             [](py::object self) {
+                               auto& mesh = self.cast<fluid::TriMesh&>();
+                               return py::array_t<float>(
+                                   {static_cast<py::ssize_t>(mesh.num_vertices()), py::ssize_t(3)},
+                                   mesh.vertices(), self);
+                             })
+      .def_property_readonly("triangles",
+                             [](py::object self) {
+                               auto& mesh = self.cast<fluid::TriMesh&>();
+                               return py::array_t<int32_t>(
+                                   {static_cast<py::ssize_t>(mesh.num_triangles()), py::ssize_t(3)},
+                                   mesh.triangles(), self);
+                             })
+      .def_property_readonly("bounds",
+                             [](const fluid::TriMesh& mesh) {
+                               const float* lo = mesh.lo();
+                               const float* hi = mesh.hi();
+                               return py::make_tuple(lo[0], hi[0], lo[1], hi[1], lo[2], hi[2]);
+                             })
+      .def_property_readonly("n_points", &fluid::TriMesh::num_vertices)
+      .def_property_readonly("n_cells", &fluid::TriMesh::num_triangles)
+      .def_property_readonly("memory_bytes", &fluid::TriMesh::memory_bytes)
+      .def_property_readonly("bvh_nodes", &fluid::TriMesh::bvh_nodes)
+      .def_property_readonly("load_stats",
+                             [](const fluid::TriMesh& mesh) {
+                               const fluid::MeshLoadStats& s = mesh.load_stats();
+                               py::dict info;
+                               info["file_bytes"] = s.file_bytes;
+                               info["binary"] = s.binary;
+                               info["raw_triangles"] = s.raw_triangles;
+                               info["dropped_triangles"] = s.dropped_triangles;
+                               info["read_ms"] = s.read_ms;
+                               info["weld_ms"] = s.weld_ms;
+                               info["bvh_ms"] = s.bvh_ms;
+                               return info;
+                             })
+      .def("inside", &mesh_inside, py::arg("points"))
+      .def("closest_point", &mesh_closest_point, py::arg("points"));
+
+  py::class_<fluid::AdvectParams>(m, "AdvectParams")
+      .def(py::init<>())
+      .def_readwrite("source", &fluid::AdvectParams::source)
+      .def_readwrite("gravity", &fluid::AdvectParams::gravity)
+      .def_readwrite("emit_radius", &fluid::AdvectParams::emit_radius)
+      .def_readwrite("emit_speed", &fluid::AdvectParams::emit_speed)
+      .def_readwrite("velocity_scale", &fluid::AdvectParams::velocity_scale)
+      .def_readwrite("gravity_accel", &fluid::AdvectParams::gravity_accel)
+      .def_readwrite("max_gravity_speed", &fluid::AdvectParams::max_gravity_speed)
+      .def_readwrite("surface_thickness", &fluid::AdvectParams::surface_thickness)
+      .def_readwrite("surface_attraction", &fluid::AdvectParams::surface_attraction)
+      .def_readwrite("max_distance_from_surface", &fluid::AdvectParams::max_distance_from_surface)
+      .def_readwrite("respawn_depth", &fluid::AdvectParams::respawn_depth)
+      .def_readwrite("collision_push", &fluid::AdvectParams::collision_push)
+      .def_readwrite("max_speed", &fluid::AdvectParams::max_speed)
+      .def_readwrite("gradient_eps", &fluid::AdvectParams::gradient_eps)
+      .def_readwrite("domain_margin", &fluid::AdvectParams::domain_margin)
+      .def_readwrite("max_age", &fluid::AdvectParams::max_age)
+      .def_readwrite("emission_frames", &fluid::AdvectParams::emission_frames)
+      .def_readwrite("seed", &fluid::AdvectParams::seed)
+      .def_property(
+          "integrator",
+          [](const fluid::AdvectParams& p) { return std::string(fluid::integrator_name(p.integrator)); },
+          [](fluid::AdvectParams& p, const std::string& name) { p.integrator = integrator_from_name(name); })
+      .def_readwrite("cfl", &fluid::AdvectParams::cfl)
+      .def_readwrite("max_substeps", &fluid::AdvectParams::max_substeps);
+
+  py::class_<fluid::ParticleAdvector>(m, "ParticleAdvector")
+      .def(py::init(&make_advector), py::arg("x"), py::arg("y"), py::arg("z"), py::arg("ux"),
+           py::arg("uy"), py::arg("uz"), py::arg("sdf"))
+      .def("run", &advect_run, py::arg("n_particles"), py::arg("n_frames"), py::arg("params"))
+      .def("start", &fluid::ParticleAdvector::start, py::arg("n_particles"), py::arg("params"))
+      .def("advance", &advect_advance, py::arg("n_frames"))
+      .def_property_readonly("frame", &fluid::ParticleAdvector::frame)
+      .def_property_readonly("birth_frames",
+                             [](const fluid::ParticleAdvector& a) {
+                               const std::vector<int32_t>& birth = a.birth_frames();
+                               py::array_t<int32_t> out(static_cast<py::ssize_t>(birth.size()));
+                               std::copy(birth.begin(), birth.end(), out.mutable_data());
+                               return out;
+                             })
+      .def_property_readonly("memory_bytes", &fluid::ParticleAdvector::memory_bytes);
+
+  py::class_<fluid::LbmEngine>(m, "LbmEngine")
+      .def(py::init([](int nx, int ny, int nz, float nu_lbm, const WordArray& solid,
+                       const WordArray& inlet, const WordArray& outlet,
+                       const std::array<float, 3>& gravity_lbm, bool sparse,
+                       const std::string& precision, const std::vector<int>& cpus,
+                       const std::string& huge_pages) {
+             return new fluid::LbmEngine(nx, ny, nz, nu_lbm, mask_view(solid, nx, ny, nz, "solid"),
+                                         mask_view(inlet, nx, ny, nz, "inlet"),
+                                         mask_view(outlet, nx, ny, nz, "outlet"), gravity_lbm,
+                                         sparse, precision_from_name(precision), cpus,
+                                         huge_pages_from_name(huge_pages));
+           }),
+           py::arg("nx"), py::arg("ny"), py::arg("nz"), py::arg("nu_lbm"), py::arg("solid"),
+           py::arg("inlet"), py::arg("outlet"), py::arg("gravity_lbm"),
+           py::arg("sparse") = false, py::arg("precision") = "fp32",
+           py::arg("cpus") = std::vector<int>(), py::arg("huge_pages") = "off")
+      .def("set_inlet_direction", &fluid::LbmEngine::set_inlet_direction)
+      .def("set_gravity", &fluid::LbmEngine::set_gravity)
+      .def("set_temporal_blocking", &fluid::LbmEngine::set_temporal_blocking, py::arg("steps"),
+           py::arg("tile_y"))
+      .def("run", &fluid::LbmEngine::run, py::arg("steps"), py::arg("inlet_speed"),
+           py::arg("update_fill") = true, py::arg("measure_residual") = false,
+           py::call_guard<py::gil_scoped_release>())
+      .def("set_ghost_planes", &fluid::LbmEngine::set_ghost_planes, py::arg("on"))
+      .def_property_readonly("nx", &fluid::LbmEngine::nx)
+      .def_property_readonly("ny", &fluid::LbmEngine::ny)
+      .def_property_readonly("nz", &fluid::LbmEngine::nz)
+      .def_property_readonly("nu", &fluid::LbmEngine::nu)
+      .def_property_readonly("tau", &fluid::LbmEngine::tau)
+      .def_property_readonly("omega", &fluid::LbmEngine::omega)
+      .def_property_readonly("sparse", &fluid::LbmEngine::sparse)
+      .def_property_readonly("precision",
+                             [](const fluid::LbmEngine& e) {
+                               return std::string(fluid::precision_name(e.precision()));
+                             })
+      .def_property_readonly("stored_cells", &fluid::LbmEngine::stored_cells)
+      .def_property_readonly("steps_done", &fluid::LbmEngine::steps_done)
+      .def_property_readonly("residual", &fluid::LbmEngine::residual)
+      .def_property_readonly("residual_sums", &fluid::LbmEngine::residual_sums)
+      .def_property_readonly("ghost_planes", &fluid::LbmEngine::ghost_planes)
+      .def_property_readonly("odd_next", &fluid::LbmEngine::odd_next)
+      .def_property_readonly("block_steps", &fluid::LbmEngine::block_steps)
+      .def_property_readonly("block_tile_y", &fluid::LbmEngine::block_tile_y)
+      .def_property_readonly("thread_cpus", &fluid::LbmEngine::thread_cpus)
+      .def_property_readonly("huge_pages",
+                             [](const fluid::LbmEngine& e) {
+                               return std::string(fluid::huge_pages_name(e.huge_pages()));
+                             })
+      // Zero-copy views of the raw state (kept alive by the engine object),
+      // used by sim/checkpoint.py.
+      .def_property_readonly("populations",
+                             [](py::object self) {
+                               auto& e = self.cast<fluid::LbmEngine&>();
+                               const std::vector<py::ssize_t> shape = {
+                                   fluid::kQ, static_cast<py::ssize_t>(e.stored_cells())};
+                               const py::dtype dt = e.precision() == fluid::Precision::kFloat32
+                                                        ? py::dtype::of<float>()
+                                                        : py::dtype::of<uint16_t>();
+                               return py::array(dt, shape, e.population_data(), self);
+                             })
+      .def_property_readonly("fill_state",
+                             [](py::object self) {
+                               auto& e = self.cast<fluid::LbmEngine&>();
+                               return py::array_t<float>(
+                                   {static_cast<py::ssize_t>(e.stored_cells())}, e.fill_data(), self);
+                             })
+      .def(
+          "init_from_fields",
+          [](fluid::LbmEngine& e, const FloatArray& rho, const FloatArray& ux, const FloatArray& uy,
+             const FloatArray& uz, const FloatArray& fill) {
+            const size_t n = e.cells();
+            e.init_from_fields(grid_ptr(rho, n, "rho"), grid_ptr(ux, n, "ux"), grid_ptr(uy, n, "uy"),
+                               grid_ptr(uz, n, "uz"), grid_ptr(fill, n, "fill"));
+          },
+          py::arg("rho"), py::arg("ux"), py::arg("uy"), py::arg("uz"), py::arg("fill"))
+      .def("restore_progress", &fluid::LbmEngine::restore_progress, py::arg("steps_done"),
+           py::arg("odd_next"))
+      .def_property_readonly("memory_bytes", &fluid::LbmEngine::memory_bytes)
+      .def("rho", [](const fluid::LbmEngine& e) { return grid_copy(e, &fluid::LbmEngine::rho); })
+      .def("ux", [](const fluid::LbmEngine& e) { return grid_copy(e, &fluid::LbmEngine::ux); })
+      .def("uy", [](const fluid::LbmEngine& e) { return grid_copy(e, &fluid::LbmEngine::uy); })
+      .def("uz", [](const fluid::LbmEngine& e) { return grid_copy(e, &fluid::LbmEngine::uz); })
+      .def("fill_level",
+           [](const fluid::LbmEngine& e) { return grid_copy(e, &fluid::LbmEngine::fill_level); });
+
+  py::class_<fluid::HaloTransport>(m, "HaloTransport");
+  py::class_<fluid::SharedMemoryHalo, fluid::HaloTransport>(m, "SharedMemoryHalo")
+      .def(py::init(&make_shared_halo), py::arg("region"), py::arg("rank"), py::arg("ranks"),
+           py::arg("capacity"), py::keep_alive<1, 2>())
+      .def("abort", &fluid::SharedMemoryHalo::abort);
+
+  // One rank of a slab decomposition (sim/lbm_slabs.py); keeps the engine and
+  // the transport alive.
+  py::class_<fluid::SlabLbm>(m, "SlabLbm")
+      .def(py::init<fluid::LbmEngine&, fluid::HaloTransport&>(), py::arg("engine"),
+           py::arg("halo"), py::keep_alive<1, 2>(), py::keep_alive<1, 3>())
+      .def("run", &fluid::SlabLbm::run, py::arg("steps"), py::arg("inlet_speed"),
+           py::arg("update_fill") = true, py::arg("measure_residual") = false,
+           py::call_guard<py::gil_scoped_release>())
+      .def("sync", &fluid::SlabLbm::sync, py::call_guard<py::gil_scoped_release>())
+      .def_property_readonly("wait_seconds", &fluid::SlabLbm::wait_seconds);
+}
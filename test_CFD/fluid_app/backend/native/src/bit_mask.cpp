@@ -0,0 +1,38 @@
+#include "bit_mask.hpp"
+
+#include "cpu_features.hpp"
+
+namespace fluid {
+
+namespace {
+
+using PopcountFn = size_t (*)(const uint64_t*, size_t);
+
+// Portable count; the compiler may turn it into POPCNT but doesn't have to.
+size_t popcount_scalar(const uint64_t* words, size_t n) {
+  size_t total = 0;
+  for (size_t i = 0; i < n; ++i) {
+    uint64_t x = words[i];
+    x -= (x >> 1) & 0x5555555555555555ULL;
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    total += static_cast<size_t>((x * 0x0101010101010101ULL) >> 56);
+  }
+  return total;
+}
+
+PopcountFn pick_popcount() {
+#ifdef FLUID_HAVE_X86_KERNELS
+  if (cpu_features().avx2_fma) return popcount_avx2;
+#endif
+  return popcount_scalar;
+}
+
+}  // namespace
+
+size_t popcount(const uint64_t* words, size_t n) {
+  static const PopcountFn fn = pick_popcount();
+  return fn(words, n);
+}
+
+}  // namespace fluid
@@ -0,0 +1,106 @@
+// Bit-packed voxel masks, shared by the voxelizer, the LBM engine and the
+// distance transform (and, through the Python BitMask in sim/bitmask.py, by
+// the domain builder and the result writer).
+//
+// One bit per cell of a C-ordered (nx, ny, nz) grid, packed along z: the row
+// of cell (i, j) is packed_words(nz) consecutive uint64 words starting at word
+// (i * ny + j) * packed_words(nz), and cell k is bit k % 64 of word k / 64.
+// Rows start on a word boundary and the padding bits past nz are always
+// zero, so counts and boolean operations work on whole words.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace fluid {
+
+// Words per z row of a packed (nx, ny, nz) mask.
+inline int packed_words(int nz) { return (nz + 63) / 64; }
+
+inline bool test_bit(const uint64_t* row, int k) { return (row[k >> 6] >> (k & 63)) & 1u; }
+
+inline void set_bit(uint64_t* row, int k) { row[k >> 6] |= uint64_t{1} << (k & 63); }
+
+// Index of the lowest set bit of a non-zero word.
+inline int lowest_bit(uint64_t w) {
+#if defined(_MSC_VER)
+  unsigned long i;
+  _BitScanForward64(&i, w);
+  return static_cast<int>(i);
+#else
+  return __builtin_ctzll(w);
+#endif
+}
+
+// Set bits in words[0, n): AVX2 when the CPU has it, else a 64-bit SWAR count.
+size_t popcount(const uint64_t* words, size_t n);
+
+// f(k) for every set (kSet) or clear cell k of a row of nz cells, in
+// increasing k. Walks the set bits of each word, so sparse rows cost little.
+template <bool kSet = true, class F>
+void for_each_bit(const uint64_t* row, int nz, F&& f) {
+  const int wz = packed_words(nz);
+  for (int w = 0; w < wz; ++w) {
+    uint64_t bits = kSet ? row[w] : ~row[w];
+    if (!kSet && w == wz - 1 && (nz & 63)) bits &= (uint64_t{1} << (nz & 63)) - 1;
+    while (bits) {
+      f(w * 64 + lowest_bit(bits));
+      bits &= bits - 1;
+    }
+  }
+}
+
+// Read-only view of a packed mask owned elsewhere (a BitMask, a numpy array).
+// A null `words` stands for an all-clear mask.
+struct BitMaskView {
+  const uint64_t* words = nullptr;
+  int nx = 0, ny = 0, nz = 0;
+
+  int row_words() const { return packed_words(nz); }
+  size_t size_words() const { return static_cast<size_t>(nx) * ny * row_words(); }
+  const uint64_t* row(int i, int j) const {
+    return words + (static_cast<size_t>(i) * ny + j) * row_words();
+  }
+  bool test(int i, int j, int k) const { return words && test_bit(row(i, j), k); }
+  size_t count() const { return words ? popcount(words, size_words()) : 0; }
+};
+
+class BitMask {
+ public:
+  BitMask() = default;
+  // All cells clear.
+  BitMask(int nx, int ny, int nz)
+      : nx_(nx), ny_(ny), nz_(nz),
+        words_(static_cast<size_t>(nx) * ny * packed_words(nz), 0) {}
+
+  int nx() const { return nx_; }
+  int ny() const { return ny_; }
+  int nz() const { return nz_; }
+  int row_words() const { return packed_words(nz_); }
+  uint64_t* row(int i, int j) {
+    return words_.data() + (static_cast<size_t>(i) * ny_ + j) * row_words();
+  }
+  const uint64_t* row(int i, int j) const { return view().row(i, j); }
+  bool test(int i, int j, int k) const { return test_bit(row(i, j), k); }
+  void set(int i, int j, int k) { set_bit(row(i, j), k); }
+  size_t count() const { return popcount(words_.data(), words_.size()); }
+
+  const std::vector<uint64_t>& words() const { return words_; }
+  size_t memory_bytes() const { return words_.size() * sizeof(uint64_t); }
+  BitMaskView view() const { return {words_.data(), nx_, ny_, nz_}; }
+
+ private:
+  int nx_ = 0, ny_ = 0, nz_ = 0;
+  std::vector<uint64_t> words_;
+};
+
+#ifdef FLUID_HAVE_X86_KERNELS
+size_t popcount_avx2(const uint64_t* words, size_t n);
+#endif
+
+}  // namespace fluid
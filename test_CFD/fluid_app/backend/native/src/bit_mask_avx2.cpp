@@ -0,0 +1,34 @@
+// AVX2 popcount over mask words (nibble lookup with vpshufb, byte sums with
+// vpsadbw; Mula, Kurz & Lemire, "Faster Population Counts Using AVX2
+// Instructions"). Built with -mavx2 (/arch:AVX2) and only called when
+// cpu_features() reports support; like the other ISA files it must not call
+// the header's inline helpers.
+#include <immintrin.h>
+
+#include "bit_mask.hpp"
+
+namespace fluid {
+
+size_t popcount_avx2(const uint64_t* words, size_t n) {
+  const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                       0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low = _mm256_set1_epi8(0x0f);
+  __m256i acc = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+    const __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, low));
+    const __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+    acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256()));
+  }
+  uint64_t lanes[4];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+  size_t total = static_cast<size_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+  for (; i < n; ++i) {
+    uint64_t x = words[i];
+    for (; x; x &= x - 1) ++total;
+  }
+  return total;
+}
+
+}  // namespace fluid
@@ -0,0 +1,132 @@
+#include "collide_kernel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+
+#include "cpu_features.hpp"
+
+namespace fluid {
+
+void collide_block_scalar(float* buf, int stride, int count, const uint8_t* flags,
+                          const BlockParams& bp, const BlockOutputs& out) {
+  for (int t = 0; t < count; ++t) {
+    float f[kQ];
+    for (int q = 0; q < kQ; ++q) f[q] = buf[q * stride + t];
+
+    const uint8_t fl = flags[t];
+    if (fl & kSolid) {
+      // Walls bounce back on the links into them (see lbm_engine.hpp), so
+      // nothing reads a solid cell's populations: leave them, report rest.
+      if (out.rho) out.rho[t] = 1.0f;
+      if (out.ux) out.ux[t] = 0.0f;
+      if (out.uy) out.uy[t] = 0.0f;
+      if (out.uz) out.uz[t] = 0.0f;
+      continue;
+    }
+    if (fl & kInlet) {
+      for (int q = 0; q < kQ; ++q) f[q] = bp.feq_inlet[q];
+    }
+    // Outlet: the torch solver pins rho before recomputing it from f, which
+    // leaves populations untouched, so there is nothing to do here.
+
+    float rho = 0.0f, mx = 0.0f, my = 0.0f, mz = 0.0f;
+    for (int q = 0; q < kQ; ++q) {
+      rho += f[q];
+      mx += kCx[q] * f[q];
+      my += kCy[q] * f[q];
+      mz += kCz[q] * f[q];
+    }
+    rho = std::max(rho, 1e-10f);
+    const float ux = mx / rho + bp.half_g[0];
+    const float uy = my / rho + bp.half_g[1];
+    const float uz = mz / rho + bp.half_g[2];
+    if (out.rho) out.rho[t] = rho;
+    if (out.ux) out.ux[t] = ux;
+    if (out.uy) out.uy[t] = uy;
+    if (out.uz) out.uz[t] = uz;
+
+    collide_cell(f, rho, ux, uy, uz, bp.p);
+    for (int q = 0; q < kQ; ++q) buf[q * stride + t] = f[q];
+  }
+}
+
+BlockParams make_block_params(const CollideParams& p, const float inlet_u[3]) {
+  BlockParams bp;
+  bp.p = p;
+  if (p.forcing) {
+    bp.half_g[0] = 0.5f * p.gx;
+    bp.half_g[1] = 0.5f * p.gy;
+    bp.half_g[2] = 0.5f * p.gz;
+  }
+  equilibrium(bp.feq_inlet, 1.0f, inlet_u[0], inlet_u[1], inlet_u[2]);
+  return bp;
+}
+
+namespace {
+
+CollideFn kernel_for(KernelIsa isa) {
+  switch (isa) {
+#ifdef FLUID_HAVE_X86_KERNELS
+    case KernelIsa::kAvx512:
+      return collide_block_avx512;
+    case KernelIsa::kAvx2:
+      return collide_block_avx2;
+#endif
+    default:
+      return collide_block_scalar;
+  }
+}
+
+std::atomic<KernelIsa>& selected_isa() {
+  static std::atomic<KernelIsa> isa{best_kernel_isa()};
+  return isa;
+}
+
+}  // namespace
+
+const char* kernel_isa_name(KernelIsa isa) {
+  switch (isa) {
+    case KernelIsa::kAvx2:
+      return "avx2";
+    case KernelIsa::kAvx512:
+      return "avx512";
+    default:
+      return "scalar";
+  }
+}
+
+bool kernel_isa_supported(KernelIsa isa) {
+  switch (isa) {
+    case KernelIsa::kScalar:
+      return true;
+#ifdef FLUID_HAVE_X86_KERNELS
+    case KernelIsa::kAvx2:
+      return cpu_features().avx2_fma;
+    case KernelIsa::kAvx512:
+      return cpu_features().avx512f;
+#endif
+    default:
+      return false;
+  }
+}
+
+KernelIsa best_kernel_isa() {
+  if (kernel_isa_supported(KernelIsa::kAvx512)) return KernelIsa::kAvx512;
+  if (kernel_isa_supported(KernelIsa::kAvx2)) return KernelIsa::kAvx2;
+  return KernelIsa::kScalar;
+}
+
+KernelIsa kernel_isa() { return selected_isa().load(std::memory_order_relaxed); }
+
+void set_kernel_isa(KernelIsa isa) {
+  if (!kernel_isa_supported(isa)) {
+    throw std::invalid_argument(std::string("kernel ISA not supported here: ") + kernel_isa_name(isa));
+  }
+  selected_isa().store(isa, std::memory_order_relaxed);
+}
+
+CollideFn collide_kernel() { return kernel_for(kernel_isa()); }
+
+}  // namespace fluid
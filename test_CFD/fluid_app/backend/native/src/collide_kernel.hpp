@@ -0,0 +1,112 @@
+// Per-cell LBM physics shared by every lattice layout.
+//
+// The engine gathers the streamed populations of a block of cells into a
+// small structure-of-arrays buffer (population q of cell t at
+// buf[q * stride + t]), runs collide_block() on it and scatters the result
+// back, so dense rows and sparse fluid-only blocks use the same kernel.
+//
+// collide_block() has a scalar version and AVX2 / AVX-512 versions that
+// process 8 / 16 cells per instruction; the fastest one the CPU supports is
+// picked at runtime (see set_kernel_isa()).
+#pragma once
+
+#include <cstdint>
+
+#include "d3q19.hpp"
+
+namespace fluid {
+
+// Per-cell flag bits.
+enum CellFlag : uint8_t {
+  kSolid = 1u << 0,
+  kInlet = 1u << 1,
+  kOutlet = 1u << 2,
+};
+
+struct CollideParams {
+  float omega = 1.0f;
+  float gx = 0.0f, gy = 0.0f, gz = 0.0f;
+  bool forcing = false;  // Guo forcing + half-force velocity shift enabled
+};
+
+// Everything collide_block() needs that is constant over one sweep.
+struct BlockParams {
+  CollideParams p;
+  float half_g[3] = {0.0f, 0.0f, 0.0f};  // velocity shift, zero without forcing
+  float feq_inlet[kQ] = {};              // equilibrium at the prescribed inlet velocity
+};
+
+// Sweep constants for collision parameters `p` and inlet velocity `inlet_u`.
+BlockParams make_block_params(const CollideParams& p, const float inlet_u[3]);
+
+// Optional per-cell macroscopic outputs (any pointer may be null).
+struct BlockOutputs {
+  float* rho = nullptr;
+  float* ux = nullptr;
+  float* uy = nullptr;
+  float* uz = nullptr;
+};
+
+// Equilibrium for a single cell.
+inline void equilibrium(float feq[kQ], float rho, float ux, float uy, float uz) {
+  const float usq = ux * ux + uy * uy + uz * uz;
+  for (int q = 0; q < kQ; ++q) {
+    const float cu = kCx[q] * ux + kCy[q] * uy + kCz[q] * uz;
+    feq[q] = kW[q] * rho * (1.0f + 3.0f * cu + 4.5f * cu * cu - 1.5f * usq);
+  }
+}
+
+// BGK relaxation plus Guo forcing, in place, for a single cell.
+inline void collide_cell(float f[kQ], float rho, float ux, float uy, float uz,
+                         const CollideParams& p) {
+  const float usq = ux * ux + uy * uy + uz * uz;
+  const float fscale = (1.0f - 0.5f * p.omega) * rho;
+  for (int q = 0; q < kQ; ++q) {
+    const float cu = kCx[q] * ux + kCy[q] * uy + kCz[q] * uz;
+    const float feq = kW[q] * rho * (1.0f + 3.0f * cu + 4.5f * cu * cu - 1.5f * usq);
+    float out = f[q] - p.omega * (f[q] - feq);
+    if (p.forcing) {
+      const float cmu_g = (kCx[q] - ux) * p.gx + (kCy[q] - uy) * p.gy + (kCz[q] - uz) * p.gz;
+      const float cg = kCx[q] * p.gx + kCy[q] * p.gy + kCz[q] * p.gz;
+      out += fscale * kW[q] * (3.0f * cmu_g + 9.0f * cu * cg);
+    }
+    f[q] = out;
+  }
+}
+
+// Apply the inlet rule, take moments and collide `count` cells of a gathered
+// buffer in place. Macroscopic values are written to `out`. Solid cells are
+// left as they are and report rho = 1, u = 0: walls act on the links into
+// them, which the engine bounces back while it gathers and scatters.
+using CollideFn = void (*)(float* buf, int stride, int count, const uint8_t* flags,
+                           const BlockParams& bp, const BlockOutputs& out);
+
+void collide_block_scalar(float* buf, int stride, int count, const uint8_t* flags,
+                          const BlockParams& bp, const BlockOutputs& out);
+#ifdef FLUID_HAVE_X86_KERNELS
+void collide_block_avx2(float* buf, int stride, int count, const uint8_t* flags,
+                        const BlockParams& bp, const BlockOutputs& out);
+void collide_block_avx512(float* buf, int stride, int count, const uint8_t* flags,
+                          const BlockParams& bp, const BlockOutputs& out);
+#endif
+
+enum class KernelIsa { kScalar, kAvx2, kAvx512 };
+
+const char* kernel_isa_name(KernelIsa isa);
+bool kernel_isa_supported(KernelIsa isa);
+// Best ISA this CPU (and build) supports.
+KernelIsa best_kernel_isa();
+
+// Currently selected kernel; defaults to best_kernel_isa(). Selecting an
+// unsupported ISA throws std::invalid_argument.
+KernelIsa kernel_isa();
+void set_kernel_isa(KernelIsa isa);
+CollideFn collide_kernel();
+
+// Dispatching convenience wrapper around collide_kernel().
+inline void collide_block(float* buf, int stride, int count, const uint8_t* flags,
+                          const BlockParams& bp, const BlockOutputs& out) {
+  collide_kernel()(buf, stride, count, flags, bp, out);
+}
+
+}  // namespace fluid
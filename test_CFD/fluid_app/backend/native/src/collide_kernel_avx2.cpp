@@ -0,0 +1,44 @@
+// AVX2 + FMA collide_block(): 8 cells per instruction. Built with -mavx2 -mfma
+// (/arch:AVX2) and only called when cpu_features() reports support.
+#include <immintrin.h>
+
+#include "collide_kernel_simd.hpp"
+
+namespace fluid {
+namespace {
+
+struct Avx2Ops {
+  using V = __m256;
+  using M = __m256;  // all-ones / all-zeros lanes
+  static constexpr int kWidth = 8;
+
+  static V load(const float* p) { return _mm256_loadu_ps(p); }
+  static void store(float* p, V v) { _mm256_storeu_ps(p, v); }
+  static V set1(float x) { return _mm256_set1_ps(x); }
+  static V add(V a, V b) { return _mm256_add_ps(a, b); }
+  static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+  static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+  static V div(V a, V b) { return _mm256_div_ps(a, b); }
+  static V max(V a, V b) { return _mm256_max_ps(a, b); }
+
+  // Lanes whose flag byte has `bit` set.
+  static M flag_mask(const uint8_t* flags, uint8_t bit) {
+    const __m256i w = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(flags)));
+    const __m256i b = _mm256_set1_epi32(bit);
+    return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(w, b), b));
+  }
+  // b & ~a
+  static M and_not(M a, M b) { return _mm256_andnot_ps(a, b); }
+  static bool any(M m) { return _mm256_movemask_ps(m) != 0; }
+  // m ? a : b
+  static V select(M m, V a, V b) { return _mm256_blendv_ps(b, a, m); }
+};
+
+}  // namespace
+
+void collide_block_avx2(float* buf, int stride, int count, const uint8_t* flags,
+                        const BlockParams& bp, const BlockOutputs& out) {
+  collide_block_simd<Avx2Ops>(buf, stride, count, flags, bp, out);
+}
+
+}  // namespace fluid
@@ -0,0 +1,138 @@
+// Vectorised collide_block(), written once against a tiny "Ops" wrapper
+// around the intrinsics of one instruction set and instantiated by
+// collide_kernel_avx2.cpp / collide_kernel_avx512.cpp (which are the only
+// files compiled with -mavx2 / -mavx512f).
+//
+// Lanes are consecutive cells of the gathered SoA buffer. The arithmetic is
+// the scalar kernel's, term for term and in the same order (products with
+// lattice velocity components of 0 / +-1 become skipped terms and add / sub),
+// so results match the scalar kernel to within FMA contraction.
+//
+// Everything here lives in an anonymous namespace and must not call inline
+// helpers or STL templates shared with other files: the linker could keep
+// this TU's AVX copy of such a function for callers running on older CPUs.
+#pragma once
+
+#include "collide_kernel.hpp"
+
+namespace fluid {
+namespace {
+
+template <class Ops>
+void collide_block_simd(float* buf, int stride, int count, const uint8_t* flags,
+                        const BlockParams& bp, const BlockOutputs& out) {
+  using V = typename Ops::V;
+  using M = typename Ops::M;
+  constexpr int kWidth = Ops::kWidth;
+
+  const CollideParams& p = bp.p;
+  const V zero = Ops::set1(0.0f);
+  const V one = Ops::set1(1.0f);
+  const V three = Ops::set1(3.0f);
+  const V four_half = Ops::set1(4.5f);
+  const V one_half = Ops::set1(1.5f);
+  const V nine = Ops::set1(9.0f);
+  const V rho_min = Ops::set1(1e-10f);
+  const V omega = Ops::set1(p.omega);
+  const V fscale_k = Ops::set1(1.0f - 0.5f * p.omega);
+  const V half_gx = Ops::set1(bp.half_g[0]);
+  const V half_gy = Ops::set1(bp.half_g[1]);
+  const V half_gz = Ops::set1(bp.half_g[2]);
+  const V gx = Ops::set1(p.gx);
+  const V gy = Ops::set1(p.gy);
+  const V gz = Ops::set1(p.gz);
+
+  // sum_k c_k * v_k over the non-zero components of a lattice velocity.
+  auto dot_c = [&](int q, V vx, V vy, V vz) {
+    V acc = zero;
+    if (kCx[q] > 0) acc = Ops::add(acc, vx);
+    if (kCx[q] < 0) acc = Ops::sub(acc, vx);
+    if (kCy[q] > 0) acc = Ops::add(acc, vy);
+    if (kCy[q] < 0) acc = Ops::sub(acc, vy);
+    if (kCz[q] > 0) acc = Ops::add(acc, vz);
+    if (kCz[q] < 0) acc = Ops::sub(acc, vz);
+    return acc;
+  };
+
+  int t = 0;
+  for (; t + kWidth <= count; t += kWidth) {
+    V f[kQ];
+    for (int q = 0; q < kQ; ++q) f[q] = Ops::load(buf + q * stride + t);
+
+    // Solid lanes are computed along and blended back to their input.
+    const M solid = Ops::flag_mask(flags + t, kSolid);
+    const bool any_solid = Ops::any(solid);
+    const M inlet = Ops::and_not(solid, Ops::flag_mask(flags + t, kInlet));
+    if (Ops::any(inlet)) {
+      for (int q = 0; q < kQ; ++q) f[q] = Ops::select(inlet, Ops::set1(bp.feq_inlet[q]), f[q]);
+    }
+
+    V rho = zero, mx = zero, my = zero, mz = zero;
+    for (int q = 0; q < kQ; ++q) {
+      rho = Ops::add(rho, f[q]);
+      if (kCx[q] > 0) mx = Ops::add(mx, f[q]);
+      if (kCx[q] < 0) mx = Ops::sub(mx, f[q]);
+      if (kCy[q] > 0) my = Ops::add(my, f[q]);
+      if (kCy[q] < 0) my = Ops::sub(my, f[q]);
+      if (kCz[q] > 0) mz = Ops::add(mz, f[q]);
+      if (kCz[q] < 0) mz = Ops::sub(mz, f[q]);
+    }
+    rho = Ops::max(rho, rho_min);
+    const V ux = Ops::add(Ops::div(mx, rho), half_gx);
+    const V uy = Ops::add(Ops::div(my, rho), half_gy);
+    const V uz = Ops::add(Ops::div(mz, rho), half_gz);
+    if (any_solid) {
+      if (out.rho) Ops::store(out.rho + t, Ops::select(solid, one, rho));
+      if (out.ux) Ops::store(out.ux + t, Ops::select(solid, zero, ux));
+      if (out.uy) Ops::store(out.uy + t, Ops::select(solid, zero, uy));
+      if (out.uz) Ops::store(out.uz + t, Ops::select(solid, zero, uz));
+    } else {
+      if (out.rho) Ops::store(out.rho + t, rho);
+      if (out.ux) Ops::store(out.ux + t, ux);
+      if (out.uy) Ops::store(out.uy + t, uy);
+      if (out.uz) Ops::store(out.uz + t, uz);
+    }
+
+    const V usq = Ops::add(Ops::add(Ops::mul(ux, ux), Ops::mul(uy, uy)), Ops::mul(uz, uz));
+    const V usq_term = Ops::mul(one_half, usq);
+    const V fscale = Ops::mul(fscale_k, rho);
+    // (c_k - u_k) * g_k for c_k = -1, 0, 1, so (c - u) . g is two adds per q.
+    V cmu[3][3];
+    if (p.forcing) {
+      const V u[3] = {ux, uy, uz};
+      const V g[3] = {gx, gy, gz};
+      for (int k = 0; k < 3; ++k) {
+        for (int c = -1; c <= 1; ++c) {
+          cmu[k][c + 1] = Ops::mul(Ops::sub(Ops::set1(static_cast<float>(c)), u[k]), g[k]);
+        }
+      }
+    }
+    for (int q = 0; q < kQ; ++q) {
+      const V cu = dot_c(q, ux, uy, uz);
+      const V poly = Ops::sub(
+          Ops::add(Ops::add(one, Ops::mul(three, cu)), Ops::mul(Ops::mul(four_half, cu), cu)),
+          usq_term);
+      const V feq = Ops::mul(Ops::mul(Ops::set1(kW[q]), rho), poly);
+      V res = Ops::sub(f[q], Ops::mul(omega, Ops::sub(f[q], feq)));
+      if (p.forcing) {
+        const V cmu_g = Ops::add(Ops::add(cmu[0][kCx[q] + 1], cmu[1][kCy[q] + 1]), cmu[2][kCz[q] + 1]);
+        const V cg = Ops::set1(kCx[q] * p.gx + kCy[q] * p.gy + kCz[q] * p.gz);
+        const V src = Ops::add(Ops::mul(three, cmu_g), Ops::mul(Ops::mul(nine, cu), cg));
+        res = Ops::add(res, Ops::mul(Ops::mul(fscale, Ops::set1(kW[q])), src));
+      }
+      Ops::store(buf + q * stride + t, any_solid ? Ops::select(solid, f[q], res) : res);
+    }
+  }
+
+  if (t < count) {
+    BlockOutputs tail;
+    tail.rho = out.rho ? out.rho + t : nullptr;
+    tail.ux = out.ux ? out.ux + t : nullptr;
+    tail.uy = out.uy ? out.uy + t : nullptr;
+    tail.uz = out.uz ? out.uz + t : nullptr;
+    collide_block_scalar(buf + t, stride, count - t, flags + t, bp, tail);
+  }
+}
+
+}  // namespace
+}  // namespace fluid
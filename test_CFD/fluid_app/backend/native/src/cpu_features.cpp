@@ -0,0 +1,82 @@
+#include "cpu_features.hpp"
+
+#include <cstdint>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#define FLUID_X86 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define FLUID_X86 1
+#endif
+
+namespace fluid {
+
+namespace {
+
+#ifdef FLUID_X86
+
+void cpuid(uint32_t leaf, uint32_t sub, uint32_t regs[4]) {
+#ifdef _MSC_VER
+  int r[4];
+  __cpuidex(r, static_cast<int>(leaf), static_cast<int>(sub));
+  for (int i = 0; i < 4; ++i) regs[i] = static_cast<uint32_t>(r[i]);
+#else
+  __cpuid_count(leaf, sub, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+uint64_t xgetbv0() {
+#ifdef _MSC_VER
+  return _xgetbv(0);
+#else
+  uint32_t eax, edx;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+CpuFeatures detect() {
+  CpuFeatures f;
+  uint32_t r[4];
+  cpuid(0, 0, r);
+  const uint32_t max_leaf = r[0];
+  if (max_leaf < 7) return f;
+
+  cpuid(1, 0, r);
+  const bool fma = r[2] & (1u << 12);
+  const bool f16c = r[2] & (1u << 29);
+  const bool osxsave = r[2] & (1u << 27);
+  const bool avx = r[2] & (1u << 28);
+  if (!osxsave || !avx) return f;
+
+  // The OS must save YMM (bits 1-2) and, for AVX-512, opmask/ZMM (bits 5-7).
+  const uint64_t xcr0 = xgetbv0();
+  const bool ymm_ok = (xcr0 & 0x6) == 0x6;
+  const bool zmm_ok = (xcr0 & 0xe6) == 0xe6;
+
+  cpuid(7, 0, r);
+  const bool avx2 = r[1] & (1u << 5);
+  const bool avx512f = r[1] & (1u << 16);
+
+  f.f16c = ymm_ok && f16c;
+  f.avx2_fma = ymm_ok && avx2 && fma;
+  f.avx512f = zmm_ok && avx512f && f.avx2_fma;
+  return f;
+}
+
+#else
+
+CpuFeatures detect() { return CpuFeatures{}; }
+
+#endif
+
+}  // namespace
+
+const CpuFeatures& cpu_features() {
+  static const CpuFeatures features = detect();
+  return features;
+}
+
+}  // namespace fluid
@@ -0,0 +1,15 @@
+// Runtime CPU feature detection for kernel dispatch.
+#pragma once
+
+namespace fluid {
+
+struct CpuFeatures {
+  bool avx2_fma = false;  // AVX2 + FMA with OS-enabled YMM state
+  bool avx512f = false;   // AVX-512F with OS-enabled ZMM/opmask state
+  bool f16c = false;      // F16C half <-> float conversions (with AVX)
+};
+
+// Detected once, on first use.
+const CpuFeatures& cpu_features();
+
+}  // namespace fluid
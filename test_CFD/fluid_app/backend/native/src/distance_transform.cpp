@@ -0,0 +1,172 @@
+#include "distance_transform.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+
+namespace fluid {
+
+namespace {
+
+// Lines transformed together along y and x: their cells are adjacent in
+// memory (consecutive z), so gathering a bundle reads whole cache lines.
+constexpr int kBundle = 16;
+
+// Lower envelope of the parabolas (q - v)^2 + f[v] over the samples below
+// `cap`, evaluated at every q and capped at `cap`. v/z are scratch (n and n + 1).
+void envelope_1d(const float* f, int n, float cap, float* d, int* v, double* z) {
+  int k = -1;
+  for (int q = 0; q < n; ++q) {
+    if (!(f[q] < cap)) continue;
+    const double fq = static_cast<double>(f[q]) + static_cast<double>(q) * q;
+    if (k < 0) {
+      k = 0;
+      v[0] = q;
+      z[0] = -std::numeric_limits<double>::infinity();
+      z[1] = std::numeric_limits<double>::infinity();
+      continue;
+    }
+    double s;
+    for (;;) {
+      const int p = v[k];
+      s = (fq - (static_cast<double>(f[p]) + static_cast<double>(p) * p)) / (2.0 * (q - p));
+      if (s > z[k]) break;
+      --k;  // z[0] = -inf, so this stops at k = 0
+    }
+    ++k;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = std::numeric_limits<double>::infinity();
+  }
+  if (k < 0) {
+    std::fill(d, d + n, cap);
+    return;
+  }
+  k = 0;
+  for (int q = 0; q < n; ++q) {
+    while (z[k + 1] < q) ++k;
+    const float dq = static_cast<float>(q - v[k]);
+    d[q] = std::min(dq * dq + f[v[k]], cap);
+  }
+}
+
+// One envelope pass over lines of n cells `stride` apart; line (o, w) starts
+// at o * outer_stride + w, w < nw. The two channels are split by the mask:
+// distance-to-solid reads 0 at solid cells, distance-to-fluid 0 at fluid ones.
+void envelope_pass(float* g, const BitMaskView& solid, int axis, float cap) {
+  const int nx = solid.nx, ny = solid.ny, nz = solid.nz;
+  const int n = axis == 0 ? nx : ny;
+  const int64_t stride = axis == 0 ? static_cast<int64_t>(ny) * nz : nz;
+  const int outer = axis == 0 ? ny : nx;
+  const int bundles = (nz + kBundle - 1) / kBundle;
+  const int tasks = outer * bundles;
+
+#pragma omp parallel
+  {
+    std::vector<float> line(static_cast<size_t>(kBundle) * n), in(n), out(n);
+    std::vector<uint8_t> is_solid(static_cast<size_t>(kBundle) * n);
+    std::vector<int> v(n);
+    std::vector<double> z(static_cast<size_t>(n) + 1);
+
+#pragma omp for schedule(dynamic, 4)
+    for (int task = 0; task < tasks; ++task) {
+      const int o = task / bundles;
+      const int k0 = (task % bundles) * kBundle;
+      const int nw = std::min(kBundle, nz - k0);
+      const int64_t base = axis == 0 ? static_cast<int64_t>(o) * nz + k0
+                                     : static_cast<int64_t>(o) * ny * nz + k0;
+
+      // Skippable if every line is one class (no zero samples from the other
+      // channel) and already at the cap everywhere.
+      bool all_capped = true;
+      const bool first_solid = test_bit(solid.row(axis == 0 ? 0 : o, axis == 0 ? o : 0), k0);
+      for (int t = 0; t < n; ++t) {
+        const float* src = g + base + t * stride;
+        const int i = axis == 0 ? t : o;
+        const int j = axis == 0 ? o : t;
+        const uint64_t* row = solid.row(i, j);
+        for (int w = 0; w < nw; ++w) {
+          line[static_cast<size_t>(w) * n + t] = src[w];
+          const bool sw = test_bit(row, k0 + w);
+          is_solid[static_cast<size_t>(w) * n + t] = sw;
+          all_capped = all_capped && !(src[w] < cap) && sw == first_solid;
+        }
+      }
+      if (all_capped) continue;  // nothing within the band on any of these lines
+
+      for (int w = 0; w < nw; ++w) {
+        float* l = &line[static_cast<size_t>(w) * n];
+        const uint8_t* s = &is_solid[static_cast<size_t>(w) * n];
+        for (int channel = 0; channel < 2; ++channel) {
+          // channel 0: distance to solid (kept at fluid cells), 1: to fluid (kept at solid cells)
+          const uint8_t owner = static_cast<uint8_t>(channel);
+          bool any_owned = false;
+          for (int t = 0; t < n; ++t) {
+            in[t] = s[t] == owner ? l[t] : 0.0f;
+            any_owned = any_owned || s[t] == owner;
+          }
+          if (!any_owned) continue;
+          envelope_1d(in.data(), n, cap, out.data(), v.data(), z.data());
+          for (int t = 0; t < n; ++t) {
+            if (s[t] == owner) l[t] = out[t];
+          }
+        }
+      }
+
+      for (int t = 0; t < n; ++t) {
+        float* dst = g + base + t * stride;
+        for (int w = 0; w < nw; ++w) dst[w] = line[static_cast<size_t>(w) * n + t];
+      }
+    }
+  }
+}
+
+}  // namespace
+
+void signed_distance(const BitMaskView& solid, int band, float scale, float* out) {
+  const int nx = solid.nx, ny = solid.ny, nz = solid.nz;
+  // Without a band the cap only has to exceed any squared distance in the grid.
+  const float cap = band > 0 ? static_cast<float>(band) * band
+                             : static_cast<float>(nx) * nx + static_cast<float>(ny) * ny +
+                                   static_cast<float>(nz) * nz;
+
+  // z: squared distance to the nearest cell of the other class in the same column.
+#pragma omp parallel for schedule(static)
+  for (int r = 0; r < nx * ny; ++r) {
+    const uint64_t* row = solid.row(r / ny, r % ny);
+    float* g = out + static_cast<int64_t>(r) * nz;
+    int last = -1;  // last cell of the other class than the current run
+    for (int k = 0; k < nz; ++k) {
+      if (k > 0 && test_bit(row, k) != test_bit(row, k - 1)) last = k - 1;
+      const float d = static_cast<float>(k - last);
+      g[k] = last < 0 ? cap : std::min(d * d, cap);
+    }
+    last = -1;
+    for (int k = nz - 1; k >= 0; --k) {
+      if (k < nz - 1 && test_bit(row, k) != test_bit(row, k + 1)) last = k + 1;
+      if (last >= 0) {
+        const float d = static_cast<float>(last - k);
+        g[k] = std::min(g[k], d * d);
+      }
+    }
+  }
+
+  envelope_pass(out, solid, 1, cap);
+  envelope_pass(out, solid, 0, cap);
+
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nx; ++i) {
+    for (int j = 0; j < ny; ++j) {
+      const uint64_t* row = solid.row(i, j);
+      float* g = out + (static_cast<int64_t>(i) * ny + j) * nz;
+      for (int k = 0; k < nz; ++k) {
+        const float d = static_cast<float>(std::sqrt(static_cast<double>(g[k]))) * scale;
+        g[k] = test_bit(row, k) ? -d : d;
+      }
+    }
+  }
+}
+
+}  // namespace fluid
@@ -0,0 +1,24 @@
+// Signed Euclidean distance transform of a voxel mask.
+//
+// Separable exact EDT (Felzenszwalb & Huttenlocher, "Distance Transforms of
+// Sampled Functions"): 1D distances along z straight from the mask bits, then
+// the lower envelope of parabolas along y and along x. The distance to solid
+// (for fluid cells) and to fluid (for solid cells) share one array, since each
+// is zero on the other class, so the signed field costs one transform.
+//
+// With a band the squared distance is capped at band^2 from the start: the
+// result is then exactly min(distance, band), and samples at the cap are
+// dropped from the envelopes, so lines far from the surface cost next to
+// nothing.
+#pragma once
+
+#include "bit_mask.hpp"
+
+namespace fluid {
+
+// Writes (nx, ny, nz) floats for the solid mask: +distance to the nearest
+// solid cell for fluid cells, -distance to the nearest fluid cell for solid
+// cells, in cells times `scale`. band <= 0 means no band.
+void signed_distance(const BitMaskView& solid, int band, float scale, float* out);
+
+}  // namespace fluid
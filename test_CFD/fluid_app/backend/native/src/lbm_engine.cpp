@@ -0,0 +1,866 @@
+#include "lbm_engine.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace fluid {
+
+namespace {
+
+// Cells per gathered block in the sparse layout (dense blocks are z-rows).
+constexpr int kSparseBlock = 128;
+
+inline int wrap(int v, int n) { return v < 0 ? v + n : (v >= n ? v - n : v); }
+
+// dst[k] = decode(src[(k - shift) mod n]) for k in [k0, k1), shift in {-1, 0, 1}.
+template <class C>
+inline void decode_shifted(float* dst, const typename C::Stored* src, int n, int shift, float w,
+                           int k0, int k1) {
+  if (shift > 0 && k0 == 0) dst[k0++] = C::decode(src[n - 1], w);
+  if (shift < 0 && k1 == n) dst[--k1] = C::decode(src[0], w);
+  if (k1 > k0) C::decode_n(dst + k0, src + k0 - shift, k1 - k0, w);
+}
+
+// dst[(k + shift) mod n] = encode(src[k]) for k in [k0, k1), shift in {-1, 0, 1}.
+template <class C>
+inline void encode_shifted(typename C::Stored* dst, const float* src, int n, int shift, float w,
+                           int k0, int k1) {
+  if (shift > 0 && k1 == n) dst[0] = C::encode(src[--k1], w);
+  if (shift < 0 && k0 == 0) dst[n - 1] = C::encode(src[k0++], w);
+  if (k1 > k0) C::encode_n(dst + k0 + shift, src + k0, k1 - k0, w);
+}
+
+// One upwind fill update from the face neighbours below (lo) and above (hi)
+// along x, y, z, clamped to [0, 1].
+inline float upwind_fill(float here, float ux, float uy, float uz, const float* lo, const float* hi) {
+  const float u[3] = {ux, uy, uz};
+  float v = here;
+  for (int d = 0; d < 3; ++d) {
+    const float flux_in = u[d] > 0.0f ? lo[d] * u[d] : hi[d] * (-u[d]);
+    v += 0.08f * (flux_in - here * std::fabs(u[d]));
+  }
+  return std::min(std::max(v, 0.0f), 1.0f);
+}
+
+// Spread the low 21 bits of v so there are two zero bits between each.
+inline uint64_t spread3(uint64_t v) {
+  v &= 0x1fffff;
+  v = (v | (v << 32)) & 0x1f00000000ffffULL;
+  v = (v | (v << 16)) & 0x1f0000ff0000ffULL;
+  v = (v | (v << 8)) & 0x100f00f00f00f00fULL;
+  v = (v | (v << 4)) & 0x10c30c30c30c30c3ULL;
+  v = (v | (v << 2)) & 0x1249249249249249ULL;
+  return v;
+}
+
+inline int compact3(uint64_t v) {
+  v &= 0x1249249249249249ULL;
+  v = (v ^ (v >> 2)) & 0x10c30c30c30c30c3ULL;
+  v = (v ^ (v >> 4)) & 0x100f00f00f00f00fULL;
+  v = (v ^ (v >> 8)) & 0x1f0000ff0000ffULL;
+  v = (v ^ (v >> 16)) & 0x1f00000000ffffULL;
+  v = (v ^ (v >> 32)) & 0x1fffff;
+  return static_cast<int>(v);
+}
+
+inline uint64_t morton3(int i, int j, int k) {
+  return spread3(i) << 2 | spread3(j) << 1 | spread3(k);
+}
+
+}  // namespace
+
+LbmEngine::LbmEngine(int nx, int ny, int nz, float nu_lbm,
+                     const BitMaskView& solid, const BitMaskView& inlet, const BitMaskView& outlet,
+                     const std::array<float, 3>& gravity_lbm, bool sparse,
+                     Precision precision, const std::vector<int>& cpus, HugePages huge_pages)
+    : nx_(nx), ny_(ny), nz_(nz), sparse_(sparse), precision_(precision), nu_(nu_lbm),
+      residual_(std::numeric_limits<double>::quiet_NaN()), cpus_(cpus),
+      flags_(PageAllocator<uint8_t>(huge_pages)), f_(PageAllocator<float>(huge_pages)),
+      f16_(PageAllocator<uint16_t>(huge_pages)), rho_(PageAllocator<float>(huge_pages)),
+      ux_(PageAllocator<float>(huge_pages)), uy_(PageAllocator<float>(huge_pages)),
+      uz_(PageAllocator<float>(huge_pages)), fill_(PageAllocator<float>(huge_pages)),
+      fill_next_(PageAllocator<float>(huge_pages)), cell_(PageAllocator<uint32_t>(huge_pages)),
+      nbr_(PageAllocator<int32_t>(huge_pages)) {
+  if (nx < 1 || ny < 1 || nz < 1) {
+    throw std::invalid_argument("grid dimensions must be positive");
+  }
+  for (const BitMaskView* mask : {&solid, &inlet, &outlet}) {
+    if (mask->words && (mask->nx != nx || mask->ny != ny || mask->nz != nz)) {
+      throw std::invalid_argument("mask does not match grid size");
+    }
+  }
+  n_ = static_cast<size_t>(nx) * ny * nz;
+  tau_ = 3.0f * nu_ + 0.5f;
+  params_.omega = 1.0f / tau_;
+  set_gravity(gravity_lbm);
+  const ThreadPinning pin(cpus_);
+
+  if (sparse_) {
+    build_sparse(solid);
+  } else {
+    m_ = n_;
+  }
+
+  // First touch of every per-cell array (see numa.hpp); populations are
+  // first written by init_populations(), which is split the same way.
+  flags_.resize(m_);
+  parallel_fill(flags_.data(), m_, uint8_t(0));
+  if (sparse_) {
+    // Only fluid cells are stored, so only inlet/outlet can be set.
+    const long long m = static_cast<long long>(m_);
+#pragma omp parallel for schedule(static)
+    for (long long s = 0; s < m; ++s) {
+      const size_t c = cell_[s];
+      const int i = static_cast<int>(c / (static_cast<size_t>(ny_) * nz_));
+      const int j = static_cast<int>((c / nz_) % ny_);
+      const int k = static_cast<int>(c % nz_);
+      flags_[s] = static_cast<uint8_t>((inlet.test(i, j, k) ? kInlet : 0) |
+                                       (outlet.test(i, j, k) ? kOutlet : 0));
+    }
+  } else {
+    // Solid goes first and takes no other mark, as the sparse layout does
+    // not store it at all.
+    const std::pair<const BitMaskView*, uint8_t> marks[] = {
+        {&solid, kSolid}, {&inlet, kInlet}, {&outlet, kOutlet}};
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < nx_; ++i) {
+      for (const auto& mark : marks) {
+        if (!mark.first->words) continue;
+        for (int j = 0; j < ny_; ++j) {
+          uint8_t* row = flags_.data() + idx(i, j, 0);
+          for_each_bit(mark.first->row(i, j), nz_, [&](int k) {
+            if (!(row[k] & kSolid)) row[k] |= mark.second;
+          });
+        }
+      }
+    }
+    build_walls();
+  }
+
+  for (PageVector<float>* v : {&rho_, &ux_, &uy_, &uz_, &fill_, &fill_next_}) {
+    v->resize(m_);
+    parallel_fill(v->data(), m_, v == &rho_ ? 1.0f : 0.0f);
+  }
+  for (size_t s = 0; s < m_; ++s) {
+    if (flags_[s] & kInlet) fill_[s] = 1.0f;
+  }
+
+  const size_t pops = static_cast<size_t>(kQ) * m_;
+  if (precision_ == Precision::kFloat32) {
+    f_.resize(pops);
+  } else {
+    f16_.resize(pops);
+  }
+  init_populations(nullptr, nullptr, nullptr, nullptr);
+}
+
+void LbmEngine::init_from_fields(const float* rho, const float* ux, const float* uy,
+                                 const float* uz, const float* fill) {
+  const long long m = static_cast<long long>(m_);
+#pragma omp parallel for schedule(static)
+  for (long long s = 0; s < m; ++s) {
+    const size_t c = sparse_ ? cell_[s] : static_cast<size_t>(s);
+    // Solid cells read as the sparse layout's background.
+    const bool wall = (flags_[s] & kSolid) != 0;
+    rho_[s] = wall ? 1.0f : rho[c];
+    ux_[s] = wall ? 0.0f : ux[c];
+    uy_[s] = wall ? 0.0f : uy[c];
+    uz_[s] = wall ? 0.0f : uz[c];
+    fill_[s] = (flags_[s] & kInlet) ? 1.0f : (wall ? 0.0f : fill[c]);
+  }
+  init_populations(rho, ux, uy, uz);
+  residual_ = std::numeric_limits<double>::quiet_NaN();
+}
+
+void LbmEngine::init_populations(const float* rho, const float* ux, const float* uy,
+                                 const float* uz) {
+  switch (precision_) {
+    case Precision::kFloat16:
+      init_populations<Float16Codec>(rho, ux, uy, uz);
+      break;
+    case Precision::kBFloat16:
+      init_populations<BFloat16Codec>(rho, ux, uy, uz);
+      break;
+    default:
+      init_populations<Float32Codec>(rho, ux, uy, uz);
+  }
+  odd_next_ = true;
+}
+
+// The torch solver starts from equilibrium and collides first; the fused sweep
+// stores post-collision populations, so apply that collision here and store
+// the result the way an even AA step would (f*_q in slot opp(q)).
+template <class C>
+void LbmEngine::init_populations(const float* rho, const float* ux, const float* uy,
+                                 const float* uz) {
+  typename C::Stored* a = populations<C>();
+  const long long m = static_cast<long long>(m_);
+#pragma omp parallel for schedule(static)
+  for (long long s = 0; s < m; ++s) {
+    const size_t c = sparse_ ? cell_[s] : static_cast<size_t>(s);
+    const float r = rho ? rho[c] : 1.0f;
+    const float x = ux ? ux[c] : 0.0f;
+    const float y = uy ? uy[c] : 0.0f;
+    const float z = uz ? uz[c] : 0.0f;
+    float cell[kQ];
+    equilibrium(cell, r, x, y, z);
+    collide_cell(cell, r, x, y, z, params_);
+    for (int q = 0; q < kQ; ++q) a[kOpp[q] * m_ + s] = C::encode(cell[q], kW[q]);
+  }
+}
+
+// Store non-solid cells only, sorted along a Morton curve so that blocks of
+// consecutive storage indices are compact in space, and record for every
+// stored cell the storage index of each of its 18 neighbours (wrapping around
+// the box like the dense layout).
+void LbmEngine::build_sparse(const BitMaskView& solid) {
+  std::vector<uint64_t> keys;
+  keys.reserve(n_ - solid.count());
+  for (int i = 0; i < nx_; ++i) {
+    for (int j = 0; j < ny_; ++j) {
+      if (!solid.words) {
+        for (int k = 0; k < nz_; ++k) keys.push_back(morton3(i, j, k));
+        continue;
+      }
+      for_each_bit<false>(solid.row(i, j), nz_, [&](int k) { keys.push_back(morton3(i, j, k)); });
+    }
+  }
+  std::sort(keys.begin(), keys.end());
+  m_ = keys.size();
+  if (m_ > static_cast<size_t>(INT32_MAX)) {
+    throw std::length_error("too many fluid cells for the sparse layout");
+  }
+
+  // Both tables are first written by schedule(static) loops over storage
+  // indices (see numa.hpp).
+  cell_.resize(m_);
+  std::vector<int32_t> storage_of(n_, -1);
+  const long long m = static_cast<long long>(m_);
+#pragma omp parallel for schedule(static)
+  for (long long s = 0; s < m; ++s) {
+    const uint64_t key = keys[s];
+    const size_t c = idx(compact3(key >> 2), compact3(key >> 1), compact3(key));
+    cell_[s] = static_cast<uint32_t>(c);
+    storage_of[c] = static_cast<int32_t>(s);
+  }
+
+  nbr_.resize(static_cast<size_t>(kQ - 1) * m_);
+#pragma omp parallel for schedule(static)
+  for (long long s = 0; s < m; ++s) {
+    const size_t c = cell_[s];
+    const int i = static_cast<int>(c / (static_cast<size_t>(ny_) * nz_));
+    const int j = static_cast<int>((c / nz_) % ny_);
+    const int k = static_cast<int>(c % nz_);
+    for (int q = 1; q < kQ; ++q) {
+      nbr_[(q - 1) * m_ + s] =
+          storage_of[idx(wrap(i + kCx[q], nx_), wrap(j + kCy[q], ny_), wrap(k + kCz[q], nz_))];
+    }
+  }
+}
+
+// Runs of non-solid cells and wall cells of every dense row, for the odd
+// steps' bounce-back (see gather_dense_row()). Links wrap around the box like
+// the streaming. Both tables are first written by schedule(static) loops
+// over rows, the split the dense sweeps use.
+void LbmEngine::build_walls() {
+  const long long rows = static_cast<long long>(nx_) * ny_;
+  // Calls on_run(k0, k1) for each run and on_wall(k, dirs) for each wall cell of `row`.
+  auto scan = [&](long long row, auto&& on_run, auto&& on_wall) {
+    const int i = static_cast<int>(row / ny_);
+    const int j = static_cast<int>(row % ny_);
+    const uint8_t* flags = flags_.data() + row * nz_;
+    const uint8_t* nb[kQ];
+    for (int q = 1; q < kQ; ++q) nb[q] = flags_.data() + idx(wrap(i + kCx[q], nx_), wrap(j + kCy[q], ny_), 0);
+    int k0 = -1;
+    for (int k = 0; k <= nz_; ++k) {
+      const bool open = k < nz_ && !(flags[k] & kSolid);
+      if (open && k0 < 0) k0 = k;
+      if (!open) {
+        if (k0 >= 0) on_run(k0, k);
+        k0 = -1;
+        continue;
+      }
+      uint32_t dirs = 0;
+      for (int q = 1; q < kQ; ++q) {
+        if (nb[q][wrap(k + kCz[q], nz_)] & kSolid) dirs |= 1u << q;
+      }
+      if (dirs) on_wall(k, dirs);
+    }
+  };
+
+  run_start_.resize(rows + 1);
+  wall_start_.resize(rows + 1);
+  run_start_[0] = wall_start_[0] = 0;
+#pragma omp parallel for schedule(static)
+  for (long long row = 0; row < rows; ++row) {
+    size_t runs = 0, walls = 0;
+    scan(row, [&](int, int) { ++runs; }, [&](int, uint32_t) { ++walls; });
+    run_start_[row + 1] = runs;
+    wall_start_[row + 1] = walls;
+  }
+  for (long long row = 0; row < rows; ++row) {
+    run_start_[row + 1] += run_start_[row];
+    wall_start_[row + 1] += wall_start_[row];
+  }
+  runs_.resize(run_start_[rows]);
+  walls_.resize(wall_start_[rows]);
+#pragma omp parallel for schedule(static)
+  for (long long row = 0; row < rows; ++row) {
+    size_t r = run_start_[row], w = wall_start_[row];
+    scan(row, [&](int k0, int k1) { runs_[r++] = {k0, k1}; },
+         [&](int k, uint32_t dirs) { walls_[w++] = {k, dirs}; });
+  }
+}
+
+void LbmEngine::set_inlet_direction(const std::array<float, 3>& dir) {
+  const float n = std::sqrt(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+  if (n < 1e-12f) {
+    inlet_dir_ = {0.0f, 0.0f, -1.0f};
+  } else {
+    inlet_dir_ = {dir[0] / n, dir[1] / n, dir[2] / n};
+  }
+}
+
+void LbmEngine::set_gravity(const std::array<float, 3>& g) {
+  params_.gx = g[0];
+  params_.gy = g[1];
+  params_.gz = g[2];
+  params_.forcing = std::sqrt(g[0] * g[0] + g[1] * g[1] + g[2] * g[2]) > 1e-12f;
+}
+
+size_t LbmEngine::memory_bytes() const {
+  return f16_.size() * sizeof(uint16_t) +
+         (f_.size() + rho_.size() + ux_.size() + uy_.size() + uz_.size() +
+          fill_.size() + fill_next_.size()) * sizeof(float) +
+         flags_.size() + cell_.size() * sizeof(uint32_t) + nbr_.size() * sizeof(int32_t) +
+         (run_start_.size() + wall_start_.size()) * sizeof(size_t) +
+         runs_.size() * sizeof(RowRun) + walls_.size() * sizeof(WallCell);
+}
+
+void* LbmEngine::population_data() {
+  if (precision_ == Precision::kFloat32) return f_.data();
+  return f16_.data();
+}
+
+void LbmEngine::restore_progress(long long steps_done, bool odd_next) {
+  steps_done_ = steps_done;
+  odd_next_ = odd_next;
+  residual_ = std::numeric_limits<double>::quiet_NaN();
+}
+
+void LbmEngine::to_grid(const PageVector<float>& v, float background, float* out) const {
+  if (!sparse_) {
+    std::memcpy(out, v.data(), n_ * sizeof(float));
+    return;
+  }
+  std::fill(out, out + n_, background);
+  const long long m = static_cast<long long>(m_);
+#pragma omp parallel for schedule(static)
+  for (long long s = 0; s < m; ++s) out[cell_[s]] = v[s];
+}
+
+void LbmEngine::set_temporal_blocking(int steps, int tile_y) {
+  if (steps > 1 && sparse_) {
+    throw std::invalid_argument("temporal blocking needs the dense layout");
+  }
+  if (steps > 1 && tile_y < 2 * steps) {
+    throw std::invalid_argument("tile_y must be at least 2 * steps");
+  }
+  block_steps_ = std::max(steps, 1);
+  block_tile_y_ = block_steps_ > 1 ? tile_y : 0;
+}
+
+void LbmEngine::run(int steps, float inlet_speed, bool update_fill, bool measure_residual) {
+  if (ghost_planes_) {
+    throw std::logic_error("an engine with ghost planes is stepped by SlabLbm");
+  }
+  const ThreadPinning pin(cpus_);
+  int s = 0;
+  const int t = block_steps_;
+  if (t > 1 && nx_ >= 4 * t && ny_ >= 2 * t) {
+    // The measured step is left to the plain sweep, which reduces the residual.
+    const int blocked = steps - (measure_residual ? 1 : 0);
+    for (; s + t <= blocked; s += t) {
+      switch (precision_) {
+        case Precision::kFloat16:
+          run_blocked<Float16Codec>(t, inlet_speed, update_fill);
+          break;
+        case Precision::kBFloat16:
+          run_blocked<BFloat16Codec>(t, inlet_speed, update_fill);
+          break;
+        default:
+          run_blocked<Float32Codec>(t, inlet_speed, update_fill);
+      }
+    }
+  }
+  const long long blocks = sweep_blocks();
+  for (; s < steps; ++s) {
+    const bool measure = measure_residual && s == steps - 1;
+    switch (precision_) {
+      case Precision::kFloat16:
+        step<Float16Codec>(inlet_speed, update_fill, measure, 0, blocks);
+        break;
+      case Precision::kBFloat16:
+        step<BFloat16Codec>(inlet_speed, update_fill, measure, 0, blocks);
+        break;
+      default:
+        step<Float32Codec>(inlet_speed, update_fill, measure, 0, blocks);
+    }
+    finish_step(update_fill, measure);
+  }
+}
+
+void LbmEngine::finish_step(bool update_fill, bool measured) {
+  if (measured) {
+    measured_sums_ = residual_sums_;
+    residual_ = measured_sums_[1] > 0.0 ? std::sqrt(measured_sums_[0] / measured_sums_[1])
+                                        : std::numeric_limits<double>::infinity();
+  }
+  residual_sums_ = {0.0, 0.0};
+  odd_next_ = !odd_next_;
+  if (update_fill) fill_.swap(fill_next_);
+  ++steps_done_;
+}
+
+void LbmEngine::set_ghost_planes(bool on) {
+  if (on && sparse_) {
+    throw std::invalid_argument("ghost planes need the dense layout");
+  }
+  if (on && nx_ < 3) {
+    throw std::invalid_argument("ghost planes need at least one owned plane");
+  }
+  ghost_planes_ = on;
+}
+
+void LbmEngine::sweep_planes(int i0, int i1, float inlet_speed, bool update_fill,
+                             bool measure_residual) {
+  if (sparse_) {
+    throw std::invalid_argument("plane sweeps need the dense layout");
+  }
+  if (i0 < 0 || i1 > nx_ || i0 > i1) {
+    throw std::invalid_argument("plane range out of bounds");
+  }
+  const ThreadPinning pin(cpus_);
+  const long long b0 = static_cast<long long>(i0) * ny_;
+  const long long b1 = static_cast<long long>(i1) * ny_;
+  switch (precision_) {
+    case Precision::kFloat16:
+      step<Float16Codec>(inlet_speed, update_fill, measure_residual, b0, b1);
+      break;
+    case Precision::kBFloat16:
+      step<BFloat16Codec>(inlet_speed, update_fill, measure_residual, b0, b1);
+      break;
+    default:
+      step<Float32Codec>(inlet_speed, update_fill, measure_residual, b0, b1);
+  }
+}
+
+size_t LbmEngine::halo_bytes() const {
+  const size_t elem = precision_ == Precision::kFloat32 ? sizeof(float) : sizeof(uint16_t);
+  return kHaloSlots * static_cast<size_t>(ny_) * nz_ * elem;
+}
+
+void LbmEngine::pack_halo(int i, int sign, void* out) const {
+  if (sparse_ || i < 0 || i >= nx_) {
+    throw std::invalid_argument("halo plane out of bounds");
+  }
+  const size_t elem = precision_ == Precision::kFloat32 ? sizeof(float) : sizeof(uint16_t);
+  const size_t bytes = static_cast<size_t>(ny_) * nz_ * elem;
+  const char* a = precision_ == Precision::kFloat32 ? reinterpret_cast<const char*>(f_.data())
+                                                    : reinterpret_cast<const char*>(f16_.data());
+  char* dst = static_cast<char*>(out);
+  for (int q = 0; q < kQ; ++q) {
+    if (kCx[q] != sign) continue;
+    std::memcpy(dst, a + (q * n_ + idx(i, 0, 0)) * elem, bytes);
+    dst += bytes;
+  }
+}
+
+void LbmEngine::unpack_halo(int i, int sign, const void* in) {
+  if (sparse_ || i < 0 || i >= nx_) {
+    throw std::invalid_argument("halo plane out of bounds");
+  }
+  const size_t elem = precision_ == Precision::kFloat32 ? sizeof(float) : sizeof(uint16_t);
+  const size_t bytes = static_cast<size_t>(ny_) * nz_ * elem;
+  char* a = static_cast<char*>(population_data());
+  const char* src = static_cast<const char*>(in);
+  for (int q = 0; q < kQ; ++q) {
+    if (kCx[q] != sign) continue;
+    std::memcpy(a + (q * n_ + idx(i, 0, 0)) * elem, src, bytes);
+    src += bytes;
+  }
+}
+
+void LbmEngine::unpack_returns(int i, int sign, const void* in) {
+  const int up = i - sign;
+  if (sparse_ || up < 0 || up >= nx_ || i < 0 || i >= nx_) {
+    throw std::invalid_argument("halo plane out of bounds");
+  }
+  const size_t elem = precision_ == Precision::kFloat32 ? sizeof(float) : sizeof(uint16_t);
+  char* a = static_cast<char*>(population_data());
+  const char* src = static_cast<const char*>(in);
+  for (int q = 0; q < kQ; ++q) {
+    if (kCx[q] != sign) continue;
+    for (int j = 0; j < ny_; ++j) {
+      const uint8_t* upstream = flags_.data() + idx(up, wrap(j - kCy[q], ny_), 0);
+      for (int k = 0; k < nz_; ++k) {
+        const size_t t = static_cast<size_t>(j) * nz_ + k;
+        if (!(upstream[wrap(k - kCz[q], nz_)] & kSolid)) {
+          std::memcpy(a + (q * n_ + idx(i, j, k)) * elem, src + t * elem, elem);
+        }
+      }
+    }
+    src += static_cast<size_t>(ny_) * nz_ * elem;
+  }
+}
+
+template <class C>
+typename C::Stored* LbmEngine::populations() {
+  if constexpr (std::is_same_v<typename C::Stored, float>) {
+    return f_.data();
+  } else {
+    return f16_.data();
+  }
+}
+
+template <class C>
+void LbmEngine::step(float inlet_speed, bool update_fill, bool measure_residual, long long b0,
+                     long long b1) {
+  if (odd_next_) {
+    sweep<C, true>(inlet_speed, update_fill, measure_residual, b0, b1);
+  } else {
+    sweep<C, false>(inlet_speed, update_fill, measure_residual, b0, b1);
+  }
+}
+
+long long LbmEngine::sweep_blocks() const {
+  return sparse_ ? static_cast<long long>((m_ + kSparseBlock - 1) / kSparseBlock)
+                 : static_cast<long long>(nx_) * ny_;
+}
+
+// Load the streamed populations of one z-row (periodic, like torch.roll).
+// Reduced-precision slots are (de)coded with the population's weight w_q,
+// which is also the weight of the opposite slot it may be stored in.
+//
+// Odd steps stream, and solid cells take no part in it: only the row's runs
+// of non-solid cells are loaded and stored. A link into a wall bounces back
+// half-way, as in the sparse layout: a cell whose upstream neighbour is solid
+// gets back its own opposite population from the previous step, and what it
+// sends towards a solid neighbour goes to its own opposite slot. Those are
+// the slots the solid cell would have used, so every odd step still reads
+// and writes exactly the locations it would without walls.
+template <class C, bool kOddStep>
+void LbmEngine::gather_dense_row(const typename C::Stored* a, long long row, float* buf) const {
+  const int i = static_cast<int>(row / ny_);
+  const int j = static_cast<int>(row % ny_);
+  if (!kOddStep) {
+    for (int q = 0; q < kQ; ++q) C::decode_n(buf + q * nz_, a + q * n_ + row * nz_, nz_, kW[q]);
+    return;
+  }
+  const RowRun* runs = runs_.data() + run_start_[row];
+  const RowRun* runs_end = runs_.data() + run_start_[row + 1];
+  for (int q = 0; q < kQ; ++q) {
+    float* dst = buf + q * nz_;
+    const size_t src = kOpp[q] * n_ + idx(wrap(i - kCx[q], nx_), wrap(j - kCy[q], ny_), 0);
+    for (const RowRun* r = runs; r != runs_end; ++r) {
+      decode_shifted<C>(dst, a + src, nz_, kCz[q], kW[q], r->k0, r->k1);
+    }
+  }
+  const size_t s0 = static_cast<size_t>(row) * nz_;
+  for (size_t w = wall_start_[row]; w < wall_start_[row + 1]; ++w) {
+    const WallCell cell = walls_[w];
+    for (int q = 1; q < kQ; ++q) {
+      if (cell.dirs & (1u << kOpp[q])) {
+        buf[q * nz_ + cell.k] = C::decode(a[q * n_ + s0 + cell.k], kW[q]);
+      }
+    }
+  }
+}
+
+template <class C, bool kOddStep>
+void LbmEngine::scatter_dense_row(typename C::Stored* a, long long row, const float* buf) {
+  const int i = static_cast<int>(row / ny_);
+  const int j = static_cast<int>(row % ny_);
+  if (!kOddStep) {
+    for (int q = 0; q < kQ; ++q) C::encode_n(a + kOpp[q] * n_ + row * nz_, buf + q * nz_, nz_, kW[q]);
+    return;
+  }
+  const RowRun* runs = runs_.data() + run_start_[row];
+  const RowRun* runs_end = runs_.data() + run_start_[row + 1];
+  for (int q = 0; q < kQ; ++q) {
+    const float* src = buf + q * nz_;
+    const size_t dst = q * n_ + idx(wrap(i + kCx[q], nx_), wrap(j + kCy[q], ny_), 0);
+    for (const RowRun* r = runs; r != runs_end; ++r) {
+      encode_shifted<C>(a + dst, src, nz_, kCz[q], kW[q], r->k0, r->k1);
+    }
+  }
+  const size_t s0 = static_cast<size_t>(row) * nz_;
+  for (size_t w = wall_start_[row]; w < wall_start_[row + 1]; ++w) {
+    const WallCell cell = walls_[w];
+    for (int q = 1; q < kQ; ++q) {
+      if (cell.dirs & (1u << q)) {
+        a[kOpp[q] * n_ + s0 + cell.k] = C::encode(buf[q * nz_ + cell.k], kW[q]);
+      }
+    }
+  }
+}
+
+// Sparse odd steps pull through the neighbour table. A missing upstream
+// neighbour means the link hits a wall, so the cell gets back its own
+// opposite population from the previous step (half-way bounce-back). The
+// store side mirrors it, keeping the AA "same locations in and out" rule.
+template <class C, bool kOddStep>
+void LbmEngine::gather_sparse(const typename C::Stored* a, size_t s0, int count, float* buf) const {
+  C::decode_n(buf, a + s0, count, kW[0]);
+  for (int q = 1; q < kQ; ++q) {
+    float* dst = buf + q * kSparseBlock;
+    if (kOddStep) {
+      const int p = kOpp[q];
+      const float w = kW[q];
+      for (int t = 0; t < count; ++t) {
+        const size_t s = s0 + t;
+        const int32_t up = nbr(p, s);
+        dst[t] = C::decode(up >= 0 ? a[p * m_ + up] : a[q * m_ + s], w);
+      }
+    } else {
+      C::decode_n(dst, a + q * m_ + s0, count, kW[q]);
+    }
+  }
+}
+
+template <class C, bool kOddStep>
+void LbmEngine::scatter_sparse(typename C::Stored* a, size_t s0, int count, const float* buf) {
+  C::encode_n(a + s0, buf, count, kW[0]);
+  for (int q = 1; q < kQ; ++q) {
+    const float* src = buf + q * kSparseBlock;
+    const int p = kOpp[q];
+    const float w = kW[q];
+    if (kOddStep) {
+      for (int t = 0; t < count; ++t) {
+        const size_t s = s0 + t;
+        const int32_t down = nbr(q, s);
+        const typename C::Stored v = C::encode(src[t], w);
+        if (down >= 0) {
+          a[q * m_ + down] = v;
+        } else {
+          a[p * m_ + s] = v;
+        }
+      }
+    } else {
+      C::encode_n(a + p * m_ + s0, src, count, w);
+    }
+  }
+}
+
+// One fused, in-place AA timestep: gather the streamed populations of a block
+// of cells, apply boundaries/moments/collision, store back into the locations
+// just read. When measuring the residual, the kernel writes the block's new
+// velocity to a small buffer that is diffed against the old one while it is
+// copied out, and the sums are reduced across threads. With update_fill the
+// block's fill level is advanced from those velocities while they are still
+// in cache, instead of in a separate pass over the grid. The sums add up in
+// residual_sums_ until finish_step(), so a step may be swept in parts.
+template <class C, bool kOddStep>
+void LbmEngine::sweep(float inlet_speed, bool update_fill, bool measure_residual, long long b0,
+                      long long b1) {
+  const float inlet_u[3] = {inlet_dir_[0] * inlet_speed, inlet_dir_[1] * inlet_speed,
+                            inlet_dir_[2] * inlet_speed};
+  const BlockParams bp = make_block_params(params_, inlet_u);
+  const CollideFn collide = collide_kernel();
+  typename C::Stored* a = populations<C>();
+
+  const int block = sparse_ ? kSparseBlock : nz_;
+
+  double du2 = 0.0, u2 = 0.0;
+
+#pragma omp parallel reduction(+ : du2, u2)
+  {
+    std::vector<float> buf(static_cast<size_t>(kQ) * block);
+    std::vector<float> u_new(measure_residual ? 3 * static_cast<size_t>(block) : 0);
+
+#pragma omp for schedule(static)
+    for (long long b = b0; b < b1; ++b) {
+      const size_t s0 = static_cast<size_t>(b) * block;
+      const int count = static_cast<int>(std::min<size_t>(block, m_ - s0));
+      if (sparse_) {
+        gather_sparse<C, kOddStep>(a, s0, count, buf.data());
+      } else {
+        gather_dense_row<C, kOddStep>(a, b, buf.data());
+      }
+
+      BlockOutputs out;
+      out.rho = rho_.data() + s0;
+      out.ux = ux_.data() + s0;
+      out.uy = uy_.data() + s0;
+      out.uz = uz_.data() + s0;
+      if (measure_residual) {
+        out.ux = u_new.data();
+        out.uy = u_new.data() + block;
+        out.uz = u_new.data() + 2 * block;
+      }
+      collide(buf.data(), block, count, flags_.data() + s0, bp, out);
+      if (measure_residual) {
+        float* u_old[3] = {ux_.data() + s0, uy_.data() + s0, uz_.data() + s0};
+        for (int d = 0; d < 3; ++d) {
+          const float* un = u_new.data() + d * block;
+          float* uo = u_old[d];
+          for (int t = 0; t < count; ++t) {
+            const float diff = un[t] - uo[t];
+            du2 += static_cast<double>(diff) * diff;
+            u2 += static_cast<double>(un[t]) * un[t];
+            uo[t] = un[t];
+          }
+        }
+      }
+      if (update_fill) {
+        this->update_fill(fill_.data(), fill_next_.data(), s0, count, out.ux, out.uy, out.uz);
+      }
+
+      if (sparse_) {
+        scatter_sparse<C, kOddStep>(a, s0, count, buf.data());
+      } else {
+        scatter_dense_row<C, kOddStep>(a, b, buf.data());
+      }
+    }
+  }
+
+  if (measure_residual) {
+    residual_sums_[0] += du2;
+    residual_sums_[1] += u2;
+  }
+}
+
+template <class C, bool kOddStep>
+void LbmEngine::update_dense_row(typename C::Stored* a, long long row, const BlockParams& bp,
+                                 CollideFn collide, const float* fill, float* fill_next,
+                                 float* buf) {
+  const size_t s0 = static_cast<size_t>(row) * nz_;
+  gather_dense_row<C, kOddStep>(a, row, buf);
+  BlockOutputs out;
+  out.rho = rho_.data() + s0;
+  out.ux = ux_.data() + s0;
+  out.uy = uy_.data() + s0;
+  out.uz = uz_.data() + s0;
+  collide(buf, nz_, nz_, flags_.data() + s0, bp, out);
+  if (fill) update_fill(fill, fill_next, s0, nz_, out.ux, out.uy, out.uz);
+  scatter_dense_row<C, kOddStep>(a, row, buf);
+}
+
+// `steps` dense steps in one pass, split into tiles and seams as described in
+// lbm_engine.hpp. Step t reads the fill level from fill[t % 2] and writes it
+// to the other buffer.
+template <class C>
+void LbmEngine::run_blocked(int steps, float inlet_speed, bool update_fill) {
+  const float inlet_u[3] = {inlet_dir_[0] * inlet_speed, inlet_dir_[1] * inlet_speed,
+                            inlet_dir_[2] * inlet_speed};
+  const BlockParams bp = make_block_params(params_, inlet_u);
+  const CollideFn collide = collide_kernel();
+  typename C::Stored* a = populations<C>();
+  float* fill[2] = {fill_.data(), fill_next_.data()};
+  const bool odd_first = odd_next_;
+  const int tiles = std::max(1, ny_ / block_tile_y_);
+
+  for (int phase = 0; phase < 4; ++phase) {
+    const bool x_seam = phase >= 2;
+    const bool y_seam = (phase & 1) != 0;
+
+#pragma omp parallel
+    {
+      std::vector<float> buf(static_cast<size_t>(kQ) * nz_);
+
+      // Step t of plane i (either may lie one period outside the grid) on the
+      // rows [j0, j1) of this task.
+      auto rows = [&](int t, int i, int j0, int j1) {
+        const long long plane = static_cast<long long>(wrap(i, nx_)) * ny_;
+        const float* f_in = update_fill ? fill[t & 1] : nullptr;
+        float* f_out = fill[(t + 1) & 1];
+        for (int j = j0; j < j1; ++j) {
+          const long long row = plane + wrap(j, ny_);
+          if (odd_first != ((t & 1) != 0)) {
+            update_dense_row<C, true>(a, row, bp, collide, f_in, f_out, buf.data());
+          } else {
+            update_dense_row<C, false>(a, row, bp, collide, f_in, f_out, buf.data());
+          }
+        }
+      };
+
+#pragma omp for schedule(dynamic)
+      for (int tile = 0; tile < tiles; ++tile) {
+        const int lo = static_cast<int>(static_cast<long long>(tile) * ny_ / tiles);
+        const int hi = static_cast<int>(static_cast<long long>(tile + 1) * ny_ / tiles);
+        // Rows of step t: the tile shrunk by t at both ends, or the seam at its upper end.
+        auto j0 = [&](int t) { return y_seam ? hi - 1 - t : lo + t; };
+        auto j1 = [&](int t) { return y_seam ? hi + t : hi - 1 - t; };
+        if (x_seam) {
+          for (int t = 0; t < steps; ++t) {
+            for (int i = nx_ - 1 - t; i < nx_ + t; ++i) rows(t, i, j0(t), j1(t));
+          }
+        } else {
+          // Wavefront: step t of plane i after step t - 1 of plane i + 1.
+          for (int w = 0; w < nx_ + 2 * steps; ++w) {
+            for (int t = 0; t < steps; ++t) {
+              const int i = w - 2 * t;
+              if (i >= t && i < nx_ - 1 - t) rows(t, i, j0(t), j1(t));
+            }
+          }
+        }
+      }
+    }
+  }
+
+  if (update_fill && (steps & 1)) fill_.swap(fill_next_);
+  if (steps & 1) odd_next_ = !odd_next_;
+  steps_done_ += steps;
+}
+
+// Upwind VOF-like fill transport, identical to LbmD3Q19Torch._update_fill_level.
+// Sparse cells read missing (solid) neighbours as fill 0, which is what the
+// dense grid holds there too. Called per block from the sweep, so it only
+// reads `fill` (complete from the previous step) and writes its own cells.
+void LbmEngine::update_fill(const float* fill, float* next, size_t s0, int count, const float* ux,
+                            const float* uy, const float* uz) {
+  const uint8_t* flags = flags_.data() + s0;
+  float* out = next + s0;
+  float lo[3], hi[3];
+
+  if (sparse_) {
+    for (int t = 0; t < count; ++t) {
+      const size_t s = s0 + t;
+      // Face directions: 1/2 = +x/-x, 3/4 = +y/-y, 5/6 = +z/-z.
+      for (int d = 0; d < 3; ++d) {
+        const int32_t up = nbr(2 * d + 1, s), dn = nbr(2 * d + 2, s);
+        hi[d] = up >= 0 ? fill[up] : 0.0f;
+        lo[d] = dn >= 0 ? fill[dn] : 0.0f;
+      }
+      const float v = upwind_fill(fill[s], ux[t], uy[t], uz[t], lo, hi);
+      out[t] = (flags[t] & kInlet) ? 1.0f : ((flags[t] & kSolid) ? 0.0f : v);
+    }
+    return;
+  }
+
+  // A dense block is one z-row; its x/y neighbours are whole rows too.
+  const int i = static_cast<int>(s0 / (static_cast<size_t>(ny_) * nz_));
+  const int j = static_cast<int>((s0 / nz_) % ny_);
+  const float* row = fill + s0;
+  const float* xm = fill + idx(wrap(i - 1, nx_), j, 0);
+  const float* xp = fill + idx(wrap(i + 1, nx_), j, 0);
+  const float* ym = fill + idx(i, wrap(j - 1, ny_), 0);
+  const float* yp = fill + idx(i, wrap(j + 1, ny_), 0);
+  for (int k = 0; k < count; ++k) {
+    lo[0] = xm[k];
+    hi[0] = xp[k];
+    lo[1] = ym[k];
+    hi[1] = yp[k];
+    lo[2] = row[k == 0 ? nz_ - 1 : k - 1];
+    hi[2] = row[k == nz_ - 1 ? 0 : k + 1];
+    const float v = upwind_fill(row[k], ux[k], uy[k], uz[k], lo, hi);
+    out[k] = (flags[k] & kInlet) ? 1.0f : ((flags[k] & kSolid) ? 0.0f : v);
+  }
+}
+
+}  // namespace fluid
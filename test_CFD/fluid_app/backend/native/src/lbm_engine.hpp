@@ -0,0 +1,269 @@
+// Native multicore D3Q19 LBM engine.
+//
+// Same physics as sim/lbm_torch.py (BGK + Guo gravity forcing, wall
+// bounce-back, equilibrium inlet, fixed-pressure outlet, upwind fill level)
+// but executed as one fused stream/boundary/macroscopic/collide sweep per
+// step instead of a chain of full-grid tensor temporaries.
+//
+// Streaming uses the AA access pattern, so a single population array is
+// updated in place:
+//   even step: read f_q from slot q of the cell itself, write f*_q to slot
+//              opp(q) of the same cell (no neighbour access at all);
+//   odd step:  read f_q from slot opp(q) of the upstream neighbour x - c_q,
+//              write f*_q to slot q of the downstream neighbour x + c_q.
+// Every step reads and writes exactly the same locations per cell, so cells
+// can be updated in any order (and in parallel) without a second buffer.
+//
+// The fill level is transported in the same sweep: each block updates its
+// cells from the velocities it has just computed, reading the previous fill
+// (unchanged during the sweep) and writing the next one, which is swapped in
+// once the sweep is done.
+//
+// Two lattice layouts share the sweep:
+//   dense:  every grid cell is stored, periodic wrap like torch.roll. Solid
+//           cells keep populations that nothing reads; per z-row the engine
+//           lists the runs of other cells and those next to a wall;
+//   sparse: only non-solid cells are stored, in Morton (Z-curve) order, and
+//           neighbours come from a precomputed index table (periodic too),
+//           so memory and work scale with the fluid volume instead of
+//           nx*ny*nz.
+// The layout is a storage choice only. In both, links into solid cells
+// bounce back half-way, as in the torch solver, solid cells read as rho = 1,
+// u = 0, fill = 0 and take no inlet/outlet mark, and every other cell goes
+// through the same arithmetic, so the fields are bitwise the same as long
+// as a cell is collided by the same kernel code (the SIMD kernels' scalar
+// tails can differ from their vector lanes in the last bit).
+//
+// Populations can be stored as float32 or as 16-bit deviations from the
+// lattice weights (see population_codec.hpp); the sweep always computes in
+// float32, converting only when it gathers and scatters a block.
+//
+// Temporal blocking (dense layout, see set_temporal_blocking()) advances T
+// steps per pass instead of one. One AA step of a cell only touches the
+// locations of its neighbours, so step t of a cell may run once step t - 1 is
+// done on every neighbour. The grid is split per step t into y-tiles of
+// tile_y rows, shrunk by t rows at each end, and the 2t + 1 seam rows
+// between tiles, and the same way along x into planes [t, nx - 1 - t) and
+// the 2t + 1 seam planes around the periodic wrap. The four tile/seam
+// combinations run one after another. The shrinking parts run as x
+// wavefronts, step t of plane i at front i + 2t, so each tile's rows are
+// still in cache for the next step. The seams run step by step. Tiles (and
+// seams) of one phase never touch and run in parallel. Every cell goes
+// through the same row update as in a plain sweep, so the results are
+// bitwise identical.
+//
+// Per-cell arrays are NUMA-placed (see numa.hpp): they are first written by
+// schedule(static) loops over storage indices, the split the plain sweeps
+// use, with the threads pinned to `cpus` when given. The tiles of a
+// temporally blocked pass are scheduled dynamically and do not follow it.
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bit_mask.hpp"
+#include "collide_kernel.hpp"
+#include "numa.hpp"
+#include "population_codec.hpp"
+
+namespace fluid {
+
+class LbmEngine {
+ public:
+  // Masks are bit-packed (nx, ny, nz) grids (see bit_mask.hpp); a view with
+  // null words means "no such cells". With `cpus`, OpenMP thread t runs on
+  // cpus[t % cpus.size()] while the engine places its arrays and in run().
+  // `huge_pages` backs the engine's large arrays (see numa.hpp).
+  LbmEngine(int nx, int ny, int nz, float nu_lbm,
+            const BitMaskView& solid, const BitMaskView& inlet, const BitMaskView& outlet,
+            const std::array<float, 3>& gravity_lbm, bool sparse = false,
+            Precision precision = Precision::kFloat32, const std::vector<int>& cpus = {},
+            HugePages huge_pages = HugePages::kOff);
+
+  void set_inlet_direction(const std::array<float, 3>& dir);
+  void set_gravity(const std::array<float, 3>& gravity_lbm);
+
+  // Advance `steps` timesteps with a constant inlet speed. With
+  // measure_residual the last step also computes residual().
+  void run(int steps, float inlet_speed, bool update_fill, bool measure_residual = false);
+
+  // Let run() advance `steps` timesteps per pass over the grid, on y-tiles of
+  // `tile_y` rows (see above); steps <= 1 turns it off. Needs the dense
+  // layout and tile_y >= 2 * steps. Grids with fewer than 4 * steps planes
+  // along x or 2 * steps rows along y, and measured steps, run plain.
+  void set_temporal_blocking(int steps, int tile_y);
+  int block_steps() const { return block_steps_; }
+  int block_tile_y() const { return block_tile_y_; }
+
+  // Relative velocity change of the last measured step,
+  // sqrt(sum |u_new - u_old|^2 / sum |u_new|^2) over stored cells. It is
+  // reduced inside the sweep while u is written, so it costs no extra pass.
+  // NaN until a step has been measured, +inf while the flow is still at rest.
+  double residual() const { return residual_; }
+
+  int nx() const { return nx_; }
+  int ny() const { return ny_; }
+  int nz() const { return nz_; }
+  size_t cells() const { return n_; }
+  size_t stored_cells() const { return m_; }
+  bool sparse() const { return sparse_; }
+  Precision precision() const { return precision_; }
+  const std::vector<int>& thread_cpus() const { return cpus_; }
+  HugePages huge_pages() const { return flags_.get_allocator().huge_pages; }
+  float nu() const { return nu_; }
+  float tau() const { return tau_; }
+  float omega() const { return params_.omega; }
+  long long steps_done() const { return steps_done_; }
+  std::array<float, 3> gravity() const { return {params_.gx, params_.gy, params_.gz}; }
+
+  // Macroscopic fields of the most recent step, scattered into C-ordered
+  // (nx, ny, nz) grids. Solid cells read as rho=1, u=0, fill=0.
+  void rho(float* out) const { to_grid(rho_, 1.0f, out); }
+  void ux(float* out) const { to_grid(ux_, 0.0f, out); }
+  void uy(float* out) const { to_grid(uy_, 0.0f, out); }
+  void uz(float* out) const { to_grid(uz_, 0.0f, out); }
+  void fill_level(float* out) const { to_grid(fill_, 0.0f, out); }
+
+  // Start from given macroscopic fields instead of rest, e.g. the converged
+  // solution of a similar run. Inputs are C-ordered (nx, ny, nz) grids like
+  // the getters above; every stored cell gets the (collided) equilibrium of
+  // its rho/u, and the inlet stays full. The step count is left alone.
+  void init_from_fields(const float* rho, const float* ux, const float* uy, const float* uz,
+                        const float* fill);
+
+  // Bytes held by populations, macroscopic fields, masks and index tables.
+  size_t memory_bytes() const;
+
+  // Raw solver state for checkpoints, indexed by storage index: the
+  // population array exactly as stored (kQ * stored_cells() floats, or
+  // uint16 for the 16-bit formats) and the fill level. Together with
+  // steps_done() and the AA parity that is everything a resumed run needs;
+  // the macroscopic fields are recomputed by the next step.
+  void* population_data();
+  float* fill_data() { return fill_.data(); }
+  bool odd_next() const { return odd_next_; }
+  // Call after writing population_data() / fill_data() from a checkpoint.
+  void restore_progress(long long steps_done, bool odd_next);
+
+  // Slab decomposition (see slab_lbm.hpp). With ghost planes on, x planes 0
+  // and nx - 1 of a dense engine hold copies of the neighbouring ranks' edge
+  // planes: they are never updated and the periodic x wrap is never taken.
+  // SlabLbm steps such an engine a range of planes at a time through
+  // sweep_planes() and finish_step(); run() refuses it.
+  void set_ghost_planes(bool on);
+  bool ghost_planes() const { return ghost_planes_; }
+  // One step's update of planes [i0, i1). finish_step() ends the step once
+  // every owned plane has been swept. residual_sums() are the sums behind
+  // residual() ({sum |du|^2, sum |u|^2}) of the last measured step, for
+  // reducing it across ranks.
+  void sweep_planes(int i0, int i1, float inlet_speed, bool update_fill, bool measure_residual);
+  void finish_step(bool update_fill, bool measured);
+  const std::array<double, 2>& residual_sums() const { return measured_sums_; }
+  // The kHaloSlots population slots of plane i whose x velocity is `sign`
+  // (+1 or -1), packed slot by slot: what one AA odd step of the next plane
+  // over reads and writes in plane i. halo_bytes() per plane.
+  static constexpr int kHaloSlots = 5;
+  size_t halo_bytes() const;
+  void pack_halo(int i, int sign, void* out) const;
+  void unpack_halo(int i, int sign, const void* in);
+  // unpack_halo() for the slots a neighbour sends back after its odd step,
+  // minus those whose upstream cell (in plane i - sign) is solid: that link
+  // bounced back, and the slot holds what this engine's own cell sent.
+  void unpack_returns(int i, int sign, const void* in);
+
+ private:
+  size_t idx(int i, int j, int k) const {
+    return (static_cast<size_t>(i) * ny_ + j) * nz_ + k;
+  }
+  // Storage index of the neighbour of stored cell s along direction q (q >= 1,
+  // periodic), or -1 if that neighbour is solid. Sparse layout only.
+  int32_t nbr(int q, size_t s) const { return nbr_[(q - 1) * m_ + s]; }
+
+  void build_sparse(const BitMaskView& solid);
+  void build_walls();
+  // Populations for grid fields rho/u (null = rest), stored as after an even step.
+  void init_populations(const float* rho, const float* ux, const float* uy, const float* uz);
+  template <class C>
+  void init_populations(const float* rho, const float* ux, const float* uy, const float* uz);
+  void to_grid(const PageVector<float>& v, float background, float* out) const;
+
+  // Population storage for codec C (f_ or f16_).
+  template <class C>
+  typename C::Stored* populations();
+
+  // One step over dense rows / sparse blocks [b0, b1).
+  template <class C>
+  void step(float inlet_speed, bool update_fill, bool measure_residual, long long b0,
+            long long b1);
+  template <class C>
+  void run_blocked(int steps, float inlet_speed, bool update_fill);
+  // One fused update of dense row `row` (no residual): fill -> fill_next if fill is set.
+  template <class C, bool kOddStep>
+  void update_dense_row(typename C::Stored* a, long long row, const BlockParams& bp,
+                        CollideFn collide, const float* fill, float* fill_next, float* buf);
+  template <class C, bool kOddStep>
+  void sweep(float inlet_speed, bool update_fill, bool measure_residual, long long b0,
+             long long b1);
+  long long sweep_blocks() const;
+  template <class C, bool kOddStep>
+  void gather_dense_row(const typename C::Stored* a, long long row, float* buf) const;
+  template <class C, bool kOddStep>
+  void scatter_dense_row(typename C::Stored* a, long long row, const float* buf);
+  template <class C, bool kOddStep>
+  void gather_sparse(const typename C::Stored* a, size_t s0, int count, float* buf) const;
+  template <class C, bool kOddStep>
+  void scatter_sparse(typename C::Stored* a, size_t s0, int count, const float* buf);
+
+  // Next fill level of stored cells [s0, s0 + count) given their new
+  // velocities (indexed from s0): fill -> next.
+  void update_fill(const float* fill, float* next, size_t s0, int count, const float* ux,
+                   const float* uy, const float* uz);
+
+  int nx_, ny_, nz_;
+  size_t n_;       // grid cells
+  size_t m_;       // stored cells (== n_ when dense)
+  bool sparse_;
+  Precision precision_;
+  float nu_, tau_;
+  CollideParams params_;
+  std::array<float, 3> inlet_dir_{0.0f, 0.0f, -1.0f};
+  long long steps_done_ = 0;
+  bool odd_next_ = true;  // parity of the next AA step
+  int block_steps_ = 1;   // temporal blocking, see set_temporal_blocking()
+  int block_tile_y_ = 0;
+  double residual_;
+  std::array<double, 2> residual_sums_{0.0, 0.0};  // of the step in progress
+  std::array<double, 2> measured_sums_{0.0, 0.0};
+  bool ghost_planes_ = false;
+  std::vector<int> cpus_;  // thread pinning, empty = none
+
+  // Everything below is indexed by storage index.
+  PageVector<uint8_t> flags_;
+  // Populations in AA layout, structure of arrays: f[q * m + cell]. Only one
+  // of the two is allocated, depending on precision_.
+  PageVector<float> f_;
+  PageVector<uint16_t> f16_;
+  PageVector<float> rho_, ux_, uy_, uz_;
+  PageVector<float> fill_, fill_next_;
+  // Sparse layout only: grid index of each stored cell and neighbour table.
+  PageVector<uint32_t> cell_;
+  PageVector<int32_t> nbr_;
+  // Dense layout only, indexed by z-row (see build_walls()): the runs of
+  // non-solid cells [k0, k1) in runs_[run_start_[row], run_start_[row + 1]),
+  // and likewise the non-solid cells next to a wall, with bit q of `dirs`
+  // set when the neighbour along c_q is solid.
+  struct RowRun {
+    int32_t k0, k1;
+  };
+  struct WallCell {
+    int32_t k;
+    uint32_t dirs;
+  };
+  PageVector<size_t> run_start_, wall_start_;
+  PageVector<RowRun> runs_;
+  PageVector<WallCell> walls_;
+};
+
+}  // namespace fluid
@@ -0,0 +1,196 @@
+#include "numa.hpp"
+
+#include <cstring>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+namespace fluid {
+
+namespace {
+
+size_t round_up(size_t v, size_t a) { return (v + a - 1) / a * a; }
+
+int thread_num() {
+#ifdef _OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
+#if defined(__linux__)
+
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << 26)  // log2(2 MiB) << MAP_HUGE_SHIFT
+#endif
+
+void* map_large(size_t size, HugePages mode) {
+  const int prot = PROT_READ | PROT_WRITE;
+  const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  if (mode == HugePages::kExplicit) {
+    void* p = mmap(nullptr, size, prot, flags | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+    if (p != MAP_FAILED) return p;
+  }
+  // Over-map by one huge page and trim both ends so the block is 2 MiB
+  // aligned; transparent huge pages only back aligned 2 MiB ranges.
+  const size_t span = size + kLargeBlock;
+  void* raw = mmap(nullptr, span, prot, flags, -1, 0);
+  if (raw == MAP_FAILED) throw std::bad_alloc();
+  char* base = static_cast<char*>(raw);
+  char* p = reinterpret_cast<char*>(round_up(reinterpret_cast<uintptr_t>(base), kLargeBlock));
+  const size_t head = static_cast<size_t>(p - base);
+  if (head > 0) munmap(base, head);
+  if (span - head > size) munmap(p + size, span - head - size);
+  if (mode != HugePages::kOff) madvise(p, size, MADV_HUGEPAGE);
+  return p;
+}
+
+void unmap_large(void* p, size_t size) { munmap(p, size); }
+
+void pin_current_thread(int cpu, std::vector<unsigned char>* saved) {
+  if (cpu < 0 || cpu >= CPU_SETSIZE) return;
+  cpu_set_t old;
+  if (sched_getaffinity(0, sizeof(old), &old) == 0) {
+    saved->resize(sizeof(old));
+    std::memcpy(saved->data(), &old, sizeof(old));
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  sched_setaffinity(0, sizeof(set), &set);
+}
+
+void restore_affinity(const std::vector<unsigned char>& saved) {
+  cpu_set_t old;
+  std::memcpy(&old, saved.data(), sizeof(old));
+  sched_setaffinity(0, sizeof(old), &old);
+}
+
+#elif defined(_WIN32)
+
+void* map_large(size_t size, HugePages mode) {
+  if (mode == HugePages::kExplicit) {
+    const size_t large = GetLargePageMinimum();
+    if (large > 0) {
+      void* p = VirtualAlloc(nullptr, round_up(size, large),
+                             MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+      if (p) return p;
+    }
+  }
+  // Committed pages get physical memory on first touch, as on Linux.
+  void* p = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void unmap_large(void* p, size_t) { VirtualFree(p, 0, MEM_RELEASE); }
+
+void pin_current_thread(int cpu, std::vector<unsigned char>* saved) {
+  // Single processor group only (the first 64 logical CPUs).
+  if (cpu < 0 || cpu >= static_cast<int>(8 * sizeof(DWORD_PTR))) return;
+  const DWORD_PTR old = SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu);
+  if (old) {
+    saved->resize(sizeof(old));
+    std::memcpy(saved->data(), &old, sizeof(old));
+  }
+}
+
+void restore_affinity(const std::vector<unsigned char>& saved) {
+  DWORD_PTR old;
+  std::memcpy(&old, saved.data(), sizeof(old));
+  SetThreadAffinityMask(GetCurrentThread(), old);
+}
+
+#else
+
+void* map_large(size_t size, HugePages) { return ::operator new(size); }
+void unmap_large(void* p, size_t) { ::operator delete(p); }
+void pin_current_thread(int, std::vector<unsigned char>*) {}
+void restore_affinity(const std::vector<unsigned char>&) {}
+
+#endif
+
+}  // namespace
+
+void* allocate_pages(size_t bytes, HugePages mode) {
+  if (bytes < kLargeBlock) return ::operator new(bytes);
+  return map_large(round_up(bytes, kLargeBlock), mode);
+}
+
+void free_pages(void* p, size_t bytes) noexcept {
+  if (!p) return;
+  if (bytes < kLargeBlock) {
+    ::operator delete(p);
+  } else {
+    unmap_large(p, round_up(bytes, kLargeBlock));
+  }
+}
+
+ThreadPinning::ThreadPinning(const std::vector<int>& cpus) {
+  if (cpus.empty()) return;
+  const int n = static_cast<int>(cpus.size());
+#ifdef _OPENMP
+  saved_.resize(static_cast<size_t>(omp_get_max_threads()));
+#else
+  saved_.resize(1);
+#endif
+  std::vector<std::vector<unsigned char>>& saved = saved_;
+#pragma omp parallel
+  {
+    const int t = thread_num();
+    pin_current_thread(cpus[t % n], &saved[static_cast<size_t>(t)]);
+  }
+}
+
+ThreadPinning::~ThreadPinning() {
+  if (saved_.empty()) return;
+  const std::vector<std::vector<unsigned char>>& saved = saved_;
+#pragma omp parallel num_threads(static_cast<int>(saved_.size()))
+  {
+    const size_t t = static_cast<size_t>(thread_num());
+    if (t < saved.size() && !saved[t].empty()) restore_affinity(saved[t]);
+  }
+}
+
+std::vector<int> page_nodes(const void* p, size_t bytes) {
+#if defined(__linux__) && defined(SYS_move_pages)
+  std::vector<int> nodes;
+  if (!p || bytes == 0) return nodes;
+  const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  const uintptr_t first = reinterpret_cast<uintptr_t>(p) & ~(page - 1);
+  const uintptr_t end = reinterpret_cast<uintptr_t>(p) + bytes;
+  const size_t count = static_cast<size_t>((end - first + page - 1) / page);
+  std::vector<void*> pages(count);
+  for (size_t i = 0; i < count; ++i) pages[i] = reinterpret_cast<void*>(first + i * page);
+  nodes.assign(count, -1);
+  // With no target nodes, move_pages only reports where each page is.
+  if (syscall(SYS_move_pages, 0, static_cast<unsigned long>(count), pages.data(), nullptr,
+              nodes.data(), 0) != 0) {
+    return {};
+  }
+  for (int& node : nodes) {
+    if (node < 0) node = -1;
+  }
+  return nodes;
+#else
+  (void)p;
+  (void)bytes;
+  return {};
+#endif
+}
+
+}  // namespace fluid
@@ -0,0 +1,125 @@
+// NUMA-aware placement of the engine's per-cell arrays.
+//
+// On a multi-socket machine the OS puts a page on the node of the thread that
+// first writes it. std::vector value-initializes on the calling thread, so a
+// lattice allocated that way lands on one node and the threads of the other
+// socket read all of it remotely. PageVector leaves its storage unwritten
+// (elements are default-initialized, large blocks come straight from the OS),
+// and the engine first writes every array from a schedule(static) loop over
+// storage indices: the same contiguous split its sweeps use, so each page
+// sits on the node of the thread that updates it. That holds as long as
+// OpenMP thread t stays on the same core, which ThreadPinning guarantees.
+//
+// Large blocks can also be backed by huge pages (the allocator's HugePages
+// mode, one per engine), which cuts TLB misses on the population array.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace fluid {
+
+enum class HugePages {
+  kOff,          // normal pages (the system's transparent huge page default applies)
+  kTransparent,  // ask for transparent huge pages (madvise, Linux only)
+  kExplicit,     // reserved huge pages: MAP_HUGETLB on Linux, MEM_LARGE_PAGES on
+                 // Windows (needs the "Lock pages in memory" privilege); when
+                 // none are available Linux falls back to kTransparent and
+                 // Windows, which has no transparent huge pages, to normal pages
+};
+
+inline const char* huge_pages_name(HugePages mode) {
+  switch (mode) {
+    case HugePages::kTransparent:
+      return "transparent";
+    case HugePages::kExplicit:
+      return "explicit";
+    default:
+      return "off";
+  }
+}
+
+// Blocks this large are mapped from the OS directly, aligned and rounded up
+// to 2 MiB (one x86-64 huge page); smaller ones come from operator new.
+constexpr size_t kLargeBlock = size_t(1) << 21;
+
+// `mode` applies to blocks of kLargeBlock bytes or more.
+void* allocate_pages(size_t bytes, HugePages mode);
+void free_pages(void* p, size_t bytes) noexcept;
+
+// std::allocator replacement for PageVector: resize() default-initializes,
+// so no page is written (and placed) until the engine's first-touch loop.
+// Carries the huge page mode of its container.
+template <class T>
+struct PageAllocator {
+  using value_type = T;
+
+  PageAllocator() = default;
+  explicit PageAllocator(HugePages mode) : huge_pages(mode) {}
+  template <class U>
+  PageAllocator(const PageAllocator<U>& other) : huge_pages(other.huge_pages) {}
+
+  T* allocate(size_t n) { return static_cast<T*>(allocate_pages(n * sizeof(T), huge_pages)); }
+  void deallocate(T* p, size_t n) noexcept { free_pages(p, n * sizeof(T)); }
+
+  template <class U>
+  void construct(U* p) {
+    ::new (static_cast<void*>(p)) U;
+  }
+  template <class U, class... Args>
+  void construct(U* p, Args&&... args) {
+    ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+  }
+
+  HugePages huge_pages = HugePages::kOff;
+};
+
+// Any block can be freed by any allocator (free_pages() does not need the
+// mode), so all compare equal and containers may swap storage freely.
+template <class T, class U>
+bool operator==(const PageAllocator<T>&, const PageAllocator<U>&) {
+  return true;
+}
+template <class T, class U>
+bool operator!=(const PageAllocator<T>&, const PageAllocator<U>&) {
+  return false;
+}
+
+template <class T>
+using PageVector = std::vector<T, PageAllocator<T>>;
+
+// v[0, n) = value, written by a schedule(static) loop (the first touch).
+template <class T>
+void parallel_fill(T* v, size_t n, T value) {
+  const long long count = static_cast<long long>(n);
+#pragma omp parallel for schedule(static)
+  for (long long i = 0; i < count; ++i) v[i] = value;
+}
+
+// Pins OpenMP thread t of the calling thread's team to cpus[t % cpus.size()]
+// for the object's lifetime (nothing if cpus is empty or the platform has no
+// affinity call). Between parallel regions the team's threads stay pinned, so
+// the same thread number keeps running on the same core; the destructor
+// restores every team thread's previous affinity from a parallel region of
+// the same size, so pooled threads reused by other work are not left on one
+// core.
+class ThreadPinning {
+ public:
+  explicit ThreadPinning(const std::vector<int>& cpus);
+  ~ThreadPinning();
+  ThreadPinning(const ThreadPinning&) = delete;
+  ThreadPinning& operator=(const ThreadPinning&) = delete;
+
+ private:
+  std::vector<std::vector<unsigned char>> saved_;  // affinity mask per thread number
+};
+
+// NUMA node of each page of [p, p + bytes), -1 where the page is not yet
+// backed by memory or the node is unknown. Empty where the platform cannot
+// tell (only Linux can).
+std::vector<int> page_nodes(const void* p, size_t bytes);
+
+}  // namespace fluid
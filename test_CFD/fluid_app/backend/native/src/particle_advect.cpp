@@ -0,0 +1,349 @@
+#include "particle_advect.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace fluid {
+
+namespace {
+
+constexpr float kOutsideSdf = -100.0f;
+constexpr float kPi = 3.14159265358979f;
+
+// Per-frame Euler rules: v <- 0.85 v + 0.15 u, normal velocity *= 0.3 near walls.
+constexpr float kMomentum = 0.85f;
+constexpr float kRelax = 0.15f;
+constexpr float kWallSlide = 0.7f;
+
+// SplitMix64 finalizer; random numbers are hashes of (seed, particle,
+// generation, draw), so they don't depend on evaluation order.
+inline uint64_t mix64(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+inline float uniform(uint64_t seed, uint64_t particle, uint64_t generation, uint64_t draw) {
+  const uint64_t h = mix64(mix64(mix64(seed ^ particle) ^ (generation << 8 | draw)));
+  return static_cast<float>(h >> 40) * (1.0f / 16777216.0f);  // 24 bits -> [0, 1)
+}
+
+inline float dot3(const float a[3], const float b[3]) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+
+// Terminal speed along gravity, then the overall speed limit.
+inline void cap_gravity_speed(float vel[3], const float g[3], float max_speed) {
+  const float gs = dot3(vel, g);
+  if (gs > max_speed) {
+    for (int k = 0; k < 3; ++k) vel[k] -= (gs - max_speed) * g[k];
+  }
+}
+
+inline void cap_speed(float vel[3], float max_speed) {
+  const float speed = std::sqrt(dot3(vel, vel));
+  if (speed > max_speed) {
+    for (int k = 0; k < 3; ++k) vel[k] = vel[k] * max_speed / (speed + 1e-9f);
+  }
+}
+
+// Random point in the emission sphere (same distribution as advect.py:
+// uniform angles, radius ~ u^(1/3)), in the gravity-aligned basis.
+void emission_offset(const AdvectParams& p, const float basis[3][3], uint64_t particle,
+                     uint32_t generation, float out[3]) {
+  const float theta = 2.0f * kPi * uniform(p.seed, particle, generation, 0);
+  const float phi = kPi * uniform(p.seed, particle, generation, 1);
+  const float r = std::cbrt(uniform(p.seed, particle, generation, 2)) * p.emit_radius;
+  const float a = r * std::sin(phi) * std::cos(theta);
+  const float b = r * std::sin(phi) * std::sin(theta);
+  const float c = r * std::cos(phi);
+  for (int k = 0; k < 3; ++k) out[k] = a * basis[0][k] + b * basis[1][k] + c * basis[2][k];
+}
+
+}  // namespace
+
+ParticleAdvector::ParticleAdvector(const float* x, int nx, const float* y, int ny, const float* z,
+                                   int nz, const float* ux, const float* uy, const float* uz,
+                                   const float* sdf) {
+  const float* coords[3] = {x, y, z};
+  n_[0] = nx;
+  n_[1] = ny;
+  n_[2] = nz;
+  for (int a = 0; a < 3; ++a) {
+    if (n_[a] < 2) throw std::invalid_argument("advection grid needs at least 2 points per axis");
+    lo_[a] = coords[a][0];
+    hi_[a] = coords[a][n_[a] - 1];
+    inv_h_[a] = static_cast<float>(n_[a] - 1) / (hi_[a] - lo_[a]);
+  }
+  cell_ = (1.0f / inv_h_[0] + 1.0f / inv_h_[1] + 1.0f / inv_h_[2]) / 3.0f;
+  const size_t cells = static_cast<size_t>(nx) * ny * nz;
+  grid_.resize(4 * cells);
+  const int64_t n = static_cast<int64_t>(cells);
+#pragma omp parallel for schedule(static)
+  for (int64_t c = 0; c < n; ++c) {
+    float* g = &grid_[4 * static_cast<size_t>(c)];
+    g[0] = ux[c];
+    g[1] = uy[c];
+    g[2] = uz[c];
+    g[3] = sdf[c];
+  }
+}
+
+ParticleAdvector::Sample ParticleAdvector::sample(const float p[3]) const {
+  int i[3];
+  float t[3];
+  for (int a = 0; a < 3; ++a) {
+    if (!(p[a] >= lo_[a] && p[a] <= hi_[a])) return {{0.0f, 0.0f, 0.0f}, kOutsideSdf};
+    const float f = (p[a] - lo_[a]) * inv_h_[a];
+    i[a] = std::min(static_cast<int>(f), n_[a] - 2);
+    t[a] = f - static_cast<float>(i[a]);
+  }
+  const size_t sz = 4;
+  const size_t sy = sz * n_[2];
+  const size_t sx = sy * n_[1];
+  const float* g = &grid_[i[0] * sx + i[1] * sy + i[2] * sz];
+  float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  for (int corner = 0; corner < 8; ++corner) {
+    const int cx = corner >> 2, cy = (corner >> 1) & 1, cz = corner & 1;
+    const float w = (cx ? t[0] : 1.0f - t[0]) * (cy ? t[1] : 1.0f - t[1]) * (cz ? t[2] : 1.0f - t[2]);
+    const float* node = g + cx * sx + cy * sy + cz * sz;
+    for (int k = 0; k < 4; ++k) acc[k] += w * node[k];
+  }
+  return {{acc[0], acc[1], acc[2]}, acc[3]};
+}
+
+void ParticleAdvector::normal(const float p[3], float eps, const float fallback[3], float n[3]) const {
+  for (int a = 0; a < 3; ++a) {
+    float q[3] = {p[0], p[1], p[2]};
+    q[a] = p[a] + eps;
+    const float plus = sdf_at(q);
+    q[a] = p[a] - eps;
+    n[a] = (plus - sdf_at(q)) / (2.0f * eps);
+  }
+  const float mag = std::sqrt(dot3(n, n));
+  for (int a = 0; a < 3; ++a) n[a] = mag > 1e-6f ? n[a] / mag : fallback[a];
+}
+
+bool ParticleAdvector::apply_walls(float pos[3], float vel[3], float sdf, float slide,
+                                   float attraction, const AdvectParams& prm,
+                                   const float up[3]) const {
+  // Near a wall: slide along it and stick to it a little.
+  if (sdf > 0.0f && sdf < prm.surface_thickness) {
+    float n[3];
+    normal(pos, prm.gradient_eps, up, n);
+    const float vn = dot3(vel, n);
+    for (int k = 0; k < 3; ++k) vel[k] -= vn * n[k] * slide + n[k] * attraction;
+  }
+  if (!(sdf < 0.0f)) return false;
+  // Inside solid: push out past the wall and bounce.
+  float n[3];
+  normal(pos, prm.gradient_eps, up, n);
+  const float push = std::fabs(sdf) + prm.collision_push;
+  for (int k = 0; k < 3; ++k) pos[k] += n[k] * push;
+  const float vn = dot3(vel, n);
+  for (int k = 0; k < 3; ++k) vel[k] -= vn * n[k] * 1.8f;
+  return true;
+}
+
+bool ParticleAdvector::euler_frame(float pos[3], float vel[3], const AdvectParams& prm,
+                                   const float up[3]) const {
+  const float* g = prm.gravity.data();
+  const Sample s = sample(pos);
+  // Relax towards the flow, fall, cap the speed along gravity.
+  for (int k = 0; k < 3; ++k) {
+    vel[k] = vel[k] * kMomentum + s.u[k] * prm.velocity_scale * kRelax;
+    vel[k] += g[k] * prm.gravity_accel;
+  }
+  cap_gravity_speed(vel, g, prm.max_gravity_speed);
+  const bool hit = apply_walls(pos, vel, s.sdf, kWallSlide, prm.surface_attraction, prm, up);
+  cap_speed(vel, prm.max_speed);
+  for (int k = 0; k < 3; ++k) pos[k] += vel[k];
+  return hit;
+}
+
+bool ParticleAdvector::rk_frame(float pos[3], float vel[3], const AdvectParams& prm,
+                                const float up[3], int* substeps) const {
+  const float* g = prm.gravity.data();
+  const float rate = -std::log(kMomentum);  // per frame
+
+  // dv/dt at (x, v) for the flow sample s.
+  auto accel = [&](const Sample& s, const float v[3], float a[3]) {
+    for (int k = 0; k < 3; ++k) a[k] = rate * (s.u[k] * prm.velocity_scale - v[k]) + g[k] * prm.gravity_accel;
+  };
+  auto accel_at = [&](const float x[3], const float v[3], float a[3]) { accel(sample(x), v, a); };
+
+  bool hit = false;
+  float remaining = 1.0f;  // of this frame
+  int n = 0;
+  while (remaining > 0.0f) {
+    // The first stage's sample also gives the distance to the wall. The step
+    // covers about |v| + |dv/dt| / 2 per unit time; keep that under the CFL
+    // bound and, in fluid, under the wall distance (but at least half a cell).
+    const Sample s = sample(pos);
+    float a1[3];
+    accel(s, vel, a1);
+    const float reach = std::sqrt(dot3(vel, vel)) + 0.5f * std::sqrt(dot3(a1, a1));
+    float bound = prm.cfl * cell_;
+    if (s.sdf > 0.0f) bound = std::min(bound, std::max(s.sdf, 0.5f * cell_));
+    ++n;
+    const bool last = n >= prm.max_substeps || reach * remaining <= bound;
+    const float h = last ? remaining : bound / reach;
+    remaining = last ? 0.0f : remaining - h;
+
+    float dx[3], dv[3];
+    if (prm.integrator == Integrator::kRk4) {
+      float a2[3], a3[3], a4[3], x2[3], v2[3], x3[3], v3[3], x4[3], v4[3];
+      for (int k = 0; k < 3; ++k) {
+        x2[k] = pos[k] + 0.5f * h * vel[k];
+        v2[k] = vel[k] + 0.5f * h * a1[k];
+      }
+      accel_at(x2, v2, a2);
+      for (int k = 0; k < 3; ++k) {
+        x3[k] = pos[k] + 0.5f * h * v2[k];
+        v3[k] = vel[k] + 0.5f * h * a2[k];
+      }
+      accel_at(x3, v3, a3);
+      for (int k = 0; k < 3; ++k) {
+        x4[k] = pos[k] + h * v3[k];
+        v4[k] = vel[k] + h * a3[k];
+      }
+      accel_at(x4, v4, a4);
+      for (int k = 0; k < 3; ++k) {
+        dx[k] = h / 6.0f * (vel[k] + 2.0f * v2[k] + 2.0f * v3[k] + v4[k]);
+        dv[k] = h / 6.0f * (a1[k] + 2.0f * a2[k] + 2.0f * a3[k] + a4[k]);
+      }
+    } else {  // midpoint
+      float a2[3], xm[3], vm[3];
+      for (int k = 0; k < 3; ++k) {
+        xm[k] = pos[k] + 0.5f * h * vel[k];
+        vm[k] = vel[k] + 0.5f * h * a1[k];
+      }
+      accel_at(xm, vm, a2);
+      for (int k = 0; k < 3; ++k) {
+        dx[k] = h * vm[k];
+        dv[k] = h * a2[k];
+      }
+    }
+    for (int k = 0; k < 3; ++k) {
+      pos[k] += dx[k];
+      vel[k] += dv[k];
+    }
+    cap_gravity_speed(vel, g, prm.max_gravity_speed);
+    const float slide = 1.0f - std::pow(1.0f - kWallSlide, h);
+    hit = apply_walls(pos, vel, sdf_at(pos), slide, prm.surface_attraction * h, prm, up) || hit;
+    cap_speed(vel, prm.max_speed);
+  }
+  *substeps = n;
+  return hit;
+}
+
+void ParticleAdvector::start(int n_particles, const AdvectParams& params) {
+  prm_ = params;
+  frame_ = 0;
+  const float* g = prm_.gravity.data();
+
+  // Emission basis: two unit vectors perpendicular to gravity, then gravity.
+  {
+    const float ex[3] = {1.0f, 0.0f, 0.0f}, ey[3] = {0.0f, 1.0f, 0.0f};
+    auto cross = [](const float a[3], const float b[3], float out[3]) {
+      out[0] = a[1] * b[2] - a[2] * b[1];
+      out[1] = a[2] * b[0] - a[0] * b[2];
+      out[2] = a[0] * b[1] - a[1] * b[0];
+    };
+    cross(g, ex, basis_[0]);
+    if (std::sqrt(dot3(basis_[0], basis_[0])) < 0.1f) cross(g, ey, basis_[0]);
+    for (int r = 0; r < 2; ++r) {
+      if (r == 1) cross(g, basis_[0], basis_[1]);
+      const float m = std::sqrt(dot3(basis_[r], basis_[r])) + 1e-9f;
+      for (int k = 0; k < 3; ++k) basis_[r][k] /= m;
+    }
+    for (int k = 0; k < 3; ++k) basis_[2][k] = g[k];
+  }
+
+  const size_t np = static_cast<size_t>(n_particles);
+  for (auto* v : {&px_, &py_, &pz_, &vx_, &vy_, &vz_}) v->assign(np, 0.0f);
+  age_.assign(np, 0);
+  birth_.assign(np, 0);
+  generation_.assign(np, 0);
+  for (size_t i = 0; i < np; ++i) {
+    birth_[i] = std::min(static_cast<int32_t>(uniform(prm_.seed, i, 0, 3) * prm_.emission_frames),
+                         prm_.emission_frames - 1);
+    float off[3];
+    emission_offset(prm_, basis_, i, 0, off);
+    px_[i] = prm_.source[0] + off[0];
+    py_[i] = prm_.source[1] + off[1];
+    pz_[i] = prm_.source[2] + off[2];
+    vx_[i] = g[0] * prm_.emit_speed;
+    vy_[i] = g[1] * prm_.emit_speed;
+    vz_[i] = g[2] * prm_.emit_speed;
+  }
+}
+
+AdvectStats ParticleAdvector::advance(int n_frames, float* frames) {
+  const AdvectParams& prm = prm_;
+  const float* g = prm.gravity.data();
+  const float up[3] = {-g[0], -g[1], -g[2]};
+  const int n_particles = num_particles();
+  const size_t np = static_cast<size_t>(n_particles);
+
+  const float lo[3] = {lo_[0] - prm.domain_margin, lo_[1] - prm.domain_margin, lo_[2] - prm.domain_margin};
+  const float hi[3] = {hi_[0] + prm.domain_margin, hi_[1] + prm.domain_margin, hi_[2] + prm.domain_margin};
+
+  long long respawned = 0, collisions = 0, particle_steps = 0, substeps = 0;
+  for (int f = 0; f < n_frames; ++f, ++frame_) {
+    const int t = frame_;
+    float* out = frames + static_cast<size_t>(f) * np * 3;
+#pragma omp parallel for schedule(static) reduction(+ : respawned, collisions, particle_steps, substeps)
+    for (int ip = 0; ip < n_particles; ++ip) {
+      const size_t i = static_cast<size_t>(ip);
+      float pos[3] = {px_[i], py_[i], pz_[i]};
+      float vel[3] = {vx_[i], vy_[i], vz_[i]};
+      for (int k = 0; k < 3; ++k) out[3 * i + k] = pos[k];
+      if (birth_[i] > t) continue;  // waiting in the emission sphere
+
+      int steps = 1;
+      const bool hit = prm.integrator == Integrator::kEuler ? euler_frame(pos, vel, prm, up)
+                                                            : rk_frame(pos, vel, prm, up, &steps);
+      collisions += hit ? 1 : 0;
+      substeps += steps;
+      ++particle_steps;
+
+      // Respawn when far outside, far from any wall (unless falling),
+      // deep in solid or too old.
+      bool far_out = false;
+      for (int k = 0; k < 3; ++k) far_out = far_out || pos[k] < lo[k] || pos[k] > hi[k];
+      const float new_sdf = sdf_at(pos);
+      const bool falling = dot3(vel, g) > prm.gravity_accel * 0.5f;
+      const bool too_far = new_sdf > prm.max_distance_from_surface && !falling;
+      const bool too_old = age_[i] > prm.max_age;
+      if (far_out || too_far || too_old || new_sdf < -prm.respawn_depth) {
+        ++respawned;
+        float off[3];
+        emission_offset(prm, basis_, i, ++generation_[i], off);
+        for (int k = 0; k < 3; ++k) {
+          pos[k] = prm.source[k] + off[k];
+          vel[k] = g[k] * prm.emit_speed;
+        }
+        age_[i] = 0;
+      }
+      ++age_[i];
+      px_[i] = pos[0], py_[i] = pos[1], pz_[i] = pos[2];
+      vx_[i] = vel[0], vy_[i] = vel[1], vz_[i] = vel[2];
+    }
+  }
+
+  AdvectStats stats;
+  stats.respawned = static_cast<size_t>(respawned);
+  stats.collisions = static_cast<size_t>(collisions);
+  stats.particle_steps = static_cast<size_t>(particle_steps);
+  stats.substeps = static_cast<size_t>(substeps);
+  return stats;
+}
+
+AdvectStats ParticleAdvector::run(int n_particles, int n_frames, const AdvectParams& params,
+                                  float* frames) {
+  start(n_particles, params);
+  return advance(n_frames, frames);
+}
+
+}  // namespace fluid
@@ -0,0 +1,46 @@
+#include "population_codec.hpp"
+
+#include "cpu_features.hpp"
+
+namespace fluid {
+
+namespace {
+
+using HalfDecodeFn = void (*)(float*, const uint16_t*, int, float);
+using HalfEncodeFn = void (*)(uint16_t*, const float*, int, float);
+
+void half_decode_n_scalar(float* dst, const uint16_t* src, int n, float w) {
+  for (int k = 0; k < n; ++k) dst[k] = half_to_float(src[k]) + w;
+}
+
+void half_encode_n_scalar(uint16_t* dst, const float* src, int n, float w) {
+  for (int k = 0; k < n; ++k) dst[k] = float_to_half(src[k] - w);
+}
+
+HalfDecodeFn pick_decode() {
+#ifdef FLUID_HAVE_X86_KERNELS
+  if (cpu_features().f16c) return half_decode_n_f16c;
+#endif
+  return half_decode_n_scalar;
+}
+
+HalfEncodeFn pick_encode() {
+#ifdef FLUID_HAVE_X86_KERNELS
+  if (cpu_features().f16c) return half_encode_n_f16c;
+#endif
+  return half_encode_n_scalar;
+}
+
+}  // namespace
+
+void half_decode_n(float* dst, const uint16_t* src, int n, float w) {
+  static const HalfDecodeFn fn = pick_decode();
+  fn(dst, src, n, w);
+}
+
+void half_encode_n(uint16_t* dst, const float* src, int n, float w) {
+  static const HalfEncodeFn fn = pick_encode();
+  fn(dst, src, n, w);
+}
+
+}  // namespace fluid
@@ -0,0 +1,136 @@
+// Storage formats for the population array.
+//
+// Populations always stay close to their rest equilibrium f_q ~ w_q, so the
+// 16-bit formats store the deviation f_q - w_q instead of f_q itself: the
+// exponent then tracks the (small) deviation and the whole mantissa goes into
+// resolving it. All arithmetic stays in float32; only loads and stores convert.
+//
+//   fp32: plain float, 4 bytes per population
+//   fp16: IEEE binary16 of f_q - w_q (11-bit significand), 2 bytes
+//   bf16: bfloat16 of f_q - w_q (8-bit significand, float32 range), 2 bytes
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace fluid {
+
+enum class Precision { kFloat32, kFloat16, kBFloat16 };
+
+inline uint32_t float_bits(float f) {
+  uint32_t u;
+  std::memcpy(&u, &f, sizeof(u));
+  return u;
+}
+
+inline float bits_float(uint32_t u) {
+  float f;
+  std::memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
+// float -> binary16, round to nearest even (overflow saturates to inf).
+inline uint16_t float_to_half(float value) {
+  constexpr uint32_t kF32Inf = 255u << 23;
+  constexpr uint32_t kF16Max = (127u + 16u) << 23;
+  constexpr uint32_t kDenormMagic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+  uint32_t u = float_bits(value);
+  const uint32_t sign = u & 0x80000000u;
+  u ^= sign;
+
+  uint32_t h;
+  if (u >= kF16Max) {
+    h = u > kF32Inf ? 0x7e00u : 0x7c00u;
+  } else if (u < (113u << 23)) {
+    // Subnormal result: let the FPU round by adding a magic constant.
+    h = float_bits(bits_float(u) + bits_float(kDenormMagic)) - kDenormMagic;
+  } else {
+    const uint32_t mant_odd = (u >> 13) & 1u;
+    u += (static_cast<uint32_t>(15 - 127) << 23) + 0xfffu;
+    u += mant_odd;
+    h = u >> 13;
+  }
+  return static_cast<uint16_t>(h | (sign >> 16));
+}
+
+inline float half_to_float(uint16_t h) {
+  constexpr uint32_t kShiftedExp = 0x7c00u << 13;
+  uint32_t u = (h & 0x7fffu) << 13;
+  const uint32_t exp = u & kShiftedExp;
+  u += (127u - 15u) << 23;
+  if (exp == kShiftedExp) {
+    u += (128u - 16u) << 23;  // inf / nan
+  } else if (exp == 0) {
+    u += 1u << 23;  // zero / subnormal: renormalise
+    u = float_bits(bits_float(u) - bits_float(113u << 23));
+  }
+  return bits_float(u | (static_cast<uint32_t>(h & 0x8000u) << 16));
+}
+
+// float -> bfloat16, round to nearest even (populations are never nan).
+inline uint16_t float_to_bf16(float value) {
+  const uint32_t u = float_bits(value);
+  return static_cast<uint16_t>((u + 0x7fffu + ((u >> 16) & 1u)) >> 16);
+}
+
+inline float bf16_to_float(uint16_t b) { return bits_float(static_cast<uint32_t>(b) << 16); }
+
+// Bulk fp16 conversions, dst[k] = half(src[k]) + w and dst[k] = half(src[k] - w).
+// They use F16C instructions when the CPU has them (same rounding as above).
+void half_decode_n(float* dst, const uint16_t* src, int n, float w);
+void half_encode_n(uint16_t* dst, const float* src, int n, float w);
+#ifdef FLUID_HAVE_X86_KERNELS
+void half_decode_n_f16c(float* dst, const uint16_t* src, int n, float w);
+void half_encode_n_f16c(uint16_t* dst, const float* src, int n, float w);
+#endif
+
+// Codecs used by the engine's gather/scatter; `w` is the lattice weight of
+// the population being converted. decode_n/encode_n convert contiguous runs.
+struct Float32Codec {
+  using Stored = float;
+  static float decode(Stored v, float) { return v; }
+  static Stored encode(float f, float) { return f; }
+  static void decode_n(float* dst, const Stored* src, int n, float) {
+    std::memcpy(dst, src, n * sizeof(float));
+  }
+  static void encode_n(Stored* dst, const float* src, int n, float) {
+    std::memcpy(dst, src, n * sizeof(float));
+  }
+};
+
+struct Float16Codec {
+  using Stored = uint16_t;
+  static float decode(Stored v, float w) { return half_to_float(v) + w; }
+  static Stored encode(float f, float w) { return float_to_half(f - w); }
+  static void decode_n(float* dst, const Stored* src, int n, float w) { half_decode_n(dst, src, n, w); }
+  static void encode_n(Stored* dst, const float* src, int n, float w) { half_encode_n(dst, src, n, w); }
+};
+
+struct BFloat16Codec {
+  using Stored = uint16_t;
+  static float decode(Stored v, float w) { return bf16_to_float(v) + w; }
+  static Stored encode(float f, float w) { return float_to_bf16(f - w); }
+  static void decode_n(float* dst, const Stored* src, int n, float w) {
+    for (int k = 0; k < n; ++k) dst[k] = decode(src[k], w);
+  }
+  static void encode_n(Stored* dst, const float* src, int n, float w) {
+    for (int k = 0; k < n; ++k) dst[k] = encode(src[k], w);
+  }
+};
+
+inline const char* precision_name(Precision p) {
+  switch (p) {
+    case Precision::kFloat16:
+      return "fp16";
+    case Precision::kBFloat16:
+      return "bf16";
+    default:
+      return "fp32";
+  }
+}
+
+inline size_t precision_bytes(Precision p) { return p == Precision::kFloat32 ? 4 : 2; }
+
+}  // namespace fluid
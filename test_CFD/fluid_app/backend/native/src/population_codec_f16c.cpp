@@ -0,0 +1,35 @@
+// F16C versions of the bulk fp16 population conversions. Built with -mf16c
+// (/arch:AVX2) and only called when cpu_features() reports support. Like the
+// SIMD collision kernels, nothing here may call the header's inline helpers.
+#include <immintrin.h>
+
+#include "population_codec.hpp"
+
+namespace fluid {
+
+void half_decode_n_f16c(float* dst, const uint16_t* src, int n, float w) {
+  const __m256 wv = _mm256_set1_ps(w);
+  int k = 0;
+  for (; k + 8 <= n; k += 8) {
+    const __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + k));
+    _mm256_storeu_ps(dst + k, _mm256_add_ps(_mm256_cvtph_ps(h), wv));
+  }
+  for (; k < n; ++k) {
+    dst[k] = _cvtsh_ss(src[k]) + w;
+  }
+}
+
+void half_encode_n_f16c(uint16_t* dst, const float* src, int n, float w) {
+  const __m256 wv = _mm256_set1_ps(w);
+  int k = 0;
+  for (; k + 8 <= n; k += 8) {
+    const __m256 d = _mm256_sub_ps(_mm256_loadu_ps(src + k), wv);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + k),
+                     _mm256_cvtps_ph(d, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+  }
+  for (; k < n; ++k) {
+    dst[k] = _cvtss_sh(src[k] - w, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  }
+}
+
+}  // namespace fluid
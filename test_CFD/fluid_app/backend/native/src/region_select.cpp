@@ -0,0 +1,123 @@
+#include "region_select.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <utility>
+
+namespace fluid {
+
+namespace {
+
+// [lo, hi) of the ascending axis values within [a, b].
+std::pair<int, int> axis_range(const float* c, int n, float a, float b) {
+  const int lo = static_cast<int>(std::lower_bound(c, c + n, a) - c);
+  const int hi = static_cast<int>(std::upper_bound(c, c + n, b) - c);
+  return {lo, std::max(lo, hi)};
+}
+
+// Index of the axis value nearest to v.
+int nearest_index(const float* c, int n, float v) {
+  const int hi = static_cast<int>(std::lower_bound(c, c + n, v) - c);
+  if (hi == 0) return 0;
+  if (hi == n) return n - 1;
+  return v - c[hi - 1] <= c[hi] - v ? hi - 1 : hi;
+}
+
+double sq(double v) { return v * v; }
+
+}  // namespace
+
+BitMask select_sphere(const float* x, int nx, const float* y, int ny, const float* z, int nz,
+                      const std::array<float, 3>& center, float radius,
+                      const BitMaskView& exclude) {
+  BitMask out(nx, ny, nz);
+  if (!(radius >= 0.0f)) return out;
+  const std::pair<int, int> xr = axis_range(x, nx, center[0] - radius, center[0] + radius);
+  const std::pair<int, int> yr = axis_range(y, ny, center[1] - radius, center[1] + radius);
+  const std::pair<int, int> zr = axis_range(z, nz, center[2] - radius, center[2] + radius);
+  const float r2 = radius * radius;
+
+  // Rows of different i are disjoint words of `out`.
+#pragma omp parallel for schedule(static)
+  for (int i = xr.first; i < xr.second; ++i) {
+    const float dx = x[i] - center[0];
+    for (int j = yr.first; j < yr.second; ++j) {
+      const float dy = y[j] - center[1];
+      const float dxy2 = dx * dx + dy * dy;
+      if (dxy2 > r2) continue;
+      uint64_t* row = out.row(i, j);
+      const uint64_t* skip = exclude.words ? exclude.row(i, j) : nullptr;
+      for (int k = zr.first; k < zr.second; ++k) {
+        const float dz = z[k] - center[2];
+        if (dxy2 + dz * dz <= r2 && !(skip && test_bit(skip, k))) set_bit(row, k);
+      }
+    }
+  }
+  return out;
+}
+
+std::vector<int64_t> nearest_fluid_cells(const BitMaskView& solid, const float* x, const float* y,
+                                         const float* z, const std::array<float, 3>& point,
+                                         size_t count) {
+  const int n[3] = {solid.nx, solid.ny, solid.nz};
+  const float* axis[3] = {x, y, z};
+  std::vector<int64_t> out;
+  if (count == 0 || n[0] <= 0 || n[1] <= 0 || n[2] <= 0) return out;
+  int c[3];
+  for (int a = 0; a < 3; ++a) c[a] = nearest_index(axis[a], n[a], point[a]);
+
+  // Every cell more than s shells out leaves the shell along some axis, past
+  // the axis value s + 1 cells from c, which is at least this far from the
+  // point (c is the nearest index, so the point lies between those values).
+  // Infinite once the shells cover the grid.
+  auto axis_sq = [&](int a, int i) { return sq(static_cast<double>(axis[a][i]) - point[a]); };
+  auto beyond_sq = [&](int s) {
+    double lb = std::numeric_limits<double>::infinity();
+    for (int a = 0; a < 3; ++a) {
+      if (c[a] - s - 1 >= 0) lb = std::min(lb, axis_sq(a, c[a] - s - 1));
+      if (c[a] + s + 1 < n[a]) lb = std::min(lb, axis_sq(a, c[a] + s + 1));
+    }
+    return lb;
+  };
+
+  // (squared distance, flat index); ordering on both makes ties deterministic.
+  std::vector<std::pair<double, int64_t>> best;
+  for (int s = 0;; ++s) {
+    const int i0 = std::max(c[0] - s, 0), i1 = std::min(c[0] + s, n[0] - 1);
+    const int j0 = std::max(c[1] - s, 0), j1 = std::min(c[1] + s, n[1] - 1);
+    const int k0 = std::max(c[2] - s, 0), k1 = std::min(c[2] + s, n[2] - 1);
+    for (int i = i0; i <= i1; ++i) {
+      const double dx2 = axis_sq(0, i);
+      for (int j = j0; j <= j1; ++j) {
+        const double dxy2 = dx2 + axis_sq(1, j);
+        const uint64_t* row = solid.words ? solid.row(i, j) : nullptr;
+        const int64_t base = (static_cast<int64_t>(i) * n[1] + j) * n[2];
+        auto visit = [&](int k) {
+          if (row && test_bit(row, k)) return;
+          best.emplace_back(dxy2 + axis_sq(2, k), base + k);
+        };
+        if (std::abs(i - c[0]) == s || std::abs(j - c[1]) == s) {
+          for (int k = k0; k <= k1; ++k) visit(k);  // shell face: the whole z span
+        } else {
+          if (c[2] - s >= 0) visit(c[2] - s);
+          if (s > 0 && c[2] + s < n[2]) visit(c[2] + s);
+        }
+      }
+    }
+    const double lb = beyond_sq(s);
+    if (best.size() >= count) {
+      std::nth_element(best.begin(), best.begin() + (count - 1), best.end());
+      best.resize(count);
+      if (best.back().first < lb) break;  // back() is the count-th nearest so far
+    }
+    if (lb == std::numeric_limits<double>::infinity()) break;
+  }
+
+  std::sort(best.begin(), best.end());
+  out.reserve(best.size());
+  for (const auto& b : best) out.push_back(b.second);
+  return out;
+}
+
+}  // namespace fluid
@@ -0,0 +1,32 @@
+// Inlet/outlet region selection on the lattice.
+//
+// Both queries work on the grid axes (ascending cell-centre coordinates, mm)
+// and the bit-packed solid mask, and only touch cells near the query point:
+// the sphere walks its bounding box, found by binary search on the axes, and
+// the nearest-fluid search visits Chebyshev shells of growing radius around
+// the point's cell (a breadth-first search over the grid) until no unvisited
+// cell can beat the ones found. Their cost follows the region, not the grid.
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "bit_mask.hpp"
+
+namespace fluid {
+
+// Cells whose centre lies within `radius` of `center` and whose bit in
+// `exclude` is clear (a null view excludes nothing).
+BitMask select_sphere(const float* x, int nx, const float* y, int ny, const float* z, int nz,
+                      const std::array<float, 3>& center, float radius,
+                      const BitMaskView& exclude);
+
+// Flat C-order indices of the `count` fluid cells (clear in `solid`) whose
+// centres are nearest to `point`, nearest first, ties in index order. Fewer
+// if the grid has fewer fluid cells.
+std::vector<int64_t> nearest_fluid_cells(const BitMaskView& solid, const float* x, const float* y,
+                                         const float* z, const std::array<float, 3>& point,
+                                         size_t count);
+
+}  // namespace fluid
@@ -0,0 +1,194 @@
+#include "slab_lbm.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace fluid {
+
+namespace {
+
+// Block header: the abort word on its own cache line.
+constexpr size_t kControl = 64;
+// Mailbox header: the sender's and the receiver's counter on separate cache
+// lines, then the payload.
+constexpr size_t kHeader = 128;
+constexpr size_t kTakenOffset = 64;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "shared memory counters need lock-free 64-bit atomics");
+
+std::atomic<uint64_t>& counter(unsigned char* box, size_t offset) {
+  return *reinterpret_cast<std::atomic<uint64_t>*>(box + offset);
+}
+
+size_t round_up(size_t v, size_t a) { return (v + a - 1) / a * a; }
+
+}  // namespace
+
+SlabBounds slab_bounds(int nx, int rank, int ranks) {
+  if (ranks < 1 || rank < 0 || rank >= ranks || nx < ranks) {
+    throw std::invalid_argument("need 0 <= rank < ranks <= nx");
+  }
+  const int base = nx / ranks, extra = nx % ranks;
+  const int x0 = rank * base + std::min(rank, extra);
+  return {x0, x0 + base + (rank < extra ? 1 : 0)};
+}
+
+size_t halo_capacity(int ny, int nz, Precision precision) {
+  const size_t plane = static_cast<size_t>(ny) * nz;
+  const size_t elem = precision == Precision::kFloat32 ? sizeof(float) : sizeof(uint16_t);
+  return std::max(LbmEngine::kHaloSlots * plane * elem, plane * sizeof(float));
+}
+
+size_t SharedMemoryHalo::region_bytes(int ranks, size_t capacity) {
+  return kControl + static_cast<size_t>(ranks) * 2 * kKinds * (kHeader + round_up(capacity, 64));
+}
+
+void SharedMemoryHalo::abort_region(void* region) {
+  counter(static_cast<unsigned char*>(region), 0).store(1, std::memory_order_release);
+}
+
+void SharedMemoryHalo::check_abort() const {
+  if (counter(region_, 0).load(std::memory_order_acquire) != 0) throw HaloAborted();
+}
+
+SharedMemoryHalo::SharedMemoryHalo(void* region, size_t bytes, int rank, int ranks,
+                                   size_t capacity)
+    : region_(static_cast<unsigned char*>(region)), rank_(rank), ranks_(ranks),
+      capacity_(capacity), stride_(kHeader + round_up(capacity, 64)) {
+  if (ranks < 1 || rank < 0 || rank >= ranks) {
+    throw std::invalid_argument("need 0 <= rank < ranks");
+  }
+  if (!region || bytes < region_bytes(ranks, capacity)) {
+    throw std::invalid_argument("shared halo region is too small");
+  }
+  if (reinterpret_cast<uintptr_t>(region) % 64 != 0) {
+    throw std::invalid_argument("shared halo region must be 64-byte aligned");
+  }
+}
+
+unsigned char* SharedMemoryHalo::mailbox(int sender, Side side, Kind kind) const {
+  return region_ + kControl + ((static_cast<size_t>(sender) * 2 + side) * kKinds + kind) * stride_;
+}
+
+void SharedMemoryHalo::post(Side to, Kind kind, const void* data, size_t bytes) {
+  if (bytes > capacity_) throw std::invalid_argument("halo message exceeds the mailbox");
+  unsigned char* box = mailbox(rank_, to, kind);
+  std::atomic<uint64_t>& posted = counter(box, 0);
+  std::atomic<uint64_t>& taken = counter(box, kTakenOffset);
+  const uint64_t n = posted.load(std::memory_order_relaxed);
+  while (taken.load(std::memory_order_acquire) != n) {
+    check_abort();
+    std::this_thread::yield();
+  }
+  std::memcpy(box + kHeader, data, bytes);
+  posted.store(n + 1, std::memory_order_release);
+}
+
+void SharedMemoryHalo::wait(Side from, Kind kind, void* data, size_t bytes) {
+  if (bytes > capacity_) throw std::invalid_argument("halo message exceeds the mailbox");
+  // The neighbour on our left sent it to its right, and vice versa.
+  const int sender = from == kLeft ? (rank_ + ranks_ - 1) % ranks_ : (rank_ + 1) % ranks_;
+  unsigned char* box = mailbox(sender, from == kLeft ? kRight : kLeft, kind);
+  std::atomic<uint64_t>& posted = counter(box, 0);
+  std::atomic<uint64_t>& taken = counter(box, kTakenOffset);
+  const uint64_t n = taken.load(std::memory_order_relaxed);
+  while (posted.load(std::memory_order_acquire) == n) {
+    check_abort();
+    std::this_thread::yield();
+  }
+  std::memcpy(data, box + kHeader, bytes);
+  taken.store(n + 1, std::memory_order_release);
+}
+
+SlabLbm::SlabLbm(LbmEngine& engine, HaloTransport& halo) : engine_(engine), halo_(halo) {
+  if (!engine.ghost_planes()) {
+    throw std::invalid_argument("SlabLbm needs an engine with ghost planes");
+  }
+  const size_t bytes = std::max(engine.halo_bytes(),
+                                static_cast<size_t>(engine.ny()) * engine.nz() * sizeof(float));
+  send_.resize(bytes);
+  recv_.resize(bytes);
+}
+
+void SlabLbm::wait(HaloTransport::Side from, HaloTransport::Kind kind, void* data,
+                   size_t bytes) {
+  const auto t0 = std::chrono::steady_clock::now();
+  halo_.wait(from, kind, data, bytes);
+  wait_seconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// The slots our right ghost (and left ghost) sent back after the neighbours'
+// odd step belong to our last (first) owned plane.
+void SlabLbm::take_returns() {
+  const int last = engine_.nx() - 2;
+  const size_t bytes = engine_.halo_bytes();
+  wait(HaloTransport::kLeft, HaloTransport::kReturn, recv_.data(), bytes);
+  engine_.unpack_returns(1, +1, recv_.data());
+  wait(HaloTransport::kRight, HaloTransport::kReturn, recv_.data(), bytes);
+  engine_.unpack_returns(last, -1, recv_.data());
+  returns_pending_ = false;
+}
+
+void SlabLbm::sync() {
+  if (returns_pending_) take_returns();
+}
+
+void SlabLbm::run(int steps, float inlet_speed, bool update_fill, bool measure_residual) {
+  using T = HaloTransport;
+  LbmEngine& e = engine_;
+  const int last = e.nx() - 2;  // owned planes are 1..last
+  const size_t plane = static_cast<size_t>(e.ny()) * e.nz();
+  const size_t fill_bytes = plane * sizeof(float);
+  const size_t slot_bytes = e.halo_bytes();
+
+  for (int s = 0; s < steps; ++s) {
+    const bool measure = measure_residual && s == steps - 1;
+    const bool odd = e.odd_next();
+
+    // Edge planes out first, so the neighbours have them by the time they
+    // are done with their own interior.
+    if (update_fill) {
+      halo_.post(T::kLeft, T::kFill, e.fill_data() + plane, fill_bytes);
+      halo_.post(T::kRight, T::kFill, e.fill_data() + last * plane, fill_bytes);
+    }
+    if (odd) {
+      e.pack_halo(1, +1, send_.data());
+      halo_.post(T::kLeft, T::kSlots, send_.data(), slot_bytes);
+      e.pack_halo(last, -1, send_.data());
+      halo_.post(T::kRight, T::kSlots, send_.data(), slot_bytes);
+    }
+
+    if (last > 2) e.sweep_planes(2, last, inlet_speed, update_fill, measure);
+
+    if (update_fill) {
+      wait(T::kLeft, T::kFill, e.fill_data(), fill_bytes);
+      wait(T::kRight, T::kFill, e.fill_data() + (last + 1) * plane, fill_bytes);
+    }
+    if (odd) {
+      wait(T::kLeft, T::kSlots, recv_.data(), slot_bytes);
+      e.unpack_halo(0, -1, recv_.data());
+      wait(T::kRight, T::kSlots, recv_.data(), slot_bytes);
+      e.unpack_halo(last + 1, +1, recv_.data());
+    }
+    if (returns_pending_) take_returns();
+
+    e.sweep_planes(1, 2, inlet_speed, update_fill, measure);
+    if (last > 1) e.sweep_planes(last, last + 1, inlet_speed, update_fill, measure);
+
+    if (odd) {
+      e.pack_halo(0, -1, send_.data());
+      halo_.post(T::kLeft, T::kReturn, send_.data(), slot_bytes);
+      e.pack_halo(last + 1, +1, send_.data());
+      halo_.post(T::kRight, T::kReturn, send_.data(), slot_bytes);
+      returns_pending_ = true;
+    }
+    e.finish_step(update_fill, measure);
+  }
+}
+
+}  // namespace fluid
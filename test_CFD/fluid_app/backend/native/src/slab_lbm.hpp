@@ -0,0 +1,131 @@
+// Slab domain decomposition of the dense lattice across processes.
+//
+// Rank r of R owns the x planes [x0, x1) of the global grid (slab_bounds())
+// and keeps them in its own dense LbmEngine, with one ghost plane on each
+// side (engine planes 0 and x1 - x0 + 1, the periodic neighbours' edge
+// planes). An even AA step is local to each cell. An odd step of an edge
+// plane reads and writes kHaloSlots population slots of the ghost plane
+// next to it, locations no other cell touches in that step. So per odd step
+// each rank
+//   1. sends its edge planes' outward slots to the neighbours' ghost planes,
+//   2. sweeps its interior planes while they travel,
+//   3. receives the neighbours' slots into its ghosts and sweeps its edges,
+//   4. sends the ghosts' slots back, where the owner reads them in its next
+//      (even) step, after sweeping its interior again.
+// The fill level's upwind update needs the neighbours' edge planes of fill
+// every step, exchanged the same way. Every cell sees exactly the values it
+// would in one engine, so R ranks give bitwise the same result as one.
+//
+// Messages go through a HaloTransport. SharedMemoryHalo connects the ranks of
+// one machine through a shared memory block. A transport for ranks on
+// several machines maps post()/wait() onto MPI_Isend/MPI_Irecv + MPI_Wait
+// with the kind as tag; nothing else changes.
+//
+// A rank that fails, or the process driving the ranks, aborts the transport:
+// every rank's pending and later post()/wait() then throws HaloAborted
+// instead of waiting for a neighbour that will never answer.
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "lbm_engine.hpp"
+
+namespace fluid {
+
+// Planes [x0, x1) of rank `rank` out of `ranks` in an nx-plane grid; the
+// first nx % ranks ranks own one plane more.
+struct SlabBounds {
+  int x0, x1;
+};
+SlabBounds slab_bounds(int nx, int rank, int ranks);
+
+class HaloAborted : public std::runtime_error {
+ public:
+  HaloAborted() : std::runtime_error("halo exchange aborted") {}
+};
+
+class HaloTransport {
+ public:
+  enum Side { kLeft = 0, kRight = 1 };  // towards lower / higher x (periodic)
+  enum Kind { kFill = 0, kSlots = 1, kReturn = 2 };
+  static constexpr int kKinds = 3;
+
+  virtual ~HaloTransport() = default;
+  // Hands a message to the neighbour on side `to` and returns without waiting
+  // for it to be received (unless that neighbour has not yet taken the
+  // previous message of the same kind).
+  virtual void post(Side to, Kind kind, const void* data, size_t bytes) = 0;
+  // Blocks until the next message of `kind` from the neighbour on side
+  // `from` is there and copies it out. Messages of one kind arrive in order.
+  virtual void wait(Side from, Kind kind, void* data, size_t bytes) = 0;
+  // Makes post() and wait() throw HaloAborted on every rank. Irreversible.
+  virtual void abort() = 0;
+};
+
+// Transport through a zero-initialized block shared by all ranks of one
+// machine (a multiprocessing.shared_memory segment on the Python side). It
+// starts with one cache line holding the abort word, then each (sender,
+// side, kind) has a one-message mailbox with posted/taken counters, each
+// written by one process only.
+class SharedMemoryHalo : public HaloTransport {
+ public:
+  // Bytes of the shared block for `ranks` ranks and messages of up to
+  // `capacity` bytes.
+  static size_t region_bytes(int ranks, size_t capacity);
+  // Sets the abort word of a shared block, for a process that maps it
+  // without being a rank.
+  static void abort_region(void* region);
+
+  SharedMemoryHalo(void* region, size_t bytes, int rank, int ranks, size_t capacity);
+
+  void post(Side to, Kind kind, const void* data, size_t bytes) override;
+  void wait(Side from, Kind kind, void* data, size_t bytes) override;
+  void abort() override { abort_region(region_); }
+
+ private:
+  unsigned char* mailbox(int sender, Side side, Kind kind) const;
+  void check_abort() const;
+
+  unsigned char* region_;
+  int rank_, ranks_;
+  size_t capacity_, stride_;
+};
+
+// Largest halo message of a slab engine with (ny, nz) planes: the population
+// slots or one plane of fill.
+size_t halo_capacity(int ny, int nz, Precision precision);
+
+// Steps an engine with ghost planes (LbmEngine::set_ghost_planes) as one rank
+// of a decomposition, exchanging halos through `halo` (see above). Both must
+// outlive it.
+class SlabLbm {
+ public:
+  SlabLbm(LbmEngine& engine, HaloTransport& halo);
+
+  // Same contract as LbmEngine::run(); every rank must make the same calls.
+  // The residual stays rank-local: reduce engine().residual_sums().
+  void run(int steps, float inlet_speed, bool update_fill, bool measure_residual);
+  // Takes in the slots still travelling back after an odd step, so that the
+  // populations are complete (before a checkpoint). Collective, like run().
+  void sync();
+
+  LbmEngine& engine() { return engine_; }
+  // Seconds spent blocked in halo waits since construction.
+  double wait_seconds() const { return wait_seconds_; }
+
+ private:
+  void wait(HaloTransport::Side from, HaloTransport::Kind kind, void* data, size_t bytes);
+  void take_returns();
+
+  LbmEngine& engine_;
+  HaloTransport& halo_;
+  std::vector<unsigned char> send_, recv_;
+  bool returns_pending_ = false;
+  double wait_seconds_ = 0.0;
+};
+
+}  // namespace fluid
@@ -0,0 +1,655 @@
+#include "stl_mesh.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "triangle_raster.hpp"
+
+namespace fluid {
+
+namespace {
+
+constexpr int kLeafSize = 4;   // always a leaf at or below this many triangles
+constexpr int kMaxLeaf = 16;   // SAH may keep up to this many in a leaf
+constexpr int kSahBins = 16;
+// Below this depth splits are forced to the median, which bounds the tree
+// depth (and so the fixed traversal stacks) for any input.
+constexpr int kMaxSahDepth = 64;
+constexpr int kStackSize = 128;
+
+double elapsed_ms(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// Read-only view of a whole file.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& path) {
+#ifdef _WIN32
+    const int wlen = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+    std::wstring wpath(wlen > 0 ? wlen - 1 : 0, L'\0');
+    if (wlen > 1) MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wpath[0], wlen);
+    file_ = CreateFileW(wpath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                        FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) throw std::runtime_error("cannot open " + path);
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size)) {
+      CloseHandle(file_);
+      throw std::runtime_error("cannot stat " + path);
+    }
+    size_ = static_cast<size_t>(size.QuadPart);
+    if (size_ == 0) return;
+    mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_) throw std::runtime_error("cannot map " + path);
+    data_ = static_cast<const unsigned char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+#else
+    fd_ = open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) throw std::runtime_error("cannot open " + path);
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+      close(fd_);  // the destructor does not run for a throwing constructor
+      throw std::runtime_error("cannot stat " + path);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ == 0) return;
+    void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (p == MAP_FAILED) throw std::runtime_error("cannot map " + path);
+    madvise(p, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const unsigned char*>(p);
+#endif
+    if (!data_) throw std::runtime_error("cannot map " + path);
+  }
+
+  ~MappedFile() {
+#ifdef _WIN32
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(mapping_);
+    if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+#else
+    if (data_) munmap(const_cast<unsigned char*>(data_), size_);
+    if (fd_ >= 0) close(fd_);
+#endif
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const unsigned char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const unsigned char* data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  HANDLE file_ = INVALID_HANDLE_VALUE;
+  HANDLE mapping_ = nullptr;
+#else
+  int fd_ = -1;
+#endif
+};
+
+// 84-byte header + 50 bytes per triangle (normal, 3 vertices, attribute).
+bool is_binary_stl(const unsigned char* data, size_t size, size_t& triangles) {
+  if (size < 84) return false;
+  uint32_t n;
+  std::memcpy(&n, data + 80, sizeof(n));
+  const size_t expected = 84 + 50 * static_cast<size_t>(n);
+  triangles = n;
+  // Some exporters append a few bytes; anything short of another record is fine.
+  return size >= expected && size - expected < 50;
+}
+
+void parse_binary(const unsigned char* data, size_t triangles, std::vector<float>& raw) {
+  raw.resize(9 * triangles);
+  for (size_t t = 0; t < triangles; ++t) {
+    std::memcpy(&raw[9 * t], data + 84 + 50 * t + 12, 9 * sizeof(float));
+  }
+}
+
+void parse_ascii(const unsigned char* data, size_t size, std::vector<float>& raw) {
+  const std::string text(reinterpret_cast<const char*>(data), size);
+  const char* p = text.c_str();
+  while ((p = std::strstr(p, "vertex")) != nullptr) {
+    p += 6;
+    for (int k = 0; k < 3; ++k) {
+      char* end;
+      raw.push_back(std::strtof(p, &end));
+      if (end == p) throw std::runtime_error("malformed ASCII STL vertex");
+      p = end;
+    }
+  }
+  if (raw.size() % 9 != 0) throw std::runtime_error("ASCII STL vertex count is not a multiple of 3");
+}
+
+struct CellKey {
+  int64_t x, y, z;
+  bool operator==(const CellKey& o) const { return x == o.x && y == o.y && z == o.z; }
+};
+
+// Open-addressing map from hash-grid cell to the newest vertex in it (the
+// rest of the cell is chained through `next` in weld()). Linear probing on a
+// power-of-two table kept at most half full.
+class CellTable {
+ public:
+  explicit CellTable(size_t expected) {
+    size_t capacity = 1024;
+    while (capacity < 2 * expected) capacity *= 2;
+    keys_.resize(capacity);
+    heads_.assign(capacity, kEmpty);
+  }
+
+  int32_t head(const CellKey& key) const {
+    for (size_t i = hash(key) & mask();; i = (i + 1) & mask()) {
+      if (heads_[i] == kEmpty) return -1;
+      if (keys_[i] == key) return heads_[i];
+    }
+  }
+
+  void set_head(const CellKey& key, int32_t vertex) {
+    if (2 * (size_ + 1) > keys_.size()) grow();
+    size_t i = hash(key) & mask();
+    while (heads_[i] != kEmpty && !(keys_[i] == key)) i = (i + 1) & mask();
+    if (heads_[i] == kEmpty) {
+      keys_[i] = key;
+      ++size_;
+    }
+    heads_[i] = vertex;
+  }
+
+ private:
+  static constexpr int32_t kEmpty = std::numeric_limits<int32_t>::min();
+
+  static size_t hash(const CellKey& k) {
+    uint64_t h = static_cast<uint64_t>(k.x) * 0x9e3779b97f4a7c15ULL;
+    h = (h ^ static_cast<uint64_t>(k.y)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ static_cast<uint64_t>(k.z)) * 0x94d049bb133111ebULL;
+    return static_cast<size_t>(h ^ (h >> 32));
+  }
+  size_t mask() const { return keys_.size() - 1; }
+
+  void grow() {
+    std::vector<CellKey> keys;
+    std::vector<int32_t> heads;
+    keys.swap(keys_);
+    heads.swap(heads_);
+    keys_.resize(2 * keys.size());
+    heads_.assign(2 * heads.size(), kEmpty);
+    for (size_t j = 0; j < keys.size(); ++j) {
+      if (heads[j] == kEmpty) continue;
+      size_t i = hash(keys[j]) & mask();
+      while (heads_[i] != kEmpty) i = (i + 1) & mask();
+      keys_[i] = keys[j];
+      heads_[i] = heads[j];
+    }
+  }
+
+  std::vector<CellKey> keys_;
+  std::vector<int32_t> heads_;
+  size_t size_ = 0;
+};
+
+// Weld the raw triangle soup (9 floats per triangle) into an indexed mesh.
+// Exact mode keys the hash grid by the coordinates' bits, so only identical
+// positions merge; with a tolerance the cell size is the tolerance and the
+// 27 surrounding cells are searched.
+size_t weld(const std::vector<float>& raw, float tolerance, std::vector<float>& vertices,
+            std::vector<int32_t>& triangles) {
+  const size_t n_raw = raw.size() / 3;
+  const bool exact = !(tolerance > 0.0f);
+  const double inv_h = exact ? 0.0 : 1.0 / tolerance;
+  const double tol2 = static_cast<double>(tolerance) * tolerance;
+
+  // A closed mesh has about half as many vertices as triangles.
+  CellTable cells(n_raw / 6);
+  std::vector<int32_t> next;
+  next.reserve(n_raw / 4 + 16);
+  vertices.clear();
+  vertices.reserve(n_raw);
+
+  auto cell_of = [&](const float* v) {
+    if (exact) {
+      uint32_t b[3];
+      for (int k = 0; k < 3; ++k) {
+        const float f = v[k] + 0.0f;  // -0 -> +0
+        std::memcpy(&b[k], &f, sizeof(f));
+      }
+      return CellKey{b[0], b[1], b[2]};
+    }
+    return CellKey{static_cast<int64_t>(std::floor(v[0] * inv_h)),
+                   static_cast<int64_t>(std::floor(v[1] * inv_h)),
+                   static_cast<int64_t>(std::floor(v[2] * inv_h))};
+  };
+
+  auto find = [&](const CellKey& key, const float* v) -> int32_t {
+    for (int32_t i = cells.head(key); i >= 0; i = next[i]) {
+      const float* u = &vertices[3 * static_cast<size_t>(i)];
+      if (exact) {
+        if (u[0] == v[0] && u[1] == v[1] && u[2] == v[2]) return i;
+      } else {
+        const double dx = u[0] - v[0], dy = u[1] - v[1], dz = u[2] - v[2];
+        if (dx * dx + dy * dy + dz * dz <= tol2) return i;
+      }
+    }
+    return -1;
+  };
+
+  std::vector<int32_t> index(n_raw);
+  for (size_t r = 0; r < n_raw; ++r) {
+    const float* v = &raw[3 * r];
+    const CellKey key = cell_of(v);
+    int32_t found = -1;
+    if (exact) {
+      found = find(key, v);
+    } else {
+      for (int dx = -1; dx <= 1 && found < 0; ++dx) {
+        for (int dy = -1; dy <= 1 && found < 0; ++dy) {
+          for (int dz = -1; dz <= 1 && found < 0; ++dz) {
+            found = find({key.x + dx, key.y + dy, key.z + dz}, v);
+          }
+        }
+      }
+    }
+    if (found < 0) {
+      found = static_cast<int32_t>(vertices.size() / 3);
+      vertices.insert(vertices.end(), v, v + 3);
+      next.push_back(cells.head(key));
+      cells.set_head(key, found);
+    }
+    index[r] = found;
+  }
+
+  size_t dropped = 0;
+  triangles.clear();
+  triangles.reserve(n_raw);
+  for (size_t t = 0; t < n_raw / 3; ++t) {
+    const int32_t a = index[3 * t], b = index[3 * t + 1], c = index[3 * t + 2];
+    if (a == b || b == c || a == c) {
+      ++dropped;
+      continue;
+    }
+    triangles.push_back(a);
+    triangles.push_back(b);
+    triangles.push_back(c);
+  }
+  return dropped;
+}
+
+inline float half_area(const float lo[3], const float hi[3]) {
+  const float dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+  return dx * dy + dy * dz + dz * dx;
+}
+
+inline void grow(float lo[3], float hi[3], const float* plo, const float* phi) {
+  for (int k = 0; k < 3; ++k) {
+    lo[k] = std::min(lo[k], plo[k]);
+    hi[k] = std::max(hi[k], phi[k]);
+  }
+}
+
+inline void reset(float lo[3], float hi[3]) {
+  for (int k = 0; k < 3; ++k) {
+    lo[k] = std::numeric_limits<float>::max();
+    hi[k] = -std::numeric_limits<float>::max();
+  }
+}
+
+struct Vec3 {
+  double x, y, z;
+};
+inline Vec3 operator-(const Vec3& a, const Vec3& b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+inline Vec3 operator+(const Vec3& a, const Vec3& b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+inline Vec3 operator*(double s, const Vec3& a) { return {s * a.x, s * a.y, s * a.z}; }
+inline double dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+// Closest point on triangle abc to p (Ericson, Real-Time Collision Detection 5.1.5).
+Vec3 closest_on_triangle(const Vec3& p, const Vec3& a, const Vec3& b, const Vec3& c) {
+  const Vec3 ab = b - a, ac = c - a, ap = p - a;
+  const double d1 = dot(ab, ap), d2 = dot(ac, ap);
+  if (d1 <= 0.0 && d2 <= 0.0) return a;
+  const Vec3 bp = p - b;
+  const double d3 = dot(ab, bp), d4 = dot(ac, bp);
+  if (d3 >= 0.0 && d4 <= d3) return b;
+  const double vc = d1 * d4 - d3 * d2;
+  if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0) return a + (d1 / (d1 - d3)) * ab;
+  const Vec3 cp = p - c;
+  const double d5 = dot(ab, cp), d6 = dot(ac, cp);
+  if (d6 >= 0.0 && d5 <= d6) return c;
+  const double vb = d5 * d2 - d1 * d6;
+  if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0) return a + (d2 / (d2 - d6)) * ac;
+  const double va = d3 * d6 - d5 * d4;
+  if (va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0) {
+    return b + ((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b);
+  }
+  const double denom = 1.0 / (va + vb + vc);
+  return a + (vb * denom) * ab + (vc * denom) * ac;
+}
+
+inline double box_distance2(const BvhNode& n, const float p[3]) {
+  double d2 = 0.0;
+  for (int k = 0; k < 3; ++k) {
+    const double d = p[k] < n.lo[k] ? n.lo[k] - p[k] : (p[k] > n.hi[k] ? p[k] - n.hi[k] : 0.0);
+    d2 += d * d;
+  }
+  return d2;
+}
+
+}  // namespace
+
+TriMesh TriMesh::load_stl(const std::string& path, float weld_tolerance) {
+  auto t0 = std::chrono::steady_clock::now();
+  std::vector<float> raw;
+  MeshLoadStats stats;
+  {
+    MappedFile file(path);
+    stats.file_bytes = file.size();
+    size_t n = 0;
+    if (is_binary_stl(file.data(), file.size(), n)) {
+      parse_binary(file.data(), n, raw);
+    } else if (file.size() >= 5 && std::memcmp(file.data(), "solid", 5) == 0) {
+      stats.binary = false;
+      parse_ascii(file.data(), file.size(), raw);
+    } else {
+      throw std::runtime_error("not an STL file: " + path);
+    }
+  }
+  stats.raw_triangles = raw.size() / 9;
+  stats.read_ms = elapsed_ms(t0);
+
+  t0 = std::chrono::steady_clock::now();
+  std::vector<float> vertices;
+  std::vector<int32_t> triangles;
+  stats.dropped_triangles = weld(raw, weld_tolerance, vertices, triangles);
+  stats.weld_ms = elapsed_ms(t0);
+  raw.clear();
+  raw.shrink_to_fit();
+
+  TriMesh mesh(std::move(vertices), std::move(triangles));
+  stats.bvh_ms = mesh.stats_.bvh_ms;
+  mesh.stats_ = stats;
+  return mesh;
+}
+
+TriMesh::TriMesh(std::vector<float> vertices, std::vector<int32_t> triangles)
+    : vertices_(std::move(vertices)), triangles_(std::move(triangles)) {
+  if (vertices_.size() % 3 != 0 || triangles_.size() % 3 != 0) {
+    throw std::invalid_argument("vertices and triangles must come in triples");
+  }
+  const size_t nv = num_vertices();
+  for (int32_t i : triangles_) {
+    if (i < 0 || static_cast<size_t>(i) >= nv) {
+      throw std::invalid_argument("triangle vertex index out of range");
+    }
+  }
+  if (nv > 0) {
+    reset(lo_, hi_);
+    for (size_t v = 0; v < nv; ++v) grow(lo_, hi_, &vertices_[3 * v], &vertices_[3 * v]);
+  }
+
+  const auto t0 = std::chrono::steady_clock::now();
+  build_bvh();
+  stats_.raw_triangles = num_triangles();
+  stats_.bvh_ms = elapsed_ms(t0);
+}
+
+size_t TriMesh::memory_bytes() const {
+  return vertices_.size() * sizeof(float) + triangles_.size() * sizeof(int32_t) +
+         nodes_.size() * sizeof(BvhNode) + tri_order_.size() * sizeof(int32_t);
+}
+
+// Binned SAH build (Wald 2007): per node, bin triangle centroids into
+// kSahBins slabs along each axis and split where the surface area heuristic
+// is lowest; fall back to a median split if all centroids land in one bin.
+void TriMesh::build_bvh() {
+  const int32_t nt = static_cast<int32_t>(num_triangles());
+  // Triangle boxes are partitioned in place (contiguous, not through an
+  // index), then their ids become tri_order_.
+  struct Prim {
+    float lo[3], hi[3], cen[3];
+    int32_t id;
+  };
+  std::vector<Prim> prims(nt);
+  for (int32_t t = 0; t < nt; ++t) {
+    Prim& pr = prims[t];
+    pr.id = t;
+    reset(pr.lo, pr.hi);
+    for (int c = 0; c < 3; ++c) {
+      const float* v = &vertices_[3 * static_cast<size_t>(triangles_[3 * t + c])];
+      grow(pr.lo, pr.hi, v, v);
+    }
+    for (int k = 0; k < 3; ++k) pr.cen[k] = 0.5f * (pr.lo[k] + pr.hi[k]);
+  }
+
+  nodes_.clear();
+  nodes_.reserve(2 * static_cast<size_t>(std::max(nt, 1)));
+  nodes_.push_back(BvhNode{});
+  struct Task {
+    int32_t node, begin, end, depth;
+  };
+  std::vector<Task> stack = {{0, 0, nt, 0}};
+  while (!stack.empty()) {
+    const Task task = stack.back();
+    stack.pop_back();
+    BvhNode node{};
+    float clo[3], chi[3];
+    reset(node.lo, node.hi);
+    reset(clo, chi);
+    for (int32_t i = task.begin; i < task.end; ++i) {
+      const Prim& pr = prims[i];
+      grow(node.lo, node.hi, pr.lo, pr.hi);
+      grow(clo, chi, pr.cen, pr.cen);
+    }
+    const int32_t count = task.end - task.begin;
+    node.start = task.begin;
+    node.count = count;
+
+    int best_axis = -1, best_bin = 0;
+    float best_cost = std::numeric_limits<float>::max();
+    if (count > kLeafSize && task.depth < kMaxSahDepth) {
+      // One pass over the triangles bins all three axes.
+      float scale[3];
+      for (int a = 0; a < 3; ++a) {
+        const float extent = chi[a] - clo[a];
+        scale[a] = extent > 0.0f ? kSahBins / extent : 0.0f;
+      }
+      int bin_count[3][kSahBins] = {};
+      float blo[3][kSahBins][3], bhi[3][kSahBins][3];
+      for (int a = 0; a < 3; ++a) {
+        for (int b = 0; b < kSahBins; ++b) reset(blo[a][b], bhi[a][b]);
+      }
+      for (int32_t i = task.begin; i < task.end; ++i) {
+        const Prim& pr = prims[i];
+        for (int a = 0; a < 3; ++a) {
+          const int b = std::min(static_cast<int>((pr.cen[a] - clo[a]) * scale[a]), kSahBins - 1);
+          ++bin_count[a][b];
+          grow(blo[a][b], bhi[a][b], pr.lo, pr.hi);
+        }
+      }
+      for (int a = 0; a < 3; ++a) {
+        if (scale[a] == 0.0f) continue;
+        // Right-to-left sweep for the right-hand areas, then left-to-right for the costs.
+        float right_area[kSahBins];
+        int right_count[kSahBins];
+        float rlo[3], rhi[3];
+        reset(rlo, rhi);
+        int rn = 0;
+        for (int b = kSahBins - 1; b > 0; --b) {
+          rn += bin_count[a][b];
+          if (bin_count[a][b]) grow(rlo, rhi, blo[a][b], bhi[a][b]);
+          right_area[b] = rn ? half_area(rlo, rhi) : 0.0f;
+          right_count[b] = rn;
+        }
+        float llo[3], lhi[3];
+        reset(llo, lhi);
+        int ln = 0;
+        for (int b = 0; b < kSahBins - 1; ++b) {
+          ln += bin_count[a][b];
+          if (bin_count[a][b]) grow(llo, lhi, blo[a][b], bhi[a][b]);
+          if (ln == 0 || right_count[b + 1] == 0) continue;
+          const float cost = ln * half_area(llo, lhi) + right_count[b + 1] * right_area[b + 1];
+          if (cost < best_cost) {
+            best_cost = cost;
+            best_axis = a;
+            best_bin = b;
+          }
+        }
+      }
+    }
+
+    const float area = half_area(node.lo, node.hi);
+    // SAH with unit intersection and traversal costs: split if 1 + cost/area < count.
+    bool leaf = count <= kLeafSize;
+    if (!leaf && task.depth < kMaxSahDepth) {
+      leaf = best_axis < 0 ||
+             (count <= kMaxLeaf && area > 0.0f && 1.0f + best_cost / area >= count);
+    }
+    if (leaf) {
+      nodes_[task.node] = node;
+      continue;
+    }
+
+    Prim* first = prims.data() + task.begin;
+    Prim* last = prims.data() + task.end;
+    Prim* mid = first;
+    if (best_axis >= 0) {
+      const float scale = kSahBins / (chi[best_axis] - clo[best_axis]);
+      mid = std::partition(first, last, [&](const Prim& pr) {
+        const int b = std::min(static_cast<int>((pr.cen[best_axis] - clo[best_axis]) * scale),
+                               kSahBins - 1);
+        return b <= best_bin;
+      });
+    } else {
+      best_axis = 0;
+      for (int a = 1; a < 3; ++a) {
+        if (chi[a] - clo[a] > chi[best_axis] - clo[best_axis]) best_axis = a;
+      }
+    }
+    if (mid == first || mid == last) {
+      mid = first + count / 2;
+      std::nth_element(first, mid, last, [&](const Prim& l, const Prim& r) {
+        return l.cen[best_axis] < r.cen[best_axis];
+      });
+    }
+    const int32_t split = static_cast<int32_t>(mid - prims.data());
+    const int32_t left = static_cast<int32_t>(nodes_.size());
+    nodes_.push_back(BvhNode{});
+    nodes_.push_back(BvhNode{});
+    node.start = left;
+    node.count = 0;
+    nodes_[task.node] = node;
+    stack.push_back({left, task.begin, split, task.depth + 1});
+    stack.push_back({left + 1, split, task.end, task.depth + 1});
+  }
+
+  tri_order_.resize(nt);
+  for (int32_t i = 0; i < nt; ++i) tri_order_[i] = prims[i].id;
+}
+
+void TriMesh::line_crossings(const float p[3], int a, int& total, int& below) const {
+  const int ua = a == 0 ? 1 : 0;
+  const int va = a == 2 ? 1 : 2;
+  const Vec2 q = {p[ua], p[va]};
+  total = 0;
+  below = 0;
+  if (tri_order_.empty()) return;
+  int32_t stack[kStackSize];
+  int sp = 0;
+  stack[sp++] = 0;
+  while (sp > 0) {
+    const BvhNode& n = nodes_[stack[--sp]];
+    if (p[ua] < n.lo[ua] || p[ua] > n.hi[ua] || p[va] < n.lo[va] || p[va] > n.hi[va]) continue;
+    if (n.count == 0) {
+      stack[sp++] = n.start;
+      stack[sp++] = n.start + 1;
+      continue;
+    }
+    for (int32_t i = n.start; i < n.start + n.count; ++i) {
+      const int32_t* tri = &triangles_[3 * static_cast<size_t>(tri_order_[i])];
+      const ProjectedTriangle pt(&vertices_[3 * static_cast<size_t>(tri[0])],
+                                 &vertices_[3 * static_cast<size_t>(tri[1])],
+                                 &vertices_[3 * static_cast<size_t>(tri[2])], a);
+      double w;
+      if (pt.valid && pt.hit(q, w)) {
+        ++total;
+        if (w < p[a]) ++below;
+      }
+    }
+  }
+}
+
+bool TriMesh::inside(const float p[3]) const {
+  int valid = 0, inside = 0;
+  for (int a = 0; a < 3; ++a) {
+    int total, below;
+    line_crossings(p, a, total, below);
+    if (total % 2 != 0) continue;
+    ++valid;
+    inside += below & 1;
+  }
+  return 2 * inside > valid;
+}
+
+double TriMesh::closest_point(const float p[3], float out[3], int32_t* tri) const {
+  double best = std::numeric_limits<double>::infinity();
+  int32_t best_tri = -1;
+  Vec3 best_pt = {p[0], p[1], p[2]};
+  if (!tri_order_.empty()) {
+    const Vec3 q = {p[0], p[1], p[2]};
+    int32_t stack[kStackSize];
+    int sp = 0;
+    stack[sp++] = 0;
+    while (sp > 0) {
+      const BvhNode& n = nodes_[stack[--sp]];
+      if (box_distance2(n, p) >= best) continue;
+      if (n.count == 0) {
+        // Visit the nearer child first (pushed last).
+        const double dl = box_distance2(nodes_[n.start], p);
+        const double dr = box_distance2(nodes_[n.start + 1], p);
+        stack[sp++] = dl < dr ? n.start + 1 : n.start;
+        stack[sp++] = dl < dr ? n.start : n.start + 1;
+        continue;
+      }
+      for (int32_t i = n.start; i < n.start + n.count; ++i) {
+        const int32_t t = tri_order_[i];
+        const float* v0 = &vertices_[3 * static_cast<size_t>(triangles_[3 * t])];
+        const float* v1 = &vertices_[3 * static_cast<size_t>(triangles_[3 * t + 1])];
+        const float* v2 = &vertices_[3 * static_cast<size_t>(triangles_[3 * t + 2])];
+        const Vec3 c = closest_on_triangle(q, {v0[0], v0[1], v0[2]}, {v1[0], v1[1], v1[2]},
+                                           {v2[0], v2[1], v2[2]});
+        const Vec3 d = c - q;
+        const double d2 = dot(d, d);
+        if (d2 < best) {
+          best = d2;
+          best_tri = t;
+          best_pt = c;
+        }
+      }
+    }
+  }
+  out[0] = static_cast<float>(best_pt.x);
+  out[1] = static_cast<float>(best_pt.y);
+  out[2] = static_cast<float>(best_pt.z);
+  if (tri) *tri = best_tri;
+  return std::sqrt(best);
+}
+
+}  // namespace fluid
@@ -0,0 +1,78 @@
+// Axis-aligned line / triangle crossings with watertight edge ownership.
+//
+// A triangle is projected onto the plane perpendicular to axis `a`; a line
+// along `a` through (u, v) crosses it if (u, v) is inside the projection.
+// Edge functions are evaluated with the endpoints in lexicographic order, so
+// two triangles sharing an edge get bitwise opposite values, and points
+// exactly on an edge or vertex are owned by one triangle only (top-left
+// rule). A line through a closed surface therefore crosses it an even
+// number of times, even where it grazes edges and vertices.
+//
+// Shared by the grid voxelizer and the mesh's point-in-mesh queries.
+#pragma once
+
+#include <utility>
+
+namespace fluid {
+
+struct Vec2 {
+  double u, v;
+};
+
+// Twice the signed area of (p, q, r); > 0 when r is left of p -> q.
+inline double cross2(const Vec2& p, const Vec2& q, const Vec2& r) {
+  return (q.u - p.u) * (r.v - p.v) - (q.v - p.v) * (r.u - p.u);
+}
+
+// Edge function of p against edge p0 -> p1 in canonical endpoint order.
+inline double edge_function(const Vec2& p0, const Vec2& p1, const Vec2& p) {
+  const bool swap = p1.u < p0.u || (p1.u == p0.u && p1.v < p0.v);
+  return swap ? -cross2(p1, p0, p) : cross2(p0, p1, p);
+}
+
+// Top-left rule: a point on an edge belongs to the triangle for which the
+// (counter-clockwise) edge direction points up, or exactly left.
+inline bool owns_edge(double e, const Vec2& p0, const Vec2& p1) {
+  if (e != 0.0) return e > 0.0;
+  const double du = p1.u - p0.u;
+  const double dv = p1.v - p0.v;
+  return dv > 0.0 || (dv == 0.0 && du < 0.0);
+}
+
+// Triangle projected along axis a (u, v = the other two axes in order).
+struct ProjectedTriangle {
+  Vec2 p[3];
+  double w[3];
+  bool valid;  // false when the triangle is parallel to the lines
+
+  ProjectedTriangle(const float* v0, const float* v1, const float* v2, int a) {
+    const int ua = a == 0 ? 1 : 0;
+    const int va = a == 2 ? 1 : 2;
+    const float* v[3] = {v0, v1, v2};
+    for (int k = 0; k < 3; ++k) {
+      p[k] = {v[k][ua], v[k][va]};
+      w[k] = v[k][a];
+    }
+    const double area = cross2(p[0], p[1], p[2]);
+    valid = area != 0.0;
+    if (area < 0.0) {
+      std::swap(p[1], p[2]);
+      std::swap(w[1], w[2]);
+    }
+  }
+
+  // Does the line through q cross the triangle? If so, `w_hit` is where.
+  bool hit(const Vec2& q, double& w_hit) const {
+    const double e0 = edge_function(p[1], p[2], q);
+    const double e1 = edge_function(p[2], p[0], q);
+    const double e2 = edge_function(p[0], p[1], q);
+    if (!owns_edge(e0, p[1], p[2]) || !owns_edge(e1, p[2], p[0]) || !owns_edge(e2, p[0], p[1])) {
+      return false;
+    }
+    const double sum = e0 + e1 + e2;
+    w_hit = sum != 0.0 ? (e0 * w[0] + e1 * w[1] + e2 * w[2]) / sum : w[0];
+    return true;
+  }
+};
+
+}  // namespace fluid
@@ -0,0 +1,144 @@
+#include "voxelize.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "triangle_raster.hpp"
+
+namespace fluid {
+
+namespace {
+
+// First and one-past-last index of the sorted coordinates within [lo, hi].
+inline void index_range(const float* c, int n, double lo, double hi, int& first, int& last) {
+  first = static_cast<int>(std::lower_bound(c, c + n, lo, [](float a, double b) { return a < b; }) - c);
+  last = static_cast<int>(std::upper_bound(c, c + n, hi, [](double a, float b) { return a < b; }) - c);
+}
+
+}  // namespace
+
+BitMask voxelize_inside(const float* vertices, size_t nv, const int32_t* triangles, size_t nt,
+                        const float* x, int nx, const float* y, int ny, const float* z, int nz,
+                        VoxelizeStats* stats) {
+  if (nx < 1 || ny < 1 || nz < 1) {
+    throw std::invalid_argument("grid dimensions must be positive");
+  }
+  for (size_t t = 0; t < 3 * nt; ++t) {
+    if (triangles[t] < 0 || static_cast<size_t>(triangles[t]) >= nv) {
+      throw std::invalid_argument("triangle vertex index out of range");
+    }
+  }
+
+  const float* coords[3] = {x, y, z};
+  const int dims[3] = {nx, ny, nz};
+  const long long strides[3] = {static_cast<long long>(ny) * nz, nz, 1};
+  const size_t n = static_cast<size_t>(nx) * ny * nz;
+
+  // Per cell: bit a = inside along axis a, bit 3 + a = axis a had a valid
+  // (even) column through the cell.
+  std::vector<uint8_t> votes(n, 0);
+  long long crossings = 0;
+  long long odd_columns = 0;
+
+  for (int a = 0; a < 3; ++a) {
+    const int ua = a == 0 ? 1 : 0;  // rows
+    const int va = a == 2 ? 1 : 2;  // columns within a row
+    const int rows = dims[ua];
+    const int cols = dims[va];
+
+    // Bin triangles by the rows they cover (CSR: row_start / row_tris).
+    std::vector<int> first(nt), last(nt);
+    std::vector<long long> row_start(rows + 1, 0);
+    for (size_t t = 0; t < nt; ++t) {
+      double lo = vertices[3 * triangles[3 * t] + ua];
+      double hi = lo;
+      for (int c = 1; c < 3; ++c) {
+        const double u = vertices[3 * triangles[3 * t + c] + ua];
+        lo = std::min(lo, u);
+        hi = std::max(hi, u);
+      }
+      index_range(coords[ua], rows, lo, hi, first[t], last[t]);
+      for (int r = first[t]; r < last[t]; ++r) ++row_start[r + 1];
+    }
+    for (int r = 0; r < rows; ++r) row_start[r + 1] += row_start[r];
+    std::vector<int32_t> row_tris(static_cast<size_t>(row_start[rows]));
+    {
+      std::vector<long long> fill(row_start.begin(), row_start.end() - 1);
+      for (size_t t = 0; t < nt; ++t) {
+        for (int r = first[t]; r < last[t]; ++r) row_tris[fill[r]++] = static_cast<int32_t>(t);
+      }
+    }
+
+#pragma omp parallel reduction(+ : crossings, odd_columns)
+    {
+      std::vector<std::vector<double>> hits(cols);
+#pragma omp for schedule(dynamic, 1)
+      for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < cols; ++c) hits[c].clear();
+        const double pu = coords[ua][r];
+
+        for (long long e = row_start[r]; e < row_start[r + 1]; ++e) {
+          const int32_t* tri = triangles + 3 * static_cast<size_t>(row_tris[e]);
+          const ProjectedTriangle pt(vertices + 3 * static_cast<size_t>(tri[0]),
+                                     vertices + 3 * static_cast<size_t>(tri[1]),
+                                     vertices + 3 * static_cast<size_t>(tri[2]), a);
+          if (!pt.valid) continue;  // parallel to the rays
+          int c0, c1;
+          index_range(coords[va], cols, std::min({pt.p[0].v, pt.p[1].v, pt.p[2].v}),
+                      std::max({pt.p[0].v, pt.p[1].v, pt.p[2].v}), c0, c1);
+          for (int c = c0; c < c1; ++c) {
+            double w;
+            if (pt.hit({pu, static_cast<double>(coords[va][c])}, w)) hits[c].push_back(w);
+          }
+        }
+
+        const float* wc = coords[a];
+        for (int c = 0; c < cols; ++c) {
+          std::vector<double>& h = hits[c];
+          crossings += static_cast<long long>(h.size());
+          if (h.size() % 2 != 0) {
+            ++odd_columns;
+            continue;
+          }
+          std::sort(h.begin(), h.end());
+          const long long base = r * strides[ua] + c * strides[va];
+          size_t passed = 0;
+          for (int k = 0; k < dims[a]; ++k) {
+            while (passed < h.size() && h[passed] < wc[k]) ++passed;
+            const uint8_t inside = static_cast<uint8_t>(passed & 1);
+            votes[base + k * strides[a]] |= static_cast<uint8_t>((inside << a) | (8 << a));
+          }
+        }
+      }
+    }
+  }
+
+  // Majority of the valid axes per cell.
+  BitMask inside_mask(nx, ny, nz);
+  const long long columns = static_cast<long long>(nx) * ny;
+  long long disputed = 0;
+  long long unresolved = 0;
+#pragma omp parallel for schedule(static) reduction(+ : disputed, unresolved)
+  for (long long col = 0; col < columns; ++col) {
+    const uint8_t* v = votes.data() + col * nz;
+    uint64_t* out = inside_mask.row(static_cast<int>(col / ny), static_cast<int>(col % ny));
+    for (int k = 0; k < nz; ++k) {
+      const int valid = ((v[k] >> 3) & 1) + ((v[k] >> 4) & 1) + ((v[k] >> 5) & 1);
+      const int inside = (v[k] & 1) + ((v[k] >> 1) & 1) + ((v[k] >> 2) & 1);
+      if (valid == 0) ++unresolved;
+      if (inside != 0 && inside != valid) ++disputed;
+      if (2 * inside > valid) set_bit(out, k);
+    }
+  }
+
+  if (stats) {
+    stats->crossings = static_cast<size_t>(crossings);
+    stats->odd_columns = static_cast<size_t>(odd_columns);
+    stats->disputed_cells = static_cast<size_t>(disputed);
+    stats->unresolved_cells = static_cast<size_t>(unresolved);
+  }
+  return inside_mask;
+}
+
+}  // namespace fluid
@@ -0,0 +1,40 @@
+// Triangle-mesh voxelizer: which points of a rectilinear grid lie inside a
+// closed surface.
+//
+// Rays are cast along grid lines. For one axis the triangles are binned by
+// the grid row they cover, each row is handled by one thread, and every
+// triangle is rasterized into the columns of that row whose centre falls
+// inside its projection. The crossings of a column, sorted along the ray,
+// give inside/outside by parity.
+//
+// Exact for closed meshes: a column that passes through a shared edge or
+// vertex sees exactly one of the adjacent triangles (top-left fill rule on
+// canonically ordered edges), so grazing rays don't double count.
+// Robust to small gaps: rays are cast along all three axes and each point
+// takes the majority vote of the axes whose column had an even number of
+// crossings; a hole in the surface only spoils the columns through it.
+// Points whose columns all pass through holes are left outside.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "bit_mask.hpp"
+
+namespace fluid {
+
+struct VoxelizeStats {
+  size_t crossings = 0;         // triangle/ray intersections, all three axes
+  size_t odd_columns = 0;       // columns with an odd crossing count (ignored)
+  size_t disputed_cells = 0;    // cells where the valid axes disagreed
+  size_t unresolved_cells = 0;  // cells with no valid axis at all
+};
+
+// Inside/outside of the grid points (x[i], y[j], z[k]) for a triangle mesh
+// given as `vertices` (nv * 3 floats) and `triangles` (nt * 3 vertex
+// indices), as a bit mask (see bit_mask.hpp), set = inside.
+BitMask voxelize_inside(const float* vertices, size_t nv, const int32_t* triangles, size_t nt,
+                        const float* x, int nx, const float* y, int ny, const float* z, int nz,
+                        VoxelizeStats* stats = nullptr);
+
+}  // namespace fluid
@@ -10,10 +10,44 @@ Key features:
 """
 from __future__ import annotations
 
+import time
+from typing import Callable
+
 import numpy as np
 from scipy.interpolate import RegularGridInterpolator
 from scipy.ndimage import distance_transform_edt
 
+from .bitmask import BitMask, as_bitmask
+from .lbm_native import NATIVE_AVAILABLE, fluid_native
+from .region_select import snap_to_fluid
+
+# Particles read the SDF up to the decay distance (25 cells) in fluid and the
+# respawn depth (10 cells) in solid; further out it is clamped to this band.
+SDF_BAND_CELLS = 32
+
+
+def signed_distance_field(solid: BitMask, cell_mm: float, band_cells: int = SDF_BAND_CELLS) -> np.ndarray:
+    """
+    Distance (mm) from each cell centre to the nearest cell of the other kind:
+    positive in fluid, negative in solid, clamped to +-band_cells cells
+    (band_cells <= 0: no clamp).
+
+    Uses the native separable EDT (one multithreaded pass, see
+    native/src/distance_transform.hpp) when fluid_native is built, otherwise
+    two scipy distance_transform_edt calls.
+    """
+    if NATIVE_AVAILABLE:
+        return fluid_native.signed_distance(solid.words, solid.shape[2], band_cells, cell_mm)
+
+    solid = solid.to_bool()
+    fluid_mask = ~solid
+    dist_to_solid = distance_transform_edt(fluid_mask).astype(np.float32) * cell_mm
+    dist_from_solid = distance_transform_edt(solid).astype(np.float32) * cell_mm
+    signed_distance = np.where(fluid_mask, dist_to_solid, -dist_from_solid)
+    if band_cells > 0:
+        np.clip(signed_distance, -band_cells * cell_mm, band_cells * cell_mm, out=signed_distance)
+    return signed_distance
+
 
 def advect_particles(
     *,
@@ -23,12 +57,16 @@ def advect_particles(
     ux: np.ndarray,
     uy: np.ndarray,
     uz: np.ndarray,
-    solid: np.ndarray,
+    solid: BitMask | np.ndarray,
     source_point_mm: np.ndarray,
     gravity_dir: np.ndarray,
     n_particles: int,
     n_frames: int,
     fill_level: np.ndarray | None = None,
+    integrator: str = "euler",
+    frame_batch: int = 0,
+    on_frames: Callable[[np.ndarray], None] | None = None,
+    source_cell: int = -1,
 ):
     """
     Advect particles through velocity field with realistic physics.
@@ -39,11 +77,21 @@ def advect_particles(
     - Gravity pulls them down
     - They slide along STL surfaces
     - They decay when too far from surfaces
+
+    With fluid_native built the frame loop runs natively (ParticleAdvector,
+    deterministic for any thread count); the numpy loop below is the fallback.
+    integrator: "euler" (one update per frame) or, native only, "rk2"/"rk4"
+    with adaptive sub-steps that can't skip through thin walls.
+    on_frames, if given, receives each block of frame_batch consecutive frames
+    (all of them if 0) as soon as it is computed, so results can be streamed.
+    source_cell: Domain.source_cell; when >= 0, source_point_mm was already
+    snapped into that fluid cell and is used as is.
     """
     print(f"[Advect] === Starting particle advection ===")
     print(f"[Advect] Particles: {n_particles:,}, Frames: {n_frames}")
     print(f"[Advect] Source (input): {source_point_mm}")
     print(f"[Advect] Gravity: {gravity_dir}")
+    solid = as_bitmask(solid)
 
     # Domain bounds
     x_min, x_max = float(x_coords.min()), float(x_coords.max())
@@ -66,74 +114,35 @@ def advect_particles(
     # CRITICAL: Clamp source point to be INSIDE the fluid region
     # ==========================================================================
     src_raw = np.asarray(source_point_mm, dtype=np.float32)
-    
-    # Clamp to grid bounds first
-    src_clamped = np.array([
-        np.clip(src_raw[0], x_min + avg_dx, x_max - avg_dx),
-        np.clip(src_raw[1], y_min + avg_dx, y_max - avg_dx),
-        np.clip(src_raw[2], z_min + avg_dx, z_max - avg_dx),
-    ], dtype=np.float32)
-    
-    # Check if clamped source is in fluid (not solid)
-    # Convert to grid indices
-    src_ix = int(np.clip((src_clamped[0] - x_min) / dx_mm, 0, len(x_coords) - 1))
-    src_iy = int(np.clip((src_clamped[1] - y_min) / dy_mm, 0, len(y_coords) - 1))
-    src_iz = int(np.clip((src_clamped[2] - z_min) / dz_mm, 0, len(z_coords) - 1))
-    
-    if solid[src_ix, src_iy, src_iz]:
-        print(f"[Advect] WARNING: Source point is in solid! Searching for nearest fluid...")
-        
-        # Find nearest fluid cell
-        fluid_cells = np.argwhere(~solid)
-        if len(fluid_cells) > 0:
-            fluid_positions = np.column_stack([
-                x_coords[fluid_cells[:, 0]],
-                y_coords[fluid_cells[:, 1]],
-                z_coords[fluid_cells[:, 2]]
-            ])
-            distances = np.linalg.norm(fluid_positions - src_clamped, axis=1)
-            nearest_idx = np.argmin(distances)
-            src_clamped = fluid_positions[nearest_idx].astype(np.float32)
-            print(f"[Advect] Found nearest fluid cell at: {src_clamped}")
-    
-    src = src_clamped
+
+    if source_cell >= 0:
+        # build_domain_from_stl() already snapped it; clamping again could
+        # move it out of the inlet it was snapped to
+        src = src_raw
+    else:
+        # Clamp to grid bounds first
+        src_clamped = np.array([
+            np.clip(src_raw[0], x_min + avg_dx, x_max - avg_dx),
+            np.clip(src_raw[1], y_min + avg_dx, y_max - avg_dx),
+            np.clip(src_raw[2], z_min + avg_dx, z_max - avg_dx),
+        ], dtype=np.float32)
+
+        # Move it to the nearest fluid cell if it is in solid
+        src, _ = snap_to_fluid(solid, (x_coords, y_coords, z_coords), src_clamped)
+        if not np.array_equal(src, src_clamped):
+            print(f"[Advect] WARNING: Source point is in solid, moved to nearest fluid cell at: {src}")
     print(f"[Advect] Source (final): {src}")
 
     # ==========================================================================
     # Build distance field for STL surface collision
     # ==========================================================================
-    # Distance from each cell to nearest solid (positive = inside fluid, negative = inside solid)
-    fluid_mask = ~solid
-    dist_to_solid = distance_transform_edt(fluid_mask).astype(np.float32) * avg_dx  # mm
-    dist_from_solid = distance_transform_edt(solid).astype(np.float32) * avg_dx
-    
-    # Signed distance: positive inside fluid, negative inside solid
-    signed_distance = np.where(fluid_mask, dist_to_solid, -dist_from_solid)
-    
+    # Signed distance: positive inside fluid, negative inside solid (mm)
+    t_sdf = time.perf_counter()
+    signed_distance = signed_distance_field(solid, avg_dx)
+    print(f"[Advect] SDF built in {(time.perf_counter() - t_sdf) * 1e3:.0f}ms ({'native' if NATIVE_AVAILABLE else 'scipy'},"
+          f" band {SDF_BAND_CELLS} cells)")
     print(f"[Advect] SDF range: [{signed_distance.min():.1f}, {signed_distance.max():.1f}] mm")
 
-    # ==========================================================================
-    # Build interpolators
-    # ==========================================================================
-    interp_ux = RegularGridInterpolator(
-        (x_coords, y_coords, z_coords), ux, 
-        bounds_error=False, fill_value=0.0, method='linear'
-    )
-    interp_uy = RegularGridInterpolator(
-        (x_coords, y_coords, z_coords), uy,
-        bounds_error=False, fill_value=0.0, method='linear'
-    )
-    interp_uz = RegularGridInterpolator(
-        (x_coords, y_coords, z_coords), uz,
-        bounds_error=False, fill_value=0.0, method='linear'
-    )
-    
-    # Signed distance interpolator - key for surface interaction!
-    interp_sdf = RegularGridInterpolator(
-        (x_coords, y_coords, z_coords), signed_distance,
-        bounds_error=False, fill_value=-100.0, method='linear'  # Outside = "deep in solid"
-    )
-
     # ==========================================================================
     # Physics parameters
     # ==========================================================================
@@ -164,6 +173,75 @@ def advect_particles(
     print(f"[Advect] Surface thickness: {surface_thickness_mm:.2f}mm")
     print(f"[Advect] Decay distance: {max_distance_from_surface:.1f}mm")
 
+    emission_duration = max(1, n_frames * 3 // 4)  # Emit for 75% of simulation
+
+    if NATIVE_AVAILABLE:
+        # Same rules, one OpenMP pass per frame (native/src/particle_advect.hpp).
+        params = fluid_native.AdvectParams()
+        params.source = src.tolist()
+        params.gravity = grav.tolist()
+        params.emit_radius = emit_radius_mm
+        params.emit_speed = emit_speed_mm
+        params.velocity_scale = velocity_scale
+        params.gravity_accel = gravity_accel_mm
+        params.max_gravity_speed = max_gravity_speed
+        params.surface_thickness = surface_thickness_mm
+        params.surface_attraction = surface_attraction_mm
+        params.max_distance_from_surface = max_distance_from_surface
+        params.respawn_depth = avg_dx * 10.0
+        params.collision_push = avg_dx
+        params.max_speed = avg_dx * 20.0
+        params.gradient_eps = avg_dx * 0.5
+        params.domain_margin = domain_size
+        params.max_age = particle_lifetime_frames * 2
+        params.emission_frames = emission_duration
+        params.seed = 42
+        params.integrator = integrator
+
+        t_adv = time.perf_counter()
+        advector = fluid_native.ParticleAdvector(x_coords, y_coords, z_coords, ux, uy, uz, signed_distance)
+        advector.start(n_particles, params)
+        batch = frame_batch if frame_batch > 0 else n_frames
+        frames = np.empty((n_frames, n_particles, 3), dtype=np.float32)
+        stats = {"respawned": 0, "collisions": 0, "particle_steps": 0, "substeps": 0}
+        for t0 in range(0, n_frames, batch):
+            block, step_stats = advector.advance(min(batch, n_frames - t0))
+            frames[t0:t0 + len(block)] = block
+            for key in stats:
+                stats[key] += step_stats[key]
+            if on_frames is not None:
+                on_frames(block)
+        substeps = stats["substeps"] / max(1, stats["particle_steps"])
+        print(f"[Advect] Native advection ({integrator}): {n_frames} frames in {(time.perf_counter() - t_adv) * 1e3:.0f}ms"
+              f" ({fluid_native.max_threads()} threads, {substeps:.2f} steps per particle-frame)")
+        _print_final_statistics(frames, advector.birth_frames <= n_frames - 1, stats["respawned"], stats["collisions"])
+        return frames
+
+    if integrator != "euler":
+        print(f"[Advect] {integrator} integration is native-only - using Euler")
+
+    # ==========================================================================
+    # Build interpolators
+    # ==========================================================================
+    interp_ux = RegularGridInterpolator(
+        (x_coords, y_coords, z_coords), ux, 
+        bounds_error=False, fill_value=0.0, method='linear'
+    )
+    interp_uy = RegularGridInterpolator(
+        (x_coords, y_coords, z_coords), uy,
+        bounds_error=False, fill_value=0.0, method='linear'
+    )
+    interp_uz = RegularGridInterpolator(
+        (x_coords, y_coords, z_coords), uz,
+        bounds_error=False, fill_value=0.0, method='linear'
+    )
+    
+    # Signed distance interpolator - key for surface interaction!
+    interp_sdf = RegularGridInterpolator(
+        (x_coords, y_coords, z_coords), signed_distance,
+        bounds_error=False, fill_value=-100.0, method='linear'  # Outside = "deep in solid"
+    )
+
     # ==========================================================================
     # Create emission basis vectors (perpendicular to gravity)
     # ==========================================================================
@@ -180,7 +258,6 @@ def advect_particles(
     rng = np.random.default_rng(42)
 
     # Stagger birth times for continuous emission
-    emission_duration = max(1, n_frames * 3 // 4)  # Emit for 75% of simulation
     birth_frames = rng.integers(0, emission_duration, size=n_particles)
 
     # Pre-compute random emission offsets
@@ -207,6 +284,7 @@ def advect_particles(
 
     # Output frames
     frames = np.empty((n_frames, n_particles, 3), dtype=np.float32)
+    batch = frame_batch if frame_batch > 0 else n_frames
 
     # Statistics tracking
     n_decayed = 0
@@ -377,14 +455,20 @@ def advect_particles(
             n_born = np.sum(~not_born)
             print(f"[Advect] Frame {t}/{n_frames}: born={n_born:,}, active={n_active:,}, decayed={n_decayed:,}")
 
+        if on_frames is not None and ((t + 1) % batch == 0 or t == n_frames - 1):
+            on_frames(frames[t - t % batch:t + 1])
+
     # ==========================================================================
     # Final statistics
     # ==========================================================================
-    born_mask = birth_frames <= n_frames - 1
+    _print_final_statistics(frames, birth_frames <= n_frames - 1, n_decayed, n_collisions)
+
+    return frames
+
+
+def _print_final_statistics(frames: np.ndarray, born_mask: np.ndarray, n_decayed: int, n_collisions: int) -> None:
     if np.any(born_mask):
         movement = np.linalg.norm(frames[-1, born_mask] - frames[0, born_mask], axis=1)
         print(f"[Advect] === Final Statistics ===")
         print(f"[Advect] Movement - min: {movement.min():.1f}mm, max: {movement.max():.1f}mm, mean: {movement.mean():.1f}mm")
         print(f"[Advect] Total decays: {n_decayed:,}, collisions: {n_collisions:,}")
-
-    return frames
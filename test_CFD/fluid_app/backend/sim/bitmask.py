@@ -0,0 +1,148 @@
+"""
+Bit-packed voxel masks (1 bit per cell).
+
+The solid, inlet and outlet masks travel from the voxelizer through the
+domain, the solvers, the SDF builder and the result file in this form, 8x
+smaller than numpy bool arrays. The layout is the native one (see
+native/src/bit_mask.hpp): a C-ordered (nx, ny, nz) grid packed along z into
+(nx, ny, ceil(nz / 64)) uint64 words, cell k of a row in bit k % 64 of word
+k // 64, padding bits past nz always zero. Native code takes `words` as is.
+
+Counting is a popcount over the words; set_indices() only unpacks the words
+that have bits set, so sparse masks (inlet, outlet, wall layers) are cheap
+to iterate.
+"""
+from __future__ import annotations
+
+import numpy as np
+
+
+class BitMask:
+    __slots__ = ("words", "shape")
+
+    def __init__(self, words: np.ndarray, nz: int):
+        words = np.asarray(words, dtype=np.uint64)
+        if words.ndim != 3 or words.shape[2] != (nz + 63) // 64:
+            raise ValueError(f"words must have shape (nx, ny, {(nz + 63) // 64}) for nz={nz}")
+        self.words = words
+        self.shape = (int(words.shape[0]), int(words.shape[1]), int(nz))
+
+    @classmethod
+    def zeros(cls, shape) -> BitMask:
+        nx, ny, nz = shape
+        return cls(np.zeros((nx, ny, (nz + 63) // 64), dtype=np.uint64), nz)
+
+    @classmethod
+    def from_indices(cls, shape, flat: np.ndarray) -> BitMask:
+        """Mask with the cells at flat C-order indices `flat` set."""
+        mask = cls.zeros(shape)
+        row, k = np.divmod(np.asarray(flat, dtype=np.int64), shape[2])
+        np.bitwise_or.at(mask.words.reshape(-1), row * mask.words.shape[2] + (k >> 6),
+                         np.left_shift(np.uint64(1), (k & 63).astype(np.uint64)))
+        return mask
+
+    @classmethod
+    def from_bool(cls, mask: np.ndarray) -> BitMask:
+        nx, ny, nz = mask.shape
+        words = (nz + 63) // 64
+        packed = np.zeros((nx, ny, words * 8), dtype=np.uint8)
+        packed[..., :(nz + 7) // 8] = np.packbits(mask, axis=-1, bitorder="little")
+        return cls(packed.view(np.uint64), nz)
+
+    def to_bool(self) -> np.ndarray:
+        """bool (nx, ny, nz) copy; for consumers that need one byte per cell (torch, scipy)."""
+        nz = self.shape[2]
+        return np.unpackbits(self.words.view(np.uint8), axis=-1, count=nz, bitorder="little").view(np.bool_)
+
+    def crop(self, lo, hi) -> np.ndarray:
+        """bool copy of the box lo <= (i, j, k) < hi; unpacks only the words it covers."""
+        (i0, j0, k0), (i1, j1, k1) = lo, hi
+        w0 = k0 >> 6
+        words = np.ascontiguousarray(self.words[i0:i1, j0:j1, w0:(k1 + 63) >> 6])
+        bits = np.unpackbits(words.view(np.uint8), axis=-1, bitorder="little")
+        return bits[..., k0 - 64 * w0:k1 - 64 * w0].view(np.bool_)
+
+    @property
+    def nbytes(self) -> int:
+        return self.words.nbytes
+
+    def count(self) -> int:
+        """Number of set cells."""
+        return int(np.bitwise_count(self.words).sum(dtype=np.int64))
+
+    def any(self) -> bool:
+        return bool(self.words.any())
+
+    def set_indices(self) -> np.ndarray:
+        """Flat C-order indices of the set cells, ascending (like np.flatnonzero)."""
+        nz = self.shape[2]
+        wz = self.words.shape[2]
+        flat = self.words.reshape(-1)
+        hot = np.flatnonzero(flat)
+        bits = np.unpackbits(flat[hot].view(np.uint8).reshape(-1, 8), axis=1, bitorder="little")
+        w, b = np.nonzero(bits)
+        row, word = np.divmod(hot[w], wz)
+        return row * nz + word * 64 + b
+
+    def argwhere(self) -> np.ndarray:
+        """(n, 3) grid indices of the set cells (like np.argwhere)."""
+        return np.column_stack(np.unravel_index(self.set_indices(), self.shape))
+
+    def __getitem__(self, ijk) -> bool:
+        i, j, k = (int(v) for v in ijk)
+        return bool((int(self.words[i, j, k >> 6]) >> (k & 63)) & 1)
+
+    def _clear_padding(self, words: np.ndarray) -> np.ndarray:
+        tail = self.shape[2] & 63
+        if tail:
+            words[..., -1] &= np.uint64((1 << tail) - 1)
+        return words
+
+    def __invert__(self) -> BitMask:
+        return BitMask(self._clear_padding(~self.words), self.shape[2])
+
+    def __and__(self, other: BitMask) -> BitMask:
+        return BitMask(self.words & other.words, self.shape[2])
+
+    def __or__(self, other: BitMask) -> BitMask:
+        return BitMask(self.words | other.words, self.shape[2])
+
+    def andnot(self, other: BitMask) -> BitMask:
+        """Cells set here and clear in `other`."""
+        return BitMask(self.words & ~other.words, self.shape[2])
+
+    def roll(self, shift) -> BitMask:
+        """
+        Periodic shift like np.roll(mask, shift, axis=(0, 1, 2)); x and y by
+        any amount, z by at most one cell (lattice directions).
+        """
+        sx, sy, sz = (int(v) for v in shift)
+        if abs(sz) > 1:
+            raise ValueError("z shift must be -1, 0 or 1")
+        w = np.roll(self.words, (sx, sy), axis=(0, 1)) if sx or sy else self.words
+        if sz == 0:
+            return BitMask(w.copy() if w is self.words else w, self.shape[2])
+        nz = self.shape[2]
+        top, top_bit = divmod(nz - 1, 64)
+        one = np.uint64(1)
+        if sz > 0:
+            # out[k] = in[k - 1]; bit nz - 1 wraps to bit 0
+            wrap = (w[..., top] >> np.uint64(top_bit)) & one
+            out = w << one
+            out[..., 1:] |= w[..., :-1] >> np.uint64(63)
+            self._clear_padding(out)
+            out[..., 0] |= wrap
+        else:
+            # out[k] = in[k + 1]; bit 0 wraps to bit nz - 1
+            wrap = w[..., 0] & one
+            out = w >> one
+            out[..., :-1] |= w[..., 1:] << np.uint64(63)
+            out[..., top] |= wrap << np.uint64(top_bit)
+        return BitMask(out, nz)
+
+
+def as_bitmask(mask) -> BitMask:
+    """A BitMask as is, or a bool (nx, ny, nz) array packed."""
+    if isinstance(mask, BitMask):
+        return mask
+    return BitMask.from_bool(np.asarray(mask, dtype=np.bool_))
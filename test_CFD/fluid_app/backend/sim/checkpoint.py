@@ -0,0 +1,265 @@
+"""
+Binary checkpoint/restart for the LBM phase of simulate_run().
+
+A checkpoint file is memory-mapped and holds a small header plus two slots:
+
+    [0, 4096)       header: magic, version, nx/ny/nz, domain hash, which slot is
+                    valid and the iteration/AA parity stored in each slot,
+                    followed by a JSON description of the arrays (name, dtype, shape)
+    slot 0, slot 1  the solver state arrays (populations, fill level), page aligned
+
+save() copies the solver state into the slot that is NOT currently valid and
+returns; a background thread then writes it to disk and only afterwards flips
+the header to point at the new slot. Only the flush is asynchronous: the copy
+into the mapping runs on the caller's thread, because the native solver hands
+out views of its live populations, so stepping waits for one memcpy of the
+state per checkpoint (not for the disk). A crash at any moment leaves the
+previous checkpoint intact.
+Solvers whose state lives in other processes (lbm_slabs.py) have those write
+into the file themselves: begin_save() hands out the spare slot's byte
+offsets and commit_save() starts the same flush.
+
+Files are keyed by a hash of everything that determines the solver's
+trajectory (masks, grid, viscosity, gravity, inlet, backend, storage format),
+so a retried run with the same inputs finds and resumes the checkpoint. Runs
+of the same domain at the same time would share the file, so the first one
+to get there holds an exclusive lock on "<file>.lock" until close(); the
+others neither resume nor checkpoint.
+"""
+from __future__ import annotations
+
+import hashlib
+import json
+import os
+import struct
+import threading
+from pathlib import Path
+
+import numpy as np
+
+MAGIC = b"FLUIDCKP"
+VERSION = 1
+HEADER_BYTES = 4096
+_PAGE = 4096
+
+# magic, version, nx, ny, nz, domain hash, valid slot (-1 = none),
+# slot 0 iteration, slot 0 parity, slot 1 iteration, slot 1 parity
+_HEADER = struct.Struct("<8sIIII32sqqIqI")
+_SPEC_OFFSET = 256
+
+
+def domain_key(**parts) -> str:
+    """sha256 over named arrays/scalars (arrays hashed by dtype, shape and bytes)."""
+    h = hashlib.sha256()
+    for name in sorted(parts):
+        value = parts[name]
+        h.update(name.encode())
+        if isinstance(value, np.ndarray):
+            arr = np.ascontiguousarray(value)
+            if arr.dtype == np.bool_:
+                arr = np.packbits(arr)
+            h.update(str(arr.dtype).encode())
+            h.update(str(value.shape).encode())
+            h.update(arr.tobytes())
+        else:
+            h.update(repr(value).encode())
+    return h.hexdigest()
+
+
+def _try_lock(fd: int) -> bool:
+    """Non-blocking exclusive lock on an open file, held until the fd is closed."""
+    try:
+        if os.name == "nt":
+            import msvcrt
+            msvcrt.locking(fd, msvcrt.LK_NBLCK, 1)
+        else:
+            import fcntl
+            fcntl.flock(fd, fcntl.LOCK_EX | fcntl.LOCK_NB)
+        return True
+    except OSError:
+        return False
+
+
+def _align(n: int) -> int:
+    return (n + _PAGE - 1) // _PAGE * _PAGE
+
+
+class SolverCheckpoint:
+    """
+    Double-buffered checkpoint file for one solver state layout.
+
+    `arrays` is a template of the state: name -> array with the dtype/shape
+    every save() will pass (e.g. lbm.checkpoint_state()[0]).
+    """
+
+    def __init__(self, path: Path, key: str, grid: tuple[int, int, int], arrays: dict[str, np.ndarray]):
+        self.path = Path(path)
+        self.key = bytes.fromhex(key)
+        self.grid = tuple(int(n) for n in grid)
+        self.spec = [(name, str(a.dtype), list(a.shape)) for name, a in arrays.items()]
+        self._offsets = {}
+        off = 0
+        for name, dtype, shape in self.spec:
+            self._offsets[name] = off
+            off = _align(off + int(np.prod(shape)) * np.dtype(dtype).itemsize)
+        self.slot_bytes = off
+        self._mm: np.memmap | None = None
+        self._fd: int | None = None
+        self._flush: threading.Thread | None = None
+        self._slots = [(-1, 0), (-1, 0)]  # (iteration, parity) per slot
+        self._valid = -1
+        self._spare = 0  # slot being written between begin_save() and commit_save()
+        self._lock_fd: int | None = None
+        self._locked: bool | None = None  # None = not tried yet
+
+    # -- file handling -------------------------------------------------
+
+    def _acquire(self) -> bool:
+        """Take the file's lock on first use; False if another run holds it."""
+        if self._locked is None:
+            self.path.parent.mkdir(parents=True, exist_ok=True)
+            self._lock_fd = os.open(self.path.with_name(self.path.name + ".lock"), os.O_RDWR | os.O_CREAT)
+            self._locked = _try_lock(self._lock_fd)
+            if not self._locked:
+                os.close(self._lock_fd)
+                self._lock_fd = None
+                print(f"[Checkpoint] {self.path.name} is in use by another run - not resuming or checkpointing")
+        return self._locked
+
+    def _spec_bytes(self) -> bytes:
+        return json.dumps(self.spec).encode()
+
+    def _open(self, create: bool):
+        size = HEADER_BYTES + 2 * self.slot_bytes
+        if create:
+            self.path.parent.mkdir(parents=True, exist_ok=True)
+            with open(self.path, "wb") as f:
+                f.truncate(size)
+        self._mm = np.memmap(self.path, dtype=np.uint8, mode="r+", shape=(size,))
+        self._fd = os.open(self.path, os.O_RDWR | getattr(os, "O_BINARY", 0))
+        if create:
+            self._valid = -1
+            self._slots = [(-1, 0), (-1, 0)]
+            spec = self._spec_bytes()
+            self._mm[_SPEC_OFFSET:_SPEC_OFFSET + len(spec)] = np.frombuffer(spec, dtype=np.uint8)
+            self._write_header()
+
+    def _write_header(self):
+        (it0, par0), (it1, par1) = self._slots
+        hdr = _HEADER.pack(MAGIC, VERSION, *self.grid, self.key, self._valid, it0, par0, it1, par1)
+        self._mm[:len(hdr)] = np.frombuffer(hdr, dtype=np.uint8)
+
+    def _slot_offset(self, slot: int, name: str) -> int:
+        return HEADER_BYTES + slot * self.slot_bytes + self._offsets[name]
+
+    def _slot_view(self, slot: int, name: str, dtype: str, shape) -> np.ndarray:
+        start = self._slot_offset(slot, name)
+        nbytes = int(np.prod(shape)) * np.dtype(dtype).itemsize
+        return self._mm[start:start + nbytes].view(dtype).reshape(shape)
+
+    def _sync(self):
+        # os.fsync writes back the pages dirtied through the mapping and, unlike
+        # mmap.flush(), releases the GIL. Windows needs the view flushed first.
+        if os.name == "nt":
+            self._mm.flush()
+        os.fsync(self._fd)
+
+    # -- public API ----------------------------------------------------
+
+    def load(self):
+        """
+        Open an existing checkpoint with a matching header.
+
+        Returns (iteration, parity, arrays) with arrays as views into
+        the mapped file, or None if there is nothing to resume (or another
+        run holds the file).
+        """
+        if not self._acquire():
+            return None
+        if not self.path.exists() or self.path.stat().st_size != HEADER_BYTES + 2 * self.slot_bytes:
+            return None
+        self._open(create=False)
+        magic, version, nx, ny, nz, key, valid, it0, par0, it1, par1 = _HEADER.unpack(
+            self._mm[:_HEADER.size].tobytes()
+        )
+        spec = self._spec_bytes()
+        stored_spec = self._mm[_SPEC_OFFSET:_SPEC_OFFSET + len(spec)].tobytes()
+        if (magic != MAGIC or version != VERSION or (nx, ny, nz) != self.grid or key != self.key
+                or stored_spec != spec or valid not in (0, 1)):
+            self.close()
+            return None
+        self._valid = valid
+        self._slots = [(it0, par0), (it1, par1)]
+        iteration, parity = self._slots[valid]
+        arrays = {name: self._slot_view(valid, name, dtype, shape) for name, dtype, shape in self.spec}
+        return iteration, parity, arrays
+
+    def loaded_offsets(self) -> dict[str, int]:
+        """Byte offset in self.path of each array load() returned, for readers that map the file themselves."""
+        return {name: self._slot_offset(self._valid, name) for name, _, _ in self.spec}
+
+    def save(self, iteration: int, parity: int, arrays: dict[str, np.ndarray]):
+        """
+        Copy the state into the spare slot, then flush it in the background.
+        The copy is synchronous - `arrays` may be views of live solver state -
+        so it is done when save() returns; only the flush overlaps stepping.
+        """
+        if self.begin_save() is None:
+            return
+        for name, dtype, shape in self.spec:
+            np.copyto(self._slot_view(self._spare, name, dtype, shape), arrays[name], casting="no")
+        self.commit_save(iteration, parity)
+
+    def begin_save(self) -> dict[str, int] | None:
+        """
+        First half of save() for writers that fill the slot themselves: picks
+        the spare slot and returns the byte offset in self.path of each array
+        in it (None if another run holds the file). Writes through other
+        mappings of the file land in the same page cache, so commit_save()'s
+        flush covers them once they are done.
+        """
+        if not self._acquire():
+            return None
+        self.wait()
+        if self._mm is None:
+            self._open(create=True)
+        self._spare = 1 - self._valid if self._valid in (0, 1) else 0
+        return {name: self._slot_offset(self._spare, name) for name, _, _ in self.spec}
+
+    def commit_save(self, iteration: int, parity: int):
+        """Second half: flush the slot filled since begin_save() in the background, then make it the valid one."""
+        slot = self._spare
+
+        def flush():
+            self._sync()
+            self._slots[slot] = (int(iteration), int(parity))
+            self._valid = slot
+            self._write_header()
+            self._sync()
+
+        self._flush = threading.Thread(target=flush, name="checkpoint-flush", daemon=True)
+        self._flush.start()
+
+    def wait(self):
+        """Block until the last background flush is on disk."""
+        if self._flush is not None:
+            self._flush.join()
+            self._flush = None
+
+    def close(self, delete: bool = False):
+        self.wait()
+        if self._fd is not None:
+            os.close(self._fd)
+            self._fd = None
+        self._mm = None  # unmapped once the last view of it is gone
+        if delete and self._locked and self.path.exists():
+            try:
+                self.path.unlink()
+            except OSError as ex:  # still mapped somewhere (Windows)
+                print(f"[Checkpoint] Could not delete {self.path}: {ex}")
+        # The lock file stays: unlinking it would let a run that already opened
+        # it lock a file nobody else sees.
+        if self._lock_fd is not None:
+            os.close(self._lock_fd)
+            self._lock_fd = None
+        self._locked = None
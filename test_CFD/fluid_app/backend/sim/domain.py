@@ -6,6 +6,15 @@ from pathlib import Path
 import numpy as np
 import pyvista as pv
 
+from .bitmask import BitMask
+from .domain_cache import DomainCache, LinkList, VoxelGeometry, domain_cache_key
+from .lbm_native import NATIVE_AVAILABLE, fluid_native
+from .lbm_torch import build_wall_links
+from .region_select import nearest_fluid_cells, select_sphere, snap_to_fluid
+
+# Empty margin around the STL bounds.
+PADDING_MM = 5.0
+
 
 @dataclass(frozen=True)
 class Domain:
@@ -15,13 +24,17 @@ class Domain:
     x_coords: np.ndarray
     y_coords: np.ndarray
     z_coords: np.ndarray
-    solid: np.ndarray  # bool (nx,ny,nz)
-    inlet: np.ndarray  # bool
-    outlet: np.ndarray  # bool
+    solid: BitMask  # (nx,ny,nz), bit-packed
+    inlet: BitMask
+    outlet: BitMask
     gravity_dir: np.ndarray  # float32 (3,) - normalized
     gravity_lbm: np.ndarray  # float32 (3,) - gravity in lattice units!
     dx_m: float
     source_point_mm: np.ndarray  # float32 (3,) - CLAMPED source point for advection!
+    source_cell: int = -1  # flat index of the fluid cell the source point was snapped to
+    wall_links: LinkList | None = None  # fluid cell x, direction q with x + c_q solid
+    inlet_cells: np.ndarray | None = None  # int32 flat indices of the inlet cells
+    outlet_cells: np.ndarray | None = None  # int32 flat indices of the outlet cells
 
     def inlet_speed_lbm(self, *, flow_gph: float, nu_lbm: float) -> float:
         """
@@ -112,6 +125,93 @@ def _compute_gravity_lbm(gravity_dir: np.ndarray, dx_m: float, nu_lbm: float) ->
     return gravity_lbm.astype(np.float32)
 
 
+def _load_mesh(stl_path: str):
+    """
+    Read the STL as a welded triangle mesh.
+
+    With fluid_native built this is native.StlMesh (memory-mapped parse,
+    vertex weld and BVH, see native/src/stl_mesh.hpp), which exposes the
+    same points/bounds/n_points/n_cells as the pyvista mesh it replaces.
+    """
+    if NATIVE_AVAILABLE:
+        mesh = fluid_native.StlMesh(str(stl_path))
+        stats = mesh.load_stats
+        print(f"[Domain] Native STL load: {stats['raw_triangles']:,} triangles -> {mesh.n_points:,} vertices "
+              f"(read {stats['read_ms']:.1f}ms, weld {stats['weld_ms']:.1f}ms, BVH {stats['bvh_ms']:.1f}ms, "
+              f"{mesh.memory_bytes / 1e6:.1f}MB)")
+        if stats["dropped_triangles"]:
+            print(f"[Domain] Dropped {stats['dropped_triangles']} degenerate triangles")
+        return mesh
+    return pv.read(stl_path).clean().triangulate()
+
+
+def _mesh_triangles(mesh) -> np.ndarray:
+    """(n, 3) vertex indices of a native StlMesh or a triangulated pyvista mesh."""
+    if hasattr(mesh, "triangles"):
+        return mesh.triangles
+    return np.asarray(mesh.faces).reshape(-1, 4)[:, 1:]
+
+
+# Which voxelizer _voxelize_inside() uses; part of the domain cache key, since
+# the two disagree on some boundary cells.
+VOXELIZER = "native-ray-parity" if NATIVE_AVAILABLE else "pyvista"
+
+
+def _voxelize_inside(mesh, x_coords: np.ndarray, y_coords: np.ndarray, z_coords: np.ndarray) -> BitMask:
+    """
+    Which lattice points lie inside the (closed) STL surface.
+
+    Uses the native ray-parity voxelizer when fluid_native is built (see
+    native/src/voxelize.hpp); otherwise every lattice point goes through
+    pyvista's select_enclosed_points.
+    """
+    nx, ny, nz = len(x_coords), len(y_coords), len(z_coords)
+    if NATIVE_AVAILABLE:
+        packed, info = fluid_native.voxelize(
+            np.asarray(mesh.points, dtype=np.float32), _mesh_triangles(mesh), x_coords, y_coords, z_coords
+        )
+        print(f"[Domain] Native voxelizer: {info['crossings']:,} ray crossings, "
+              f"{info['odd_columns']} open columns, {info['unresolved_cells']} unresolved cells")
+        return BitMask(packed, nz)
+
+    X, Y, Z = np.meshgrid(x_coords, y_coords, z_coords, indexing="ij")
+    lattice_cloud = pv.PolyData(np.column_stack([X.ravel(), Y.ravel(), Z.ravel()]))
+    solid_sel = lattice_cloud.select_enclosed_points(mesh, tolerance=0.0, check_surface=False)
+    inside = np.asarray(solid_sel.point_data["SelectedPoints"]).astype(bool)
+    return BitMask.from_bool(inside.reshape((nx, ny, nz), order="C"))
+
+
+def _voxel_geometry(mesh, base_resolution: int, padding_mm: float, gravity_dir: np.ndarray) -> VoxelGeometry:
+    """The part of the domain that depends only on the STL, the lattice and gravity (cached on disk)."""
+    b = mesh.bounds
+    nx, ny, nz = _dims_from_bounds(b, base_resolution, max_cells=320)
+    x_coords = np.linspace(b[0] - padding_mm, b[1] + padding_mm, nx).astype(np.float32)
+    y_coords = np.linspace(b[2] - padding_mm, b[3] + padding_mm, ny).astype(np.float32)
+    z_coords = np.linspace(b[4] - padding_mm, b[5] + padding_mm, nz).astype(np.float32)
+
+    # Fluid flows INSIDE the mesh (flume/channel)
+    solid = ~_voxelize_inside(mesh, x_coords, y_coords, z_coords)
+
+    # Outlet: the lowest region of the mesh along gravity (lowest 10% of its points)
+    mesh_pts = np.asarray(mesh.points, dtype=np.float32)
+    proj = mesh_pts @ gravity_dir
+    low_pts = mesh_pts[proj <= np.percentile(proj, 10)]
+    if len(low_pts) > 0:
+        low_center = low_pts.mean(axis=0)
+    else:
+        low_center = mesh_pts[int(np.argmin(proj))]
+
+    return VoxelGeometry(
+        bounds=tuple(float(v) for v in b),
+        x_coords=x_coords,
+        y_coords=y_coords,
+        z_coords=z_coords,
+        solid_packed=solid.words,
+        outlet_center=np.asarray(low_center, dtype=np.float32),
+        wall_links=build_wall_links(solid),
+    )
+
+
 def build_domain_from_stl(
     *, 
     stl_path: str, 
@@ -119,6 +219,7 @@ def build_domain_from_stl(
     gravity: np.ndarray, 
     source_point_mm: np.ndarray,
     nu_lbm: float = 0.06,  # Viscosity in lattice units
+    cache_dir: Path | None = None,
 ) -> Domain:
     """
     Build simulation domain from STL mesh.
@@ -128,9 +229,27 @@ def build_domain_from_stl(
     - Inlet region (spherical source at user-picked point)
     - Outlet region (at lowest point along gravity)
     - Proper gravity in lattice units for body force
+
+    With `cache_dir`, the voxelized geometry is reused from (and saved to)
+    the on-disk domain cache (see domain_cache.py).
     """
-    mesh = pv.read(stl_path).clean().triangulate()
-    b = mesh.bounds
+    gravity_dir = _normalize(gravity)
+
+    cache = DomainCache(cache_dir) if cache_dir is not None else None
+    geom = None
+    mesh = None
+    if cache is not None:
+        cache_key = domain_cache_key(stl_path, base_resolution=base_resolution, padding_mm=PADDING_MM,
+                                     gravity_dir=gravity_dir, voxelizer=VOXELIZER)
+        geom = cache.load(cache_key)
+        if geom is not None:
+            print(f"[DomainCache] Reusing voxelized domain {cache_key[:12]}...")
+    if geom is None:
+        mesh = _load_mesh(stl_path)
+        geom = _voxel_geometry(mesh, base_resolution, PADDING_MM, gravity_dir)
+        if cache is not None:
+            cache.store(cache_key, geom)
+    b = geom.bounds
 
     print(f"[Domain] === Building domain from STL ===")
     print(f"[Domain] STL bounds: X=[{b[0]:.1f}, {b[1]:.1f}], Y=[{b[2]:.1f}, {b[3]:.1f}], Z=[{b[4]:.1f}, {b[5]:.1f}]")
@@ -191,33 +310,16 @@ def build_domain_from_stl(
         source_point_mm = src
         print(f"[Domain] Source point OK (within bounds)")
 
-    # Calculate grid dimensions - allow much larger for RTX 5090
-    nx, ny, nz = _dims_from_bounds(b, base_resolution, max_cells=320)
-
-    # Add padding around mesh
-    padding_mm = 5.0
-    x_coords = np.linspace(b[0] - padding_mm, b[1] + padding_mm, nx).astype(np.float32)
-    y_coords = np.linspace(b[2] - padding_mm, b[3] + padding_mm, ny).astype(np.float32)
-    z_coords = np.linspace(b[4] - padding_mm, b[5] + padding_mm, nz).astype(np.float32)
-
-    # Create lattice points
-    X, Y, Z = np.meshgrid(x_coords, y_coords, z_coords, indexing="ij")
-    lattice_pts = np.column_stack([X.ravel(), Y.ravel(), Z.ravel()])
-    lattice_cloud = pv.PolyData(lattice_pts)
-
-    # Find points inside the STL mesh
-    solid_sel = lattice_cloud.select_enclosed_points(mesh, tolerance=0.0, check_surface=False)
-    inside = np.asarray(solid_sel.point_data["SelectedPoints"]).astype(bool)
-    inside_3d = inside.reshape((nx, ny, nz), order="C")
-
-    # Fluid flows INSIDE the mesh (flume/channel)
-    solid = ~inside_3d
+    x_coords, y_coords, z_coords = geom.x_coords, geom.y_coords, geom.z_coords
+    nx, ny, nz = len(x_coords), len(y_coords), len(z_coords)
+    solid = BitMask(geom.solid_packed, nz)
+    n_solid = solid.count()
+    n_fluid = nx * ny * nz - n_solid
 
     print(f"[Domain] Grid: {nx}x{ny}x{nz} = {nx*ny*nz:,} cells")
-    print(f"[Domain] Fluid cells (inside mesh): {np.sum(~solid):,}")
-    print(f"[Domain] Solid cells (outside mesh): {np.sum(solid):,}")
-
-    gravity_dir = _normalize(gravity)
+    print(f"[Domain] Fluid cells (inside mesh): {n_fluid:,}")
+    print(f"[Domain] Solid cells (outside mesh): {n_solid:,} ({solid.nbytes / 1e6:.1f} MB mask)")
+    print(f"[Domain] Wall links: {len(geom.wall_links):,}")
 
     dx_mm = float(min(np.diff(x_coords).mean(), np.diff(y_coords).mean(), np.diff(z_coords).mean()))
     dx_m = dx_mm / 1000.0
@@ -229,80 +331,57 @@ def build_domain_from_stl(
     # Create a LARGE spherical source region for reliable water emission
     source_radius_mm = max(20.0, 10.0 * dx_mm)  # Large source
     
-    def select_sphere(center_mm: np.ndarray, radius_mm: float):
-        """Select cells within a sphere."""
-        c0 = np.asarray(center_mm, dtype=np.float32)
-        dp = lattice_pts.astype(np.float32) - c0[None, :]
-        dist = np.linalg.norm(dp, axis=1)
-        sel = dist <= radius_mm
-        return sel.reshape((nx, ny, nz), order="C")
+    coords = (x_coords, y_coords, z_coords)
 
     # Try to find inlet cells - if none at exact point, search nearby
-    inlet_sphere = select_sphere(source_point_mm, source_radius_mm)
-    inlet = inlet_sphere & (~solid)
+    inlet = select_sphere(solid, coords, source_point_mm, source_radius_mm)
     
     # If no inlet cells found, try larger radius or find nearest fluid
-    if np.sum(inlet) == 0:
+    if not inlet.any():
         print(f"[Domain] WARNING: No inlet cells at source point, searching for fluid...")
         
-        # Find all fluid cells and pick ones closest to source
-        fluid_indices = np.argwhere(~solid)
-        if len(fluid_indices) > 0:
-            fluid_pts = np.column_stack([
-                x_coords[fluid_indices[:, 0]],
-                y_coords[fluid_indices[:, 1]],
-                z_coords[fluid_indices[:, 2]]
-            ])
-            
-            # Distance to source
-            dists = np.linalg.norm(fluid_pts - source_point_mm, axis=1)
-            
-            # Take closest fluid cells as inlet
-            n_inlet_target = max(100, int(np.sum(~solid) * 0.01))  # ~1% of fluid or at least 100
-            closest_idx = np.argsort(dists)[:n_inlet_target]
-            
-            inlet = np.zeros_like(solid)
-            for idx in closest_idx:
-                fi = fluid_indices[idx]
-                inlet[fi[0], fi[1], fi[2]] = True
+        # Take the fluid cells closest to the source as inlet
+        n_inlet_target = max(100, int(n_fluid * 0.01))  # ~1% of fluid or at least 100
+        closest = nearest_fluid_cells(solid, coords, source_point_mm, n_inlet_target)
+        if len(closest) > 0:
+            inlet = BitMask.from_indices(solid.shape, closest)
             
             # Update source point to center of inlet
-            inlet_pts = fluid_pts[closest_idx]
+            i, j, k = np.unravel_index(closest, solid.shape)
+            inlet_pts = np.column_stack([x_coords[i], y_coords[j], z_coords[k]])
             source_point_mm = inlet_pts.mean(axis=0).astype(np.float32)
-            print(f"[Domain] Found {np.sum(inlet)} inlet cells near fluid")
+            print(f"[Domain] Found {inlet.count()} inlet cells near fluid")
             print(f"[Domain] Adjusted source to: {source_point_mm}")
 
     print(f"[Domain] Source radius: {source_radius_mm:.1f}mm")
-    print(f"[Domain] Inlet cells: {np.sum(inlet)}")
+    print(f"[Domain] Inlet cells: {inlet.count()}")
 
     # === OUTLET SETUP ===
-    # Find the lowest region of the mesh along gravity direction
-    mesh_pts = np.asarray(mesh.points, dtype=np.float32)
-    proj = mesh_pts @ gravity_dir
-    
-    # Get the lowest 10% of points as outlet region
-    low_threshold = np.percentile(proj, 10)
-    low_pts_mask = proj <= low_threshold
-    low_pts = mesh_pts[low_pts_mask]
-    
-    if len(low_pts) > 0:
-        low_center = low_pts.mean(axis=0)
-    else:
-        low_center = mesh_pts[int(np.argmin(proj))]
+    # Lowest region of the mesh along gravity direction (see _voxel_geometry)
+    low_center = geom.outlet_center
 
     outlet_radius_mm = source_radius_mm * 1.5
-    outlet_sphere = select_sphere(low_center, outlet_radius_mm)
-    outlet = outlet_sphere & (~solid)
+    outlet = select_sphere(solid, coords, low_center, outlet_radius_mm)
 
     print(f"[Domain] Outlet center: {low_center}")
-    print(f"[Domain] Outlet cells: {np.sum(outlet)}")
+    print(f"[Domain] Outlet cells: {outlet.count()}")
+
+    # Snap the source into fluid once; advection starts from the same point
+    snapped, source_cell = snap_to_fluid(solid, coords, source_point_mm)
+    if source_cell >= 0 and not np.array_equal(snapped, np.asarray(source_point_mm, dtype=np.float32)):
+        print(f"[Domain] Source point is in solid, snapped to the nearest fluid cell")
+    source_point_mm = snapped
     print(f"[Domain] Source point (final): {source_point_mm}")
+    if mesh is not None and hasattr(mesh, "closest_point"):
+        src_query = np.asarray(source_point_mm, dtype=np.float32).reshape(1, 3)
+        _, wall_dist, _ = mesh.closest_point(src_query)
+        where = "inside" if mesh.inside(src_query)[0] else "OUTSIDE"
+        print(f"[Domain] Source point is {where} the mesh, {float(wall_dist[0]):.1f}mm from the nearest wall")
     print(f"[Domain] Gravity direction: {gravity_dir}")
     print(f"[Domain] dx = {dx_mm:.3f} mm")
 
     # Ensure inlet/outlet are fluid cells
-    solid[inlet] = False
-    solid[outlet] = False
+    solid = solid.andnot(inlet | outlet)
 
     # Ensure source_point_mm is a proper float32 array
     final_source = np.asarray(source_point_mm, dtype=np.float32)
@@ -321,4 +400,8 @@ def build_domain_from_stl(
         gravity_lbm=gravity_lbm,  # Gravity in lattice units for body force
         dx_m=dx_m,
         source_point_mm=final_source,  # CLAMPED source point for advection
+        source_cell=source_cell,
+        wall_links=geom.wall_links,
+        inlet_cells=inlet.set_indices().astype(np.int32),
+        outlet_cells=outlet.set_indices().astype(np.int32),
     )
@@ -0,0 +1,178 @@
+"""
+On-disk cache of voxelized domains.
+
+Every run re-reads and re-voxelizes the same STL before any physics starts.
+The geometry that depends only on the STL and the lattice (solid mask,
+coordinates, wall links, outlet position) is stored per
+
+    sha256(STL bytes, base resolution, padding, gravity direction, voxelizer)
+
+so repeat runs of a flume skip straight to inlet/outlet setup and the solver.
+The inlet and everything downstream of the source point are not cached.
+
+File layout (one file per key, written to a temp file and renamed into place):
+
+    [0, 4096)   header: magic, version, length of the JSON description that
+                follows (STL bounds, outlet centre, array name/dtype/shape/offset)
+    arrays      page aligned: x/y/z coordinates, the solid mask bit-packed
+                along z (BitMask.words, see bitmask.py), wall link offsets
+                and cells
+
+Files are memory-mapped on reuse; the wall links stay zero-copy views of the map.
+"""
+from __future__ import annotations
+
+import hashlib
+import json
+import os
+import struct
+import time
+from dataclasses import dataclass
+from pathlib import Path
+
+import numpy as np
+
+MAGIC = b"FLUIDDOM"
+VERSION = 1
+HEADER_BYTES = 4096
+_PAGE = 4096
+_HEADER = struct.Struct("<8sII")
+
+# Domains kept on disk (least recently used evicted first). A 320^3 grid is
+# ~4 MB of mask plus a few MB of wall links.
+MAX_ENTRIES = 32
+
+
+@dataclass(frozen=True)
+class LinkList:
+    """
+    Lattice links grouped by direction (CSR): the flat cell indices (C order
+    over nx, ny, nz) of direction q are cells[offsets[q]:offsets[q + 1]].
+    """
+
+    offsets: np.ndarray  # int64 (19 + 1,)
+    cells: np.ndarray  # int32
+
+    def direction(self, q: int) -> np.ndarray:
+        return self.cells[self.offsets[q]:self.offsets[q + 1]]
+
+    def __len__(self) -> int:
+        return int(self.offsets[-1])
+
+
+@dataclass(frozen=True)
+class VoxelGeometry:
+    bounds: tuple  # STL bounds (xmin, xmax, ymin, ymax, zmin, zmax)
+    x_coords: np.ndarray
+    y_coords: np.ndarray
+    z_coords: np.ndarray
+    solid_packed: np.ndarray  # BitMask.words of the solid mask, uint64 (nx, ny, ceil(nz / 64))
+    outlet_center: np.ndarray  # float32 (3,), lowest region of the mesh along gravity
+    wall_links: LinkList  # fluid cell x, direction q such that x + c_q is solid
+
+
+def domain_cache_key(stl_path: str, *, base_resolution: int, padding_mm: float, gravity_dir,
+                     voxelizer: str) -> str:
+    h = hashlib.sha256()
+    with open(stl_path, "rb") as f:
+        for block in iter(lambda: f.read(1 << 20), b""):
+            h.update(block)
+    h.update(struct.pack("<Iid", VERSION, int(base_resolution), float(padding_mm)))
+    h.update(np.asarray(gravity_dir, dtype=np.float32).tobytes())
+    h.update(voxelizer.encode())
+    return h.hexdigest()
+
+
+def _align(n: int) -> int:
+    return (n + _PAGE - 1) // _PAGE * _PAGE
+
+
+class DomainCache:
+    def __init__(self, root: Path):
+        self.root = Path(root)
+
+    def _path(self, key: str) -> Path:
+        return self.root / f"{key}.dom"
+
+    def load(self, key: str) -> VoxelGeometry | None:
+        path = self._path(key)
+        if not path.exists():
+            return None
+        try:
+            mm = np.memmap(path, dtype=np.uint8, mode="r")
+            magic, version, spec_len = _HEADER.unpack_from(mm, 0)
+            if magic != MAGIC or version != VERSION:
+                print(f"[DomainCache] Ignoring {path.name}: unknown format")
+                return None
+            spec = json.loads(bytes(mm[_HEADER.size:_HEADER.size + spec_len]).decode("utf-8"))
+            arrays = {}
+            for name, dtype, shape, offset in spec["arrays"]:
+                dt = np.dtype(dtype)
+                count = int(np.prod(shape, dtype=np.int64))
+                arrays[name] = mm[offset:offset + count * dt.itemsize].view(dt).reshape(shape)
+        except (OSError, ValueError, KeyError, struct.error) as e:
+            print(f"[DomainCache] Ignoring unreadable {path.name}: {e}")
+            return None
+
+        try:
+            os.utime(path)  # LRU order for eviction
+        except OSError:
+            pass
+        return VoxelGeometry(
+            bounds=tuple(spec["bounds"]),
+            x_coords=np.array(arrays["x"]),
+            y_coords=np.array(arrays["y"]),
+            z_coords=np.array(arrays["z"]),
+            solid_packed=arrays["solid"],
+            outlet_center=np.asarray(spec["outlet_center"], dtype=np.float32),
+            wall_links=LinkList(offsets=np.array(arrays["wall_link_offsets"]), cells=arrays["wall_link_cells"]),
+        )
+
+    def store(self, key: str, geom: VoxelGeometry):
+        self.root.mkdir(parents=True, exist_ok=True)
+        arrays = {
+            "x": np.ascontiguousarray(geom.x_coords, dtype=np.float32),
+            "y": np.ascontiguousarray(geom.y_coords, dtype=np.float32),
+            "z": np.ascontiguousarray(geom.z_coords, dtype=np.float32),
+            "solid": np.ascontiguousarray(geom.solid_packed, dtype=np.uint64),
+            "wall_link_offsets": np.ascontiguousarray(geom.wall_links.offsets, dtype=np.int64),
+            "wall_link_cells": np.ascontiguousarray(geom.wall_links.cells, dtype=np.int32),
+        }
+        layout = []
+        offset = HEADER_BYTES
+        for name, a in arrays.items():
+            layout.append([name, str(a.dtype), list(a.shape), offset])
+            offset = _align(offset + a.nbytes)
+        spec = json.dumps({
+            "bounds": [float(v) for v in geom.bounds],
+            "outlet_center": [float(v) for v in geom.outlet_center],
+            "arrays": layout,
+        }).encode("utf-8")
+        if _HEADER.size + len(spec) > HEADER_BYTES:
+            raise ValueError("domain cache header too large")
+
+        path = self._path(key)
+        tmp = path.with_suffix(f".tmp{os.getpid()}")
+        t0 = time.perf_counter()
+        try:
+            with open(tmp, "wb") as f:
+                f.write(_HEADER.pack(MAGIC, VERSION, len(spec)) + spec)
+                for (_, _, _, off), a in zip(layout, arrays.values()):
+                    f.seek(off)
+                    f.write(a.tobytes())
+                f.truncate(offset)
+            os.replace(tmp, path)
+        except OSError as e:
+            print(f"[DomainCache] Could not write {path.name}: {e}")
+            tmp.unlink(missing_ok=True)
+            return
+        print(f"[DomainCache] Saved {path.name[:12]}... ({offset / 1e6:.1f} MB, {time.perf_counter() - t0:.2f}s)")
+        self._evict()
+
+    def _evict(self):
+        files = sorted(self.root.glob("*.dom"), key=lambda p: p.stat().st_mtime)
+        for p in files[:max(0, len(files) - MAX_ENTRIES)]:
+            try:
+                p.unlink()
+            except OSError:
+                pass  # still mapped by another run (Windows)
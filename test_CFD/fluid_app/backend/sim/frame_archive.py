@@ -0,0 +1,196 @@
+"""
+Chunked, quantized storage for particle frames.
+
+The (n_frames, n_particles, 3) float32 positions are by far the largest part of
+a result (80k particles x 600 frames is 576 MB). They are stored as:
+
+    quantized   16 bits per coordinate over fixed bounds (the domain plus the
+                margin particles may fall past it before they respawn)
+    delta       per chunk of CHUNK_FRAMES frames, the first frame as is and the
+                others as the difference to the previous frame (mod 2^16, so
+                decoding is an exact prefix sum)
+    compressed  low bytes then high bytes of the chunk's values, zlib
+
+Each chunk decodes on its own, so any frame range can be served and decoded
+without touching the rest of the file.
+
+File layout:
+
+    [0, 4096)   header: magic, version, length of the JSON description that
+                follows (frame/particle/chunk counts, quantization bounds)
+    index       n_chunks x (offset u64, bytes u32, frames u32); frames = 0 for a
+                chunk not written yet
+    chunks      compressed payloads, in frame order
+
+The index entry of a chunk is filled in after its payload is on disk, so a
+reader may follow a file that is still being written.
+"""
+from __future__ import annotations
+
+import json
+import struct
+import zlib
+from pathlib import Path
+
+import numpy as np
+
+MAGIC = b"FLUIDFRM"
+VERSION = 1
+HEADER_BYTES = 4096
+_HEADER = struct.Struct("<8sII")
+_INDEX_ENTRY = struct.Struct("<QII")
+
+CHUNK_FRAMES = 16
+COMPRESSION_LEVEL = 6
+_LEVELS = 65535
+
+
+def _encode_chunk(frames: np.ndarray, lo: np.ndarray, hi: np.ndarray) -> bytes:
+    scale = _LEVELS / (hi - lo)
+    q = np.rint(np.clip((frames - lo) * scale, 0, _LEVELS)).astype(np.uint16)
+    q[1:] = q[1:] - q[:-1]  # wraps mod 2^16
+    planes = q.view(np.uint8).reshape(-1, 2).T  # little endian: low bytes, then high
+    return zlib.compress(np.ascontiguousarray(planes).tobytes(), COMPRESSION_LEVEL)
+
+
+def _decode_chunk(payload: bytes, n_frames: int, n_particles: int, lo: np.ndarray, hi: np.ndarray) -> np.ndarray:
+    planes = np.frombuffer(zlib.decompress(payload), dtype=np.uint8).reshape(2, -1)
+    q = (planes[0].astype(np.uint16) | (planes[1].astype(np.uint16) << 8)).reshape(n_frames, n_particles, 3)
+    q = np.cumsum(q, axis=0, dtype=np.uint16)
+    return (lo + q.astype(np.float32) * ((hi - lo) / _LEVELS)).astype(np.float32)
+
+
+class FrameArchiveWriter:
+    """Appends frames (any batch size) and writes a chunk whenever CHUNK_FRAMES are buffered."""
+
+    def __init__(self, path: Path, *, n_frames: int, n_particles: int, lo, hi, chunk_frames: int = CHUNK_FRAMES):
+        self.path = Path(path)
+        self.n_frames = int(n_frames)
+        self.n_particles = int(n_particles)
+        self.chunk_frames = int(chunk_frames)
+        self.n_chunks = -(-self.n_frames // self.chunk_frames)
+        self.lo = np.asarray(lo, dtype=np.float32)
+        self.hi = np.asarray(hi, dtype=np.float32)
+        self.frames_written = 0
+        self.bytes_written = 0
+        self._pending: list[np.ndarray] = []
+        self._chunk = 0
+
+        spec = {
+            "n_frames": self.n_frames,
+            "n_particles": self.n_particles,
+            "chunk_frames": self.chunk_frames,
+            "n_chunks": self.n_chunks,
+            "lo": self.lo.tolist(),
+            "hi": self.hi.tolist(),
+        }
+        blob = json.dumps(spec).encode("utf-8")
+        if _HEADER.size + len(blob) > HEADER_BYTES:
+            raise ValueError("frame archive header too large")
+        self.path.parent.mkdir(parents=True, exist_ok=True)
+        self._f = open(self.path, "wb")
+        self._f.write((_HEADER.pack(MAGIC, VERSION, len(blob)) + blob).ljust(HEADER_BYTES, b"\0"))
+        self._f.write(bytes(_INDEX_ENTRY.size * self.n_chunks))
+        self._f.flush()
+        self._offset = HEADER_BYTES + _INDEX_ENTRY.size * self.n_chunks
+
+    def append(self, frames: np.ndarray) -> None:
+        frames = np.asarray(frames, dtype=np.float32)
+        if frames.ndim != 3 or frames.shape[1:] != (self.n_particles, 3):
+            raise ValueError(f"frames must have shape (n, {self.n_particles}, 3)")
+        self._pending.append(frames)
+        buffered = sum(len(p) for p in self._pending)
+        while buffered >= self.chunk_frames:
+            block = np.concatenate(self._pending) if len(self._pending) > 1 else self._pending[0]
+            self._write_chunk(block[: self.chunk_frames])
+            rest = block[self.chunk_frames:]
+            self._pending = [rest] if len(rest) else []
+            buffered = len(rest)
+
+    def close(self) -> None:
+        if self._pending:
+            self._write_chunk(np.concatenate(self._pending))
+            self._pending = []
+        self._f.close()
+
+    def _write_chunk(self, block: np.ndarray) -> None:
+        if self._chunk >= self.n_chunks:
+            raise ValueError("more frames than the archive was created for")
+        payload = _encode_chunk(block, self.lo, self.hi)
+        self._f.seek(self._offset)
+        self._f.write(payload)
+        self._f.flush()
+        self._f.seek(HEADER_BYTES + _INDEX_ENTRY.size * self._chunk)
+        self._f.write(_INDEX_ENTRY.pack(self._offset, len(payload), len(block)))
+        self._f.flush()
+        self._offset += len(payload)
+        self._chunk += 1
+        self.frames_written += len(block)
+        self.bytes_written += len(payload)
+
+
+class FrameArchive:
+    """Reader; re-reads the index on every call so it sees chunks added since."""
+
+    def __init__(self, path: Path):
+        self.path = Path(path)
+        with open(self.path, "rb") as f:
+            magic, version, n = _HEADER.unpack(f.read(_HEADER.size))
+            if magic != MAGIC or version != VERSION:
+                raise ValueError(f"{self.path} is not a version {VERSION} frame archive")
+            spec = json.loads(f.read(n))
+        self.n_frames = int(spec["n_frames"])
+        self.n_particles = int(spec["n_particles"])
+        self.chunk_frames = int(spec["chunk_frames"])
+        self.n_chunks = int(spec["n_chunks"])
+        self.lo = np.asarray(spec["lo"], dtype=np.float32)
+        self.hi = np.asarray(spec["hi"], dtype=np.float32)
+
+    def chunks(self) -> list[tuple[int, int, int]]:
+        """(offset, bytes, frames) of the chunks written so far, in order."""
+        with open(self.path, "rb") as f:
+            f.seek(HEADER_BYTES)
+            raw = f.read(_INDEX_ENTRY.size * self.n_chunks)
+        out = []
+        for entry in _INDEX_ENTRY.iter_unpack(raw):
+            if entry[2] == 0:
+                break
+            out.append(entry)
+        return out
+
+    def describe(self) -> dict:
+        """JSON-friendly header and index, as served to the frontend."""
+        return {
+            "nFrames": self.n_frames,
+            "nParticles": self.n_particles,
+            "chunkFrames": self.chunk_frames,
+            "lo": self.lo.tolist(),
+            "hi": self.hi.tolist(),
+            "chunks": [{"frames": n, "bytes": size} for _, size, n in self.chunks()],
+        }
+
+    def chunk_payload(self, i: int) -> bytes:
+        chunks = self.chunks()
+        if not 0 <= i < len(chunks):
+            raise IndexError(f"chunk {i} not written")
+        offset, size, _ = chunks[i]
+        with open(self.path, "rb") as f:
+            f.seek(offset)
+            return f.read(size)
+
+    def chunk(self, i: int) -> np.ndarray:
+        _, _, n = self.chunks()[i]
+        return _decode_chunk(self.chunk_payload(i), n, self.n_particles, self.lo, self.hi)
+
+    def frames(self, start: int = 0, stop: int | None = None) -> np.ndarray:
+        """Frames [start, stop), decoding only the chunks that overlap them."""
+        stop = self.n_frames if stop is None else stop
+        first, last = start // self.chunk_frames, -(-stop // self.chunk_frames)
+        parts = [self.chunk(i) for i in range(first, last)]
+        block = np.concatenate(parts) if parts else np.empty((0, self.n_particles, 3), np.float32)
+        return block[start - first * self.chunk_frames: stop - first * self.chunk_frames]
+
+
+def quantization_step(lo, hi) -> float:
+    """Largest position step (mm) of the 16-bit grid; the error is at most half of it."""
+    return float(np.max((np.asarray(hi, np.float64) - np.asarray(lo, np.float64)) / _LEVELS))
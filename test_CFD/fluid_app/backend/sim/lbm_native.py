@@ -0,0 +1,253 @@
+"""
+Native multicore D3Q19 LBM solver (C++/OpenMP via pybind11).
+
+Drop-in CPU replacement for LbmD3Q19Torch:
+- Same BGK + Guo gravity forcing, bounce-back, inlet and outlet rules
+- One fused stream/collide sweep per step - no full-grid temporaries
+- In-place AA-pattern streaming: a single 19xN population array (torch keeps two)
+- Optional sparse lattice: only fluid cells are stored (Morton order + neighbour
+  table), so memory and step time follow the fluid volume, not nx*ny*nz
+- Optional 16-bit population storage (fp16 / bf16 deviations from the lattice
+  weights, fp32 arithmetic) - half the population memory and bandwidth
+- SIMD collision kernel (AVX2 / AVX-512, picked at runtime, scalar fallback)
+- NUMA-aware: arrays are first touched by the threads that update them, and
+  threads are pinned to cores on multi-socket machines
+- Runs on every core of CPU-only boxes where torch would crawl
+
+Build the extension with CMake (see backend/README.md); it lands next to this
+file as sim/fluid_native.
+"""
+from __future__ import annotations
+
+import glob
+import os
+
+import numpy as np
+
+from .bitmask import BitMask, as_bitmask
+
+try:
+    from . import fluid_native
+    NATIVE_AVAILABLE = True
+except Exception:
+    fluid_native = None
+    NATIVE_AVAILABLE = False
+
+
+# Sparse storage costs ~180 bytes per fluid cell (populations + neighbour
+# table) against ~100 bytes per grid cell dense, so it pays off below ~55%
+# fluid. Thin flumes voxelize to well under that.
+SPARSE_FLUID_FRACTION = 0.5
+
+# Population storage formats, see native/src/population_codec.hpp.
+PRECISIONS = ("fp32", "fp16", "bf16")
+
+# Page backing for the engine's large arrays, see native/src/numa.hpp.
+HUGE_PAGES = ("off", "transparent", "explicit")
+
+
+def _cpu_list(text: str) -> list[int]:
+    cpus = []
+    for part in text.strip().split(","):
+        if part:
+            lo, _, hi = part.partition("-")
+            cpus.extend(range(int(lo), int(hi or lo) + 1))
+    return cpus
+
+
+def numa_nodes() -> dict[int, list[int]]:
+    """CPUs this process may run on, per NUMA node ({} where the OS does not say; Linux only)."""
+    allowed = os.sched_getaffinity(0) if hasattr(os, "sched_getaffinity") else None
+    nodes = {}
+    for path in glob.glob("/sys/devices/system/node/node[0-9]*/cpulist"):
+        node = int(os.path.basename(os.path.dirname(path))[4:])
+        with open(path) as f:
+            cpus = [c for c in _cpu_list(f.read()) if allowed is None or c in allowed]
+        if cpus:
+            nodes[node] = cpus
+    return dict(sorted(nodes.items()))
+
+
+def thread_cpus(nodes: dict[int, list[int]] | None = None) -> list[int]:
+    """
+    CPU for each OpenMP thread, taken from the nodes in turn so that any
+    thread count spreads over all sockets (and their memory controllers).
+    The kernel lists physical cores before their hyperthreads.
+    """
+    nodes = numa_nodes() if nodes is None else nodes
+    if not nodes:
+        return list(range(os.cpu_count() or 1))
+    lists = list(nodes.values())
+    return [lst[i] for i in range(max(map(len, lists))) for lst in lists if i < len(lst)]
+
+
+def page_placement(array: np.ndarray) -> dict[int, float]:
+    """Share of the array's resident pages on each NUMA node ({} if unknown)."""
+    nodes = fluid_native.page_nodes(array)
+    nodes = nodes[nodes >= 0]
+    if len(nodes) == 0:
+        return {}
+    counts = np.bincount(nodes)
+    return {int(n): float(c) / len(nodes) for n, c in enumerate(counts) if c}
+
+
+class LbmD3Q19Native:
+    """
+    Same interface as LbmD3Q19Torch, backed by fluid_native.LbmEngine.
+
+    sparse=None picks the layout from the fluid fraction. The layout is a
+    storage choice only: the sparse one does not store solid cells, and both
+    bounce populations back half-way on wall links, like the torch solver,
+    and give the same fields (tests/test_lattice_layouts.py).
+
+    precision="fp16" / "bf16" stores populations in 16 bits (as f_q - w_q) and
+    still computes in fp32; bench/bench_precision.py measures what that costs
+    in velocity accuracy.
+
+    temporal_block=(steps, tile_y) runs `steps` steps per pass over y-tiles of
+    `tile_y` rows (dense layout only, ignored on sparse; results are bitwise
+    identical). Off by default; bench/bench_tiling.py measures whether it pays
+    on a given machine.
+
+    pin_threads pins OpenMP thread t to one core while the engine places its
+    arrays and during each run() (None: only on machines with more than one
+    NUMA node), so the pages each thread first touched stay local to it; the
+    threads' previous affinity is restored in between. cpus pins to that list
+    instead (thread t on cpus[t % len(cpus)]), e.g. a slice of the machine
+    that no other run uses. huge_pages="transparent" or "explicit" backs this
+    engine's large arrays with huge pages (see native/src/numa.hpp).
+    """
+
+    def __init__(
+        self,
+        *,
+        nx: int,
+        ny: int,
+        nz: int,
+        nu_lbm: float,
+        solid: BitMask | np.ndarray,
+        inlet: BitMask | np.ndarray,
+        outlet: BitMask | np.ndarray,
+        gravity_lbm: np.ndarray | None = None,
+        threads: int | None = None,
+        sparse: bool | None = None,
+        precision: str = "fp32",
+        temporal_block: tuple[int, int] | None = None,
+        pin_threads: bool | None = None,
+        huge_pages: str = "off",
+        cpus: list[int] | None = None,
+    ):
+        if not NATIVE_AVAILABLE:
+            raise RuntimeError("fluid_native is not built. See backend/README.md (Native CPU solver).")
+
+        if precision not in PRECISIONS:
+            raise ValueError(f"precision must be one of {PRECISIONS}, got {precision!r}")
+        if huge_pages not in HUGE_PAGES:
+            raise ValueError(f"huge_pages must be one of {HUGE_PAGES}, got {huge_pages!r}")
+        if threads:
+            fluid_native.set_num_threads(int(threads))
+
+        gravity = np.zeros(3, dtype=np.float32) if gravity_lbm is None else np.asarray(gravity_lbm, dtype=np.float32)
+
+        self.nx, self.ny, self.nz = int(nx), int(ny), int(nz)
+        self.solid = as_bitmask(solid)
+        inlet, outlet = as_bitmask(inlet), as_bitmask(outlet)
+        total = self.nx * self.ny * self.nz
+        n_fluid = total - self.solid.count()
+        if sparse is None:
+            sparse = n_fluid < SPARSE_FLUID_FRACTION * total
+        nodes = numa_nodes()
+        if cpus:
+            pin_threads = True
+        elif pin_threads is None:
+            pin_threads = len(nodes) > 1
+        self.engine = fluid_native.LbmEngine(
+            nx=self.nx,
+            ny=self.ny,
+            nz=self.nz,
+            nu_lbm=float(nu_lbm),
+            solid=self.solid.words,
+            inlet=inlet.words,
+            outlet=outlet.words,
+            gravity_lbm=gravity.tolist(),
+            sparse=bool(sparse),
+            precision=precision,
+            cpus=[int(c) for c in cpus] if cpus else thread_cpus(nodes) if pin_threads else [],
+            huge_pages=huge_pages,
+        )
+        if temporal_block and not self.engine.sparse:
+            self.engine.set_temporal_blocking(int(temporal_block[0]), int(temporal_block[1]))
+        self.nu = float(nu_lbm)
+        self.tau = float(self.engine.tau)
+        self.omega = float(self.engine.omega)
+
+        print(f"[LBM] Using device: native CPU ({fluid_native.max_threads()} threads, {fluid_native.kernel_isa()} kernel)")
+        print(f"[LBM] Lattice: {'sparse' if self.engine.sparse else 'dense'} ({self.engine.stored_cells:,} stored cells, {self.engine.precision} populations)")
+        print(f"[LBM] Gravity (lattice units): {gravity}")
+        print(f"[LBM] Grid: {self.nx}x{self.ny}x{self.nz} = {total:,} cells")
+        print(f"[LBM] Fluid: {n_fluid:,} ({100*n_fluid/total:.1f}%)")
+        if self.engine.block_steps > 1:
+            print(f"[LBM] Temporal blocking: {self.engine.block_steps} steps per pass, {self.engine.block_tile_y}-row tiles")
+        print(f"[LBM] Memory: {self.engine.memory_bytes / 1e6:.1f} MB")
+        if len(nodes) > 1 or pin_threads:
+            placement = page_placement(self.engine.populations)
+            print(f"[LBM] NUMA: {len(nodes) or 1} node(s), threads {'pinned' if pin_threads else 'not pinned'}, "
+                  f"{huge_pages} huge pages, populations "
+                  + (", ".join(f"{100 * v:.0f}% on node {n}" for n, v in placement.items()) or "placement unknown"))
+        print(f"[LBM] tau={self.tau:.4f}, omega={self.omega:.4f}")
+
+    def set_inlet_direction(self, direction_xyz: np.ndarray):
+        """Set the inlet velocity direction (normalized)."""
+        self.engine.set_inlet_direction(np.asarray(direction_xyz, dtype=np.float32).tolist())
+
+    def set_gravity_lbm(self, gravity_lbm: np.ndarray):
+        """Set gravity body force in lattice units."""
+        self.engine.set_gravity(np.asarray(gravity_lbm, dtype=np.float32).tolist())
+
+    def step(self, *, inlet_speed: float, update_fill: bool = True):
+        """Perform one LBM timestep."""
+        self.engine.run(1, float(inlet_speed), bool(update_fill))
+
+    def run(self, steps: int, *, inlet_speed: float, update_fill: bool = True, measure_residual: bool = False):
+        """
+        Perform several timesteps without returning to Python in between.
+
+        With measure_residual, returns the relative velocity change of the last
+        step (reduced inside the native sweep, no extra pass over the grid).
+        """
+        self.engine.run(int(steps), float(inlet_speed), bool(update_fill), bool(measure_residual))
+        return float(self.engine.residual) if measure_residual else None
+
+    def checkpoint_state(self):
+        """
+        Solver state for sim/checkpoint.py as (arrays, parity). The arrays are
+        zero-copy views of the engine's populations (as stored, uint16 for
+        fp16/bf16) and fill level.
+        """
+        arrays = {"populations": self.engine.populations, "fill": self.engine.fill_state}
+        return arrays, int(self.engine.odd_next)
+
+    def restore_checkpoint(self, arrays: dict, iteration: int, parity: int):
+        """Load a state saved by checkpoint_state() after `iteration` steps."""
+        np.copyto(self.engine.populations, arrays["populations"])
+        np.copyto(self.engine.fill_state, arrays["fill"])
+        self.engine.restore_progress(int(iteration), bool(parity))
+
+    def init_from_fields(self, rho: np.ndarray, ux: np.ndarray, uy: np.ndarray, uz: np.ndarray, fill: np.ndarray):
+        """Start from given (nx, ny, nz) fields instead of rest (see sim/warm_start.py)."""
+        self.engine.init_from_fields(rho, ux, uy, uz, fill)
+
+    def density_cpu(self):
+        """Get density field as a numpy array."""
+        return self.engine.rho()
+
+    def velocity_cpu(self):
+        """Get velocity field as numpy arrays."""
+        ux_np = self.engine.ux()
+        uy_np = self.engine.uy()
+        uz_np = self.engine.uz()
+        return (ux_np, uy_np, uz_np)
+
+    def fill_level_cpu(self):
+        """Get fill level as a numpy array."""
+        return self.engine.fill_level()
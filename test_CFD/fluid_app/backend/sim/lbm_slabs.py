@@ -0,0 +1,430 @@
+"""
+Native D3Q19 LBM split across processes (slab decomposition along x).
+
+Same interface as LbmD3Q19Native, for grids whose step time (or memory per
+process) calls for more than one engine:
+- Rank r of `ranks` worker processes owns the x planes slab_bounds(nx, r, ranks)
+  in its own dense fluid_native.LbmEngine, plus one ghost plane per side
+- Halos go through fluid_native.SharedMemoryHalo, a multiprocessing.shared_memory
+  block with one mailbox per neighbour and message kind; the interior planes
+  are swept while the edge planes travel (see native/src/slab_lbm.hpp)
+- Bitwise the same populations and fields as one dense engine; the residual
+  only differs by the order its sums are reduced in
+- Each rank gets its own slice of the CPUs (threads pinned when there are
+  enough cores), so ranks stay on one NUMA node and first-touch their own slab
+
+The coordinator (this object) only sends commands over pipes; fields are
+gathered from the ranks' owned planes when asked for, and checkpoints are
+written and read by the ranks straight into / from the checkpoint file. A rank
+whose command fails, or that dies or stops answering, aborts the halo
+exchange, so the others do not spin forever waiting for it. A transport for
+ranks on several machines (MPI) plugs into the same native SlabLbm - see
+native/src/slab_lbm.hpp.
+"""
+from __future__ import annotations
+
+import multiprocessing as mp
+import time
+import traceback
+import weakref
+from multiprocessing import connection, shared_memory
+
+import numpy as np
+
+from .bitmask import BitMask, as_bitmask
+from .lbm_native import NATIVE_AVAILABLE, PRECISIONS, fluid_native, numa_nodes
+
+
+# A call that has not been answered by every rank after this long is taken as
+# hung; ranks are also checked for having died every POLL_S.
+REPLY_TIMEOUT_S = 600.0
+POLL_S = 1.0
+
+
+def _rank_cpus(ranks: int, threads: int, cpus: list[int] | None = None) -> list[list[int]] | None:
+    """Disjoint CPUs for each rank out of `cpus` (default: all, node by node; None if there are too few to pin)."""
+    if not cpus:
+        cpus = [c for cs in numa_nodes().values() for c in cs]
+    if len(cpus) < ranks * threads:
+        return None
+    return [cpus[r * threads:(r + 1) * threads] for r in range(ranks)]
+
+
+def _with_ghosts(grid: np.ndarray, x0: int, x1: int) -> np.ndarray:
+    """Planes x0 - 1 .. x1 of a periodic (nx, ...) grid: the slab and its ghost planes."""
+    return np.ascontiguousarray(np.take(grid, np.arange(x0 - 1, x1 + 1) % grid.shape[0], axis=0))
+
+
+class _Rank:
+    """One rank's engine and halo, living in a worker process."""
+
+    def __init__(self, spec: dict):
+        if spec["threads"]:
+            fluid_native.set_num_threads(spec["threads"])
+        self.nx, self.x0 = spec["nx"], spec["x0"]  # global grid, first owned plane
+        self.shm = shared_memory.SharedMemory(name=spec["halo_name"])
+        self.engine = fluid_native.LbmEngine(
+            nx=spec["planes"] + 2,
+            ny=spec["ny"],
+            nz=spec["nz"],
+            nu_lbm=spec["nu_lbm"],
+            solid=spec["solid"],
+            inlet=spec["inlet"],
+            outlet=spec["outlet"],
+            gravity_lbm=spec["gravity_lbm"],
+            sparse=False,
+            precision=spec["precision"],
+            cpus=spec["cpus"],
+        )
+        self.engine.set_ghost_planes(True)
+        self.halo = fluid_native.SharedMemoryHalo(self.shm.buf, spec["rank"], spec["ranks"], spec["capacity"])
+        self.slab = fluid_native.SlabLbm(self.engine, self.halo)
+
+    def info(self):
+        return {"memory_bytes": self.engine.memory_bytes, "tau": self.engine.tau, "omega": self.engine.omega,
+                "threads": fluid_native.max_threads(), "kernel": fluid_native.kernel_isa()}
+
+    def set_inlet_direction(self, direction):
+        self.engine.set_inlet_direction(direction)
+
+    def set_gravity(self, gravity):
+        self.engine.set_gravity(gravity)
+
+    def run(self, steps, inlet_speed, update_fill, measure_residual):
+        self.slab.run(steps, inlet_speed, update_fill, measure_residual)
+        sums = tuple(self.engine.residual_sums) if measure_residual else None
+        return sums, self.slab.wait_seconds
+
+    def fields(self, names):
+        return {name: getattr(self.engine, name)()[1:-1] for name in names}
+
+    def _owned(self, array: np.ndarray) -> np.ndarray:
+        return array.reshape(array.shape[:-1] + (self.engine.nx, -1))[..., 1:-1, :]
+
+    def state(self):
+        self.slab.sync()
+        return (self._owned(self.engine.populations).copy(), self._owned(self.engine.fill_state).copy(),
+                self.engine.odd_next)
+
+    def restore(self, populations, fill, iteration, parity):
+        self.slab.sync()  # drop slots still travelling from the old state
+        self._owned(self.engine.populations)[...] = populations
+        self._owned(self.engine.fill_state)[...] = fill
+        self.engine.restore_progress(iteration, parity)
+
+    def _file_views(self, path, offsets, mode):
+        """This rank's planes of the checkpoint arrays in the file at `path` (one dense engine's layout)."""
+        pops = self._owned(self.engine.populations)
+        x0, x1, plane = self.x0, self.x0 + pops.shape[1], pops.shape[2]
+        f = np.memmap(path, dtype=pops.dtype, mode=mode, offset=offsets["populations"], shape=(19, self.nx, plane))
+        fill = np.memmap(path, dtype=np.float32, mode=mode, offset=offsets["fill"], shape=(self.nx, plane))
+        return f[:, x0:x1], fill[x0:x1]
+
+    def write_state(self, path, offsets):
+        self.slab.sync()
+        pops, fill = self._file_views(path, offsets, "r+")
+        pops[...] = self._owned(self.engine.populations)
+        fill[...] = self._owned(self.engine.fill_state)
+        # No flush here: the coordinator's flush writes the file's dirty pages.
+        return self.engine.odd_next
+
+    def read_state(self, path, offsets, iteration, parity):
+        self.restore(*self._file_views(path, offsets, "r"), iteration, parity)
+
+    def init_from_fields(self, rho, ux, uy, uz, fill):
+        self.slab.sync()
+        self.engine.init_from_fields(rho, ux, uy, uz, fill)
+
+    def abort(self):
+        self.halo.abort()
+
+    def close(self):
+        del self.slab, self.halo, self.engine
+        self.shm.close()
+
+
+def _rank_main(conn, spec: dict):
+    try:
+        rank = _Rank(spec)
+        conn.send(("ok", rank.info()))
+    except Exception:
+        conn.send(("error", traceback.format_exc()))
+        return
+    while True:
+        cmd, args = conn.recv()
+        if cmd == "close":
+            rank.close()
+            return
+        try:
+            conn.send(("ok", getattr(rank, cmd)(*args)))
+        except Exception:
+            rank.abort()  # neighbours waiting on our halo would never get it
+            conn.send(("error", traceback.format_exc()))
+
+
+def _shutdown(procs, conns, shm):
+    for conn in conns:
+        try:
+            conn.send(("close", ()))
+        except (BrokenPipeError, OSError):
+            pass
+    for p in procs:
+        p.join(timeout=5)
+        if p.is_alive():
+            p.terminate()
+    shm.close()
+    shm.unlink()
+
+
+class LbmD3Q19Slabs:
+    """
+    Same interface as LbmD3Q19Native, split over `ranks` processes along x.
+
+    Always the dense layout. threads is per rank (default: the CPUs divided
+    among the ranks); pin_threads=None pins each rank's threads to its own
+    cores when every rank gets whole cores. cpus restricts the ranks to that
+    list (split among them, and pinned). The ranks run every call in
+    lockstep, so each one blocks until all of them are done. close() (or
+    dropping the object) stops the workers.
+    """
+
+    def __init__(
+        self,
+        *,
+        nx: int,
+        ny: int,
+        nz: int,
+        nu_lbm: float,
+        solid: BitMask | np.ndarray,
+        inlet: BitMask | np.ndarray,
+        outlet: BitMask | np.ndarray,
+        gravity_lbm: np.ndarray | None = None,
+        ranks: int = 2,
+        threads: int | None = None,
+        precision: str = "fp32",
+        pin_threads: bool | None = None,
+        cpus: list[int] | None = None,
+    ):
+        if not NATIVE_AVAILABLE:
+            raise RuntimeError("fluid_native is not built. See backend/README.md (Native CPU solver).")
+        if precision not in PRECISIONS:
+            raise ValueError(f"precision must be one of {PRECISIONS}, got {precision!r}")
+        if not 1 <= int(ranks) <= int(nx):
+            raise ValueError(f"ranks must be between 1 and nx={nx}, got {ranks}")
+
+        gravity = np.zeros(3, dtype=np.float32) if gravity_lbm is None else np.asarray(gravity_lbm, dtype=np.float32)
+        self.nx, self.ny, self.nz = int(nx), int(ny), int(nz)
+        self.ranks = int(ranks)
+        self.solid = as_bitmask(solid)
+        inlet, outlet = as_bitmask(inlet), as_bitmask(outlet)
+        self.bounds = [fluid_native.slab_bounds(self.nx, r, self.ranks) for r in range(self.ranks)]
+
+        available = len(cpus) if cpus else sum(len(c) for c in numa_nodes().values()) or mp.cpu_count()
+        threads = int(threads or max(1, available // self.ranks))
+        if cpus:
+            pin_threads = True
+        rank_cpus = _rank_cpus(self.ranks, threads, cpus) if pin_threads is not False else None
+        if pin_threads and rank_cpus is None:
+            print(f"[LBM] Not enough CPUs to pin {self.ranks} x {threads} threads - running unpinned")
+
+        capacity = fluid_native.halo_capacity(self.ny, self.nz, precision)
+        self._shm = shared_memory.SharedMemory(create=True, size=fluid_native.halo_region_bytes(self.ranks, capacity))
+        ctx = mp.get_context("spawn")
+        self._procs, self._conns = [], []
+        self._finalizer = weakref.finalize(self, _shutdown, self._procs, self._conns, self._shm)
+        for r, (x0, x1) in enumerate(self.bounds):
+            spec = {
+                "rank": r,
+                "nx": self.nx,
+                "x0": x0,
+                "ranks": self.ranks,
+                "planes": x1 - x0,
+                "ny": self.ny,
+                "nz": self.nz,
+                "nu_lbm": float(nu_lbm),
+                "solid": _with_ghosts(self.solid.words, x0, x1),
+                "inlet": _with_ghosts(inlet.words, x0, x1),
+                "outlet": _with_ghosts(outlet.words, x0, x1),
+                "gravity_lbm": gravity.tolist(),
+                "precision": precision,
+                "threads": threads,
+                "cpus": rank_cpus[r] if rank_cpus else [],
+                "halo_name": self._shm.name,
+                "capacity": capacity,
+            }
+            parent, child = ctx.Pipe()
+            proc = ctx.Process(target=_rank_main, args=(child, spec), daemon=True, name=f"lbm-rank-{r}")
+            proc.start()
+            child.close()
+            self._procs.append(proc)
+            self._conns.append(parent)
+        info = self._collect()
+
+        self.precision = precision
+        self.nu = float(nu_lbm)
+        self.tau = float(info[0]["tau"])
+        self.omega = float(info[0]["omega"])
+        self.steps_done = 0
+        self.halo_wait_seconds = [0.0] * self.ranks
+        self.memory_bytes = sum(i["memory_bytes"] for i in info)
+
+        total = self.nx * self.ny * self.nz
+        n_fluid = total - self.solid.count()
+        planes = [x1 - x0 for x0, x1 in self.bounds]
+        print(f"[LBM] Using device: native CPU, {self.ranks} slab ranks x {info[0]['threads']} threads "
+              f"({info[0]['kernel']} kernel, threads {'pinned' if rank_cpus else 'not pinned'})")
+        print(f"[LBM] Lattice: dense, {min(planes)}-{max(planes)} x planes per rank + 2 ghost planes, "
+              f"{precision} populations, {capacity / 1e6:.2f} MB halo messages")
+        print(f"[LBM] Gravity (lattice units): {gravity}")
+        print(f"[LBM] Grid: {self.nx}x{self.ny}x{self.nz} = {total:,} cells")
+        print(f"[LBM] Fluid: {n_fluid:,} ({100*n_fluid/total:.1f}%)")
+        print(f"[LBM] Memory: {self.memory_bytes / 1e6:.1f} MB over {self.ranks} ranks")
+        print(f"[LBM] tau={self.tau:.4f}, omega={self.omega:.4f}")
+
+    def _collect(self) -> list:
+        """
+        One reply per rank. The first rank that fails, dies or leaves the call
+        unanswered for REPLY_TIMEOUT_S aborts the halo exchange (releasing
+        ranks blocked on it) and closes the solver.
+        """
+        replies = {}
+        deadline = time.monotonic() + REPLY_TIMEOUT_S
+        failed = None
+        while len(replies) < self.ranks and failed is None:
+            waiting = {self._conns[r]: r for r in range(self.ranks) if r not in replies}
+            for conn in connection.wait(list(waiting), timeout=POLL_S):
+                try:
+                    replies[waiting[conn]] = conn.recv()
+                except EOFError:
+                    replies[waiting[conn]] = ("error", "worker process exited")
+            for r in waiting.values():
+                if r not in replies and not self._procs[r].is_alive():
+                    replies[r] = ("error", f"worker process exited with code {self._procs[r].exitcode}")
+            failed = next(((r, body) for r, (status, body) in sorted(replies.items()) if status != "ok"), None)
+            if failed is None and len(replies) < self.ranks and time.monotonic() > deadline:
+                failed = (min(set(range(self.ranks)) - set(replies)), f"no reply within {REPLY_TIMEOUT_S:.0f} s")
+        if failed is not None:
+            fluid_native.halo_abort(self._shm.buf)
+            self.close()
+            rank, tb = failed
+            raise RuntimeError(f"LBM slab rank {rank} failed:\n{tb}")
+        return [replies[r][1] for r in range(self.ranks)]
+
+    def _call(self, cmd: str, *args) -> list:
+        for conn in self._conns:
+            conn.send((cmd, args))
+        return self._collect()
+
+    def _call_each(self, cmd: str, args: list[tuple]) -> list:
+        for conn, a in zip(self._conns, args):
+            conn.send((cmd, a))
+        return self._collect()
+
+    def close(self):
+        """Stop the worker processes and free the halo block."""
+        self._finalizer()
+
+    def set_inlet_direction(self, direction_xyz: np.ndarray):
+        """Set the inlet velocity direction (normalized)."""
+        self._call("set_inlet_direction", np.asarray(direction_xyz, dtype=np.float32).tolist())
+
+    def set_gravity_lbm(self, gravity_lbm: np.ndarray):
+        """Set gravity body force in lattice units."""
+        self._call("set_gravity", np.asarray(gravity_lbm, dtype=np.float32).tolist())
+
+    def step(self, *, inlet_speed: float, update_fill: bool = True):
+        """Perform one LBM timestep."""
+        self.run(1, inlet_speed=inlet_speed, update_fill=update_fill)
+
+    def run(self, steps: int, *, inlet_speed: float, update_fill: bool = True, measure_residual: bool = False):
+        """
+        Perform several timesteps on every rank without returning in between.
+
+        With measure_residual, returns the relative velocity change of the last
+        step, reduced over the ranks' sums.
+        """
+        replies = self._call("run", int(steps), float(inlet_speed), bool(update_fill), bool(measure_residual))
+        self.steps_done += int(steps)
+        self.halo_wait_seconds = [wait for _, wait in replies]
+        if not measure_residual:
+            return None
+        du = sum(sums[0] for sums, _ in replies)
+        u = sum(sums[1] for sums, _ in replies)
+        return float(np.sqrt(du / u)) if u > 0 else float("inf")
+
+    def _gather(self, *names: str) -> dict[str, np.ndarray]:
+        out = {name: np.empty((self.nx, self.ny, self.nz), dtype=np.float32) for name in names}
+        for (x0, x1), parts in zip(self.bounds, self._call("fields", names)):
+            for name in names:
+                out[name][x0:x1] = parts[name]
+        return out
+
+    def checkpoint_layout(self) -> dict[str, np.ndarray]:
+        """
+        Arrays of checkpoint_state() with their dtype and shape but no memory
+        (broadcast zeros), as the template for a SolverCheckpoint.
+        """
+        dtype = np.float32 if self.precision == "fp32" else np.uint16
+        cells = self.nx * self.ny * self.nz
+        return {"populations": np.broadcast_to(np.zeros((), dtype), (19, cells)),
+                "fill": np.broadcast_to(np.zeros((), np.float32), (cells,))}
+
+    def save_checkpoint(self, ckpt, iteration: int):
+        """
+        ckpt.save() without the state passing through this process: each rank
+        writes its planes into the spare slot of the checkpoint file, in the
+        layout of one dense engine (so a checkpoint does not depend on the
+        rank count), and only the parity comes back.
+        """
+        offsets = ckpt.begin_save()
+        if offsets is None:
+            return
+        parity = self._call("write_state", str(ckpt.path), offsets)[0]
+        ckpt.commit_save(int(iteration), int(parity))
+
+    def load_checkpoint(self, ckpt, iteration: int, parity: int):
+        """restore_checkpoint() from the state ckpt.load() found, read by each rank straight from the file."""
+        self._call("read_state", str(ckpt.path), ckpt.loaded_offsets(), int(iteration), bool(parity))
+        self.steps_done = int(iteration)
+
+    def checkpoint_state(self):
+        """
+        Solver state for sim/checkpoint.py as (arrays, parity), gathered from
+        the ranks into the layout of one dense engine. Holds the whole state
+        in this process; save_checkpoint() does not.
+        """
+        plane = self.ny * self.nz
+        parts = self._call("state")
+        pops = np.empty((19, self.nx * plane), dtype=parts[0][0].dtype)
+        fill = np.empty(self.nx * plane, dtype=np.float32)
+        for (x0, x1), (p, f, _) in zip(self.bounds, parts):
+            pops.reshape(19, self.nx, plane)[:, x0:x1] = p
+            fill.reshape(self.nx, plane)[x0:x1] = f
+        return {"populations": pops, "fill": fill}, int(parts[0][2])
+
+    def restore_checkpoint(self, arrays: dict, iteration: int, parity: int):
+        """Load a state saved by checkpoint_state() after `iteration` steps."""
+        plane = self.ny * self.nz
+        pops = np.asarray(arrays["populations"]).reshape(19, self.nx, plane)
+        fill = np.asarray(arrays["fill"]).reshape(self.nx, plane)
+        self._call_each("restore", [(pops[:, x0:x1], fill[x0:x1], int(iteration), bool(parity))
+                                    for x0, x1 in self.bounds])
+        self.steps_done = int(iteration)
+
+    def init_from_fields(self, rho: np.ndarray, ux: np.ndarray, uy: np.ndarray, uz: np.ndarray, fill: np.ndarray):
+        """Start from given (nx, ny, nz) fields instead of rest (see sim/warm_start.py)."""
+        grids = [np.asarray(a, dtype=np.float32).reshape(self.nx, self.ny, self.nz) for a in (rho, ux, uy, uz, fill)]
+        self._call_each("init_from_fields", [tuple(_with_ghosts(g, x0, x1) for g in grids) for x0, x1 in self.bounds])
+
+    def density_cpu(self):
+        """Get density field as a numpy array."""
+        return self._gather("rho")["rho"]
+
+    def velocity_cpu(self):
+        """Get velocity field as numpy arrays."""
+        u = self._gather("ux", "uy", "uz")
+        return (u["ux"], u["uy"], u["uz"])
+
+    def fill_level_cpu(self):
+        """Get fill level as a numpy array."""
+        return self._gather("fill_level")["fill_level"]
@@ -13,6 +13,9 @@ from __future__ import annotations
 
 import numpy as np
 
+from .bitmask import BitMask, as_bitmask
+from .domain_cache import LinkList
+
 try:
     import torch
     TORCH_AVAILABLE = True
@@ -21,11 +24,31 @@ except Exception:
     TORCH_AVAILABLE = False
 
 
+def build_wall_links(solid: BitMask | np.ndarray) -> LinkList:
+    """Links from fluid cells into solid ones, per direction (periodic wrap like the streaming)."""
+    solid = as_bitmask(solid)
+    fluid = ~solid
+    offsets = [0]
+    cells = []
+    for c in LbmD3Q19Torch._c_np:
+        if not c.any():
+            offsets.append(offsets[-1])  # rest population has no link
+            continue
+        into_solid = solid.roll(tuple(int(-v) for v in c))  # solid[x + c]
+        idx = (fluid & into_solid).set_indices().astype(np.int32)
+        cells.append(idx)
+        offsets.append(offsets[-1] + len(idx))
+    return LinkList(
+        offsets=np.asarray(offsets, dtype=np.int64),
+        cells=np.concatenate(cells) if cells else np.zeros(0, dtype=np.int32),
+    )
+
+
 class LbmD3Q19Torch:
     """
     D3Q19 Lattice Boltzmann solver with:
     - BGK collision operator
-    - Bounce-back solid boundaries
+    - Half-way bounce-back on fluid-to-solid links (cost follows the wall area)
     - GRAVITY BODY FORCE (Guo forcing scheme) - this is the key for realistic flow!
     - Free surface tracking for filling simulation
     """
@@ -70,10 +93,13 @@ class LbmD3Q19Torch:
         ny: int,
         nz: int,
         nu_lbm: float,
-        solid: np.ndarray,
-        inlet: np.ndarray,
-        outlet: np.ndarray,
+        solid: BitMask | np.ndarray,
+        inlet: BitMask | np.ndarray,
+        outlet: BitMask | np.ndarray,
         gravity_lbm: np.ndarray | None = None,
+        wall_links: LinkList | None = None,
+        inlet_cells: np.ndarray | None = None,
+        outlet_cells: np.ndarray | None = None,
     ):
         """
         Initialize the LBM solver.
@@ -81,10 +107,13 @@ class LbmD3Q19Torch:
         Args:
             nx, ny, nz: Grid dimensions
             nu_lbm: Kinematic viscosity in lattice units (typically 0.01-0.2)
-            solid: Boolean mask of solid cells (nx, ny, nz)
-            inlet: Boolean mask of inlet cells
-            outlet: Boolean mask of outlet cells  
+            solid: Mask of solid cells (nx, ny, nz), a BitMask or bool array
+            inlet: Mask of inlet cells
+            outlet: Mask of outlet cells
             gravity_lbm: Gravity vector in lattice units (scaled from physical)
+            wall_links, inlet_cells, outlet_cells: boundary lists as built once
+                per domain (Domain.wall_links / inlet_cells / outlet_cells);
+                derived from the masks when not given
         """
         if not TORCH_AVAILABLE:
             raise RuntimeError("PyTorch is not available. Install torch with CUDA for GPU compute.")
@@ -108,12 +137,36 @@ class LbmD3Q19Torch:
         self.w = torch.tensor(self._w_np, device=self.device, dtype=torch.float32)
         self.opposite = torch.tensor(self._opp_np, device=self.device, dtype=torch.int64)
 
-        # Masks
-        self.solid = torch.tensor(solid.astype(np.bool_), device=self.device)
-        self.inlet = torch.tensor(inlet.astype(np.bool_), device=self.device)
-        self.outlet = torch.tensor(outlet.astype(np.bool_), device=self.device)
+        # Masks (one byte per cell on the device; the tensors index with them)
+        solid, inlet, outlet = as_bitmask(solid), as_bitmask(inlet), as_bitmask(outlet)
+        self.solid = torch.tensor(solid.to_bool(), device=self.device)
+        self.inlet = torch.tensor(inlet.to_bool(), device=self.device)
+        self.outlet = torch.tensor(outlet.to_bool(), device=self.device)
         self.fluid = ~self.solid
 
+        # Boundary lists as flat indices into f.view(-1) / the (nx, ny, nz)
+        # fields, so each step touches boundary cells only.
+        shape = (self.nx, self.ny, self.nz)
+        n = self.nx * self.ny * self.nz
+        if wall_links is None:
+            wall_links = build_wall_links(solid)
+        src, dst = [], []
+        for q in range(1, 19):
+            x = wall_links.direction(q).astype(np.int64)
+            i, j, k = np.unravel_index(x, shape)
+            y = np.ravel_multi_index(((i + self._c_np[q, 0]) % self.nx, (j + self._c_np[q, 1]) % self.ny,
+                                      (k + self._c_np[q, 2]) % self.nz), shape)
+            src.append(q * n + y)  # f_q streamed from x into the wall cell
+            dst.append(self._opp_np[q] * n + x)  # comes back to x as f_opp(q)
+        self._wall_src = torch.tensor(np.concatenate(src), device=self.device)
+        self._wall_dst = torch.tensor(np.concatenate(dst), device=self.device)
+        if inlet_cells is None:
+            inlet_cells = inlet.set_indices()
+        if outlet_cells is None:
+            outlet_cells = outlet.set_indices()
+        self._inlet_cells = torch.tensor(np.asarray(inlet_cells, dtype=np.int64), device=self.device)
+        self._outlet_cells = torch.tensor(np.asarray(outlet_cells, dtype=np.int64), device=self.device)
+
         # Gravity body force in lattice units - THIS IS KEY FOR REALISTIC FLOW
         if gravity_lbm is None:
             self.gravity = torch.zeros(3, device=self.device, dtype=torch.float32)
@@ -145,15 +198,16 @@ class LbmD3Q19Torch:
         self.f = self._equilibrium(self.rho, self.ux, self.uy, self.uz)
 
         # Stats
-        n_solid = int(self.solid.sum())
-        n_fluid = int(self.fluid.sum())
-        n_inlet = int(self.inlet.sum())
-        n_outlet = int(self.outlet.sum())
         total = self.nx * self.ny * self.nz
+        n_solid = solid.count()
+        n_fluid = total - n_solid
+        n_inlet = inlet.count()
+        n_outlet = outlet.count()
         print(f"[LBM] Grid: {self.nx}x{self.ny}x{self.nz} = {total:,} cells")
         print(f"[LBM] Solid: {n_solid:,} ({100*n_solid/total:.1f}%)")
         print(f"[LBM] Fluid: {n_fluid:,} ({100*n_fluid/total:.1f}%)")
         print(f"[LBM] Inlet: {n_inlet:,}, Outlet: {n_outlet:,}")
+        print(f"[LBM] Wall links: {len(self._wall_src):,}")
         print(f"[LBM] tau={self.tau:.4f}, omega={self.omega:.4f}")
 
     def set_inlet_direction(self, direction_xyz: np.ndarray):
@@ -223,30 +277,23 @@ class LbmD3Q19Torch:
         self.f = f_new
 
     def _apply_boundaries(self, inlet_speed: float):
-        """Apply boundary conditions: bounce-back, inlet, outlet."""
-        # Bounce-back on solid boundaries
-        solid_mask = self.solid
-        for q in range(19):
-            opp_q = int(self.opposite[q])
-            self.f[q][solid_mask] = self.f[opp_q][solid_mask]
-
-        # Inlet: set equilibrium with prescribed velocity
-        if bool(torch.any(self.inlet)):
-            inlet_rho = 1.0
-            self.rho[self.inlet] = inlet_rho
-            self.ux[self.inlet] = self.inlet_dir[0] * inlet_speed
-            self.uy[self.inlet] = self.inlet_dir[1] * inlet_speed
-            self.uz[self.inlet] = self.inlet_dir[2] * inlet_speed
-
-            feq_inlet = self._equilibrium(self.rho, self.ux, self.uy, self.uz)
-            for q in range(19):
-                self.f[q][self.inlet] = feq_inlet[q][self.inlet]
-
-            self.fill_level[self.inlet] = 1.0
+        """Apply boundary conditions from the precomputed lists: bounce-back, inlet, outlet."""
+        # Bounce-back: what streamed from a fluid cell into a wall returns to
+        # it in the opposite direction (all links in one gather/scatter)
+        f = self.f.view(-1)
+        f[self._wall_dst] = f[self._wall_src]
+
+        # Inlet: equilibrium with the prescribed velocity (the same for every inlet cell)
+        if len(self._inlet_cells):
+            one = torch.ones(1, device=self.device, dtype=torch.float32)
+            u = self.inlet_dir * inlet_speed
+            feq_inlet = self._equilibrium(one, u[0:1], u[1:2], u[2:3]).view(19, 1)
+            self.f.view(19, -1)[:, self._inlet_cells] = feq_inlet
+            self.fill_level.view(-1)[self._inlet_cells] = 1.0
 
         # Outlet: fixed pressure
-        if bool(torch.any(self.outlet)):
-            self.rho[self.outlet] = 1.0
+        if len(self._outlet_cells):
+            self.rho.view(-1)[self._outlet_cells] = 1.0
 
     def _compute_macroscopic(self):
         """Compute macroscopic quantities with Guo forcing correction."""
@@ -298,22 +345,60 @@ class LbmD3Q19Torch:
         if update_fill:
             self._update_fill_level()
 
+    def run(self, steps: int, *, inlet_speed: float, update_fill: bool = True, measure_residual: bool = False):
+        """
+        Perform several timesteps.
+
+        With measure_residual, returns the relative velocity change of the last
+        step, sqrt(sum|u_new - u_old|^2 / sum|u_new|^2) - same definition as the
+        native engine, so convergence checks behave the same on both backends.
+        """
+        if steps < 1:
+            return None
+        for _ in range(steps - 1):
+            self.step(inlet_speed=inlet_speed, update_fill=update_fill)
+        if not measure_residual:
+            self.step(inlet_speed=inlet_speed, update_fill=update_fill)
+            return None
+
+        u_old = torch.stack((self.ux, self.uy, self.uz))
+        self.step(inlet_speed=inlet_speed, update_fill=update_fill)
+        u_new = torch.stack((self.ux, self.uy, self.uz))
+        du2 = float(torch.sum((u_new - u_old) ** 2, dtype=torch.float64))
+        u2 = float(torch.sum(u_new ** 2, dtype=torch.float64))
+        return float(np.sqrt(du2 / u2)) if u2 > 0.0 else float("inf")
+
+    def checkpoint_state(self):
+        """Solver state for sim/checkpoint.py as (arrays, parity) - host copies of f and the fill level."""
+        arrays = {
+            "populations": self.f.detach().cpu().numpy(),
+            "fill": self.fill_level.detach().cpu().numpy(),
+        }
+        return arrays, 0
+
+    def restore_checkpoint(self, arrays: dict, iteration: int, parity: int):
+        """Load a state saved by checkpoint_state(); rho/u follow from f exactly as at the end of step()."""
+        self.f = torch.tensor(np.asarray(arrays["populations"]), device=self.device, dtype=torch.float32)
+        self.fill_level = torch.tensor(np.asarray(arrays["fill"]), device=self.device, dtype=torch.float32)
+        self._compute_macroscopic()
+
+    def init_from_fields(self, rho: np.ndarray, ux: np.ndarray, uy: np.ndarray, uz: np.ndarray, fill: np.ndarray):
+        """Start from given (nx, ny, nz) fields instead of rest (see sim/warm_start.py)."""
+        as_t = lambda a: torch.tensor(np.asarray(a, dtype=np.float32), device=self.device)
+        self.rho, self.ux, self.uy, self.uz = as_t(rho), as_t(ux), as_t(uy), as_t(uz)
+        self.f = self._equilibrium(self.rho, self.ux, self.uy, self.uz)
+        self.fill_level = as_t(fill)
+        self.fill_level[self.inlet] = 1.0
+
+    def density_cpu(self):
+        """Get density field on CPU."""
+        return self.rho.detach().cpu().numpy()
+
     def velocity_cpu(self):
         """Get velocity field on CPU."""
         ux_np = self.ux.detach().cpu().numpy()
         uy_np = self.uy.detach().cpu().numpy()
         uz_np = self.uz.detach().cpu().numpy()
-
-        speed = np.sqrt(ux_np**2 + uy_np**2 + uz_np**2)
-        fluid_mask = ~self.solid.detach().cpu().numpy()
-        fluid_speed = speed[fluid_mask]
-
-        print(f"[LBM] Final velocity field (fluid cells):")
-        print(f"  Speed - min: {fluid_speed.min():.6f}, max: {fluid_speed.max():.6f}, mean: {fluid_speed.mean():.6f}")
-        print(f"  ux: [{ux_np[fluid_mask].min():.6f}, {ux_np[fluid_mask].max():.6f}]")
-        print(f"  uy: [{uy_np[fluid_mask].min():.6f}, {uy_np[fluid_mask].max():.6f}]")
-        print(f"  uz: [{uz_np[fluid_mask].min():.6f}, {uz_np[fluid_mask].max():.6f}]")
-
         return (ux_np, uy_np, uz_np)
 
     def fill_level_cpu(self):
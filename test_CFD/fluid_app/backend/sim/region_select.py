@@ -0,0 +1,108 @@
+"""
+Inlet/outlet region selection on the lattice.
+
+Both queries only touch cells near the query point, so domain setup does not
+grow with the grid:
+
+- select_sphere() walks the bounding box of the sphere (binary search on the
+  axes) and never builds a full-grid distance array.
+- nearest_fluid_cells() searches shells of growing radius around the point's
+  cell over the bit-packed solid mask, stopping once no cell outside the
+  searched box can be nearer than the ones found. A source point a few cells
+  into solid costs microseconds natively.
+- snap_to_fluid() moves a point in solid to the nearest fluid cell centre;
+  build_domain_from_stl() snaps the source once and advection reuses it.
+
+Uses native/src/region_select.hpp when fluid_native is built, otherwise the
+same box-bounded search in numpy.
+"""
+from __future__ import annotations
+
+import numpy as np
+
+from .bitmask import BitMask
+from .lbm_native import NATIVE_AVAILABLE, fluid_native
+
+Coords = tuple[np.ndarray, np.ndarray, np.ndarray]
+
+
+def _nearest_index(axis: np.ndarray, v: float) -> int:
+    """Index of the (ascending) axis value nearest to v."""
+    hi = int(np.searchsorted(axis, v))
+    if hi == 0:
+        return 0
+    if hi == len(axis):
+        return hi - 1
+    return hi - 1 if v - axis[hi - 1] <= axis[hi] - v else hi
+
+
+def select_sphere(solid: BitMask, coords: Coords, center_mm: np.ndarray, radius_mm: float) -> BitMask:
+    """Fluid cells (clear in `solid`) whose centres lie within radius_mm of center_mm."""
+    center = np.asarray(center_mm, dtype=np.float32)
+    if NATIVE_AVAILABLE:
+        words = fluid_native.select_sphere(*coords, center, float(radius_mm), solid.words)
+        return BitMask(words, solid.shape[2])
+
+    box = []
+    for c, c0 in zip(coords, center):
+        lo = int(np.searchsorted(c, c0 - radius_mm, side="left"))
+        hi = int(np.searchsorted(c, c0 + radius_mm, side="right"))
+        box.append(slice(lo, max(lo, hi)))
+    d2 = [(c[s] - c0) ** 2 for c, s, c0 in zip(coords, box, center)]
+    inside = np.sqrt(d2[0][:, None, None] + d2[1][None, :, None] + d2[2][None, None, :]) <= radius_mm
+    cells = np.nonzero(inside)
+    flat = np.ravel_multi_index(tuple(idx + s.start for idx, s in zip(cells, box)), solid.shape)
+    return BitMask.from_indices(solid.shape, flat).andnot(solid)
+
+
+def nearest_fluid_cells(solid: BitMask, coords: Coords, point_mm: np.ndarray, count: int) -> np.ndarray:
+    """
+    Flat C-order indices of the `count` fluid cells nearest to point_mm,
+    nearest first (ties in index order); fewer if there are fewer fluid cells.
+    """
+    point = np.asarray(point_mm, dtype=np.float32)
+    if count <= 0:
+        return np.zeros(0, dtype=np.int64)
+    if NATIVE_AVAILABLE:
+        return fluid_native.nearest_fluid_cells(solid.words, *coords, point, int(count))
+
+    shape = solid.shape
+    p = point.astype(np.float64)
+    axes = [np.asarray(c, dtype=np.float64) for c in coords]
+    centre = [_nearest_index(a, v) for a, v in zip(axes, p)]
+
+    s = 1
+    while True:
+        lo = [max(c0 - s, 0) for c0 in centre]
+        hi = [min(c0 + s + 1, n) for c0, n in zip(centre, shape)]
+        cells = np.nonzero(~solid.crop(lo, hi))
+        d2 = sum((a[idx + l] - v) ** 2 for a, idx, l, v in zip(axes, cells, lo, p))
+        flat = np.ravel_multi_index(tuple(idx + l for idx, l in zip(cells, lo)), shape)
+        order = np.lexsort((flat, d2))[:count]
+        # Any cell outside the box is at least this far along the axis it leaves by
+        beyond = min(
+            [(a[l - 1] - v) ** 2 for a, l, v in zip(axes, lo, p) if l > 0]
+            + [(a[h] - v) ** 2 for a, h, v, n in zip(axes, hi, p, shape) if h < n],
+            default=np.inf,
+        )
+        if (len(order) == count and d2[order[-1]] < beyond) or beyond == np.inf:
+            return flat[order].astype(np.int64)
+        s *= 2
+
+
+def snap_to_fluid(solid: BitMask, coords: Coords, point_mm: np.ndarray) -> tuple[np.ndarray, int]:
+    """
+    (point, cell): point_mm itself if the cell it falls in is fluid, otherwise
+    the centre of the nearest fluid cell; cell is that cell's flat index
+    (-1 and point_mm unchanged if the grid has no fluid).
+    """
+    point = np.asarray(point_mm, dtype=np.float32)
+    ijk = tuple(_nearest_index(np.asarray(c), float(v)) for c, v in zip(coords, point))
+    if not solid[ijk]:
+        return point, int(np.ravel_multi_index(ijk, solid.shape))
+    nearest = nearest_fluid_cells(solid, coords, point, 1)
+    if len(nearest) == 0:
+        return point, -1
+    cell = int(nearest[0])
+    ijk = np.unravel_index(cell, solid.shape)
+    return np.array([c[i] for c, i in zip(coords, ijk)], dtype=np.float32), cell
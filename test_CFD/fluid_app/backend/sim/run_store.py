@@ -15,9 +15,15 @@ class RunStore:
         return self.runs_dir / run_id
 
     def create_run(self, meta: dict[str, Any]) -> str:
-        run_id = f"run_{int(time.time() * 1000)}"
-        d = self._run_dir(run_id)
-        d.mkdir(parents=True, exist_ok=False)
+        stamp = int(time.time() * 1000)
+        while True:  # requests in the same millisecond take the next free id
+            run_id = f"run_{stamp}"
+            d = self._run_dir(run_id)
+            try:
+                d.mkdir(parents=True, exist_ok=False)
+                break
+            except FileExistsError:
+                stamp += 1
         (d / "meta.json").write_text(json.dumps(meta, indent=2), encoding="utf-8")
         (d / "status.json").write_text(
             json.dumps({"state": "queued", "progress": 0.0, "message": "queued"}, indent=2),
@@ -45,3 +51,21 @@ class RunStore:
 
     def result_path(self, run_id: str) -> Path:
         return self._run_dir(run_id) / "result.npz"
+
+    def frames_path(self, run_id: str) -> Path:
+        # Particle frames, chunked and quantized (see frame_archive.py).
+        return self._run_dir(run_id) / "frames.bin"
+
+    def preview_path(self, run_id: str) -> Path:
+        # Coarse velocity field, replaced while the LBM runs.
+        return self._run_dir(run_id) / "preview.npz"
+
+    def checkpoint_path(self, key: str) -> Path:
+        # Keyed by domain hash rather than run id, so a retried run finds it.
+        return self.runs_dir / "checkpoints" / f"{key}.ckpt"
+
+    def warm_start_dir(self) -> Path:
+        return self.runs_dir / "warm_start"
+
+    def domain_cache_dir(self) -> Path:
+        return self.runs_dir / "domains"
@@ -0,0 +1,219 @@
+"""
+Bounded run scheduler.
+
+Simulation requests queue here instead of each starting at once. A fixed pool
+of worker threads (sized to the cores and the memory budget) takes the queued
+runs in priority order - lower quality first, so quick previews are not stuck
+behind high-quality runs - and starts a run only while the estimated peak
+memory of the running ones plus its own fits the budget (one run is always
+admitted, however large). A queued run gains one priority level per
+PRIORITY_AGING_S it has waited, and one that has waited MAX_WAIT_S is not
+overtaken by smaller runs any more, so a stream of previews cannot starve a
+high-quality run. Each worker owns a disjoint slice of cpu_count // workers
+CPUs, and its runs use that many threads pinned to the slice. Queued runs
+report their position and an ETA in their status; queued or running runs can
+be cancelled.
+"""
+from __future__ import annotations
+
+import ctypes
+import heapq
+import itertools
+import os
+import sys
+import threading
+import time
+import traceback
+from dataclasses import dataclass, field
+from typing import Any, Callable
+
+from .lbm_native import numa_nodes
+from .run_store import RunStore
+from .simulate import quality_params
+
+# Runs are OpenMP/torch parallel themselves; give each at least this many cores.
+CORES_PER_RUN = 4
+# Queue aging: one priority level per PRIORITY_AGING_S waited, and no
+# overtaking once a run has waited MAX_WAIT_S.
+PRIORITY_AGING_S = 120.0
+MAX_WAIT_S = 900.0
+# Share of physical memory runs may take together.
+MEMORY_BUDGET_FRAC = 0.7
+QUALITY_PRIORITY = {"low": 0, "medium": 1, "high": 2}
+# Starting guesses for the run time of each quality (s); replaced by a moving
+# average of the finished runs.
+DEFAULT_SECONDS = {"low": 60.0, "medium": 180.0, "high": 600.0}
+
+# Resident bytes per grid cell while the LBM runs: dense native engine with
+# fp32 / 16-bit populations (one AA array plus fields), torch (two population
+# arrays plus per-step temporaries).
+_BYTES_PER_CELL = {"native": 100, "native16": 62, "torch": 240}
+
+
+def physical_memory_bytes() -> int:
+    try:
+        if sys.platform == "win32":
+            class MemoryStatus(ctypes.Structure):
+                _fields_ = [("dwLength", ctypes.c_ulong), ("dwMemoryLoad", ctypes.c_ulong),
+                            ("ullTotalPhys", ctypes.c_ulonglong), ("ullAvailPhys", ctypes.c_ulonglong),
+                            ("ullTotalPageFile", ctypes.c_ulonglong), ("ullAvailPageFile", ctypes.c_ulonglong),
+                            ("ullTotalVirtual", ctypes.c_ulonglong), ("ullAvailVirtual", ctypes.c_ulonglong),
+                            ("ullAvailExtendedVirtual", ctypes.c_ulonglong)]
+
+            status = MemoryStatus()
+            status.dwLength = ctypes.sizeof(MemoryStatus)
+            ctypes.windll.kernel32.GlobalMemoryStatusEx(ctypes.byref(status))
+            return int(status.ullTotalPhys)
+        return int(os.sysconf("SC_PHYS_PAGES") * os.sysconf("SC_PAGE_SIZE"))
+    except (AttributeError, OSError, ValueError):
+        return 8 << 30
+
+
+def estimate_peak_bytes(quality: str, solver: str = "auto", precision: str = "fp32") -> int:
+    """
+    Upper bound of a run's peak memory: the grid is at most base_res cells on
+    every side, and the particle frames stay in memory (float32) until saved.
+    """
+    params = quality_params(quality)
+    cells = int(params["base_res"]) ** 3
+    if solver == "torch":
+        per_cell = _BYTES_PER_CELL["torch"]
+    else:
+        per_cell = _BYTES_PER_CELL["native" if precision == "fp32" else "native16"]
+    frames = int(params["frames"]) * int(params["particles"]) * 3 * 4
+    return cells * per_cell + frames
+
+
+@dataclass(order=True)
+class _Job:
+    priority: int
+    seq: int
+    run_id: str = field(compare=False)
+    quality: str = field(compare=False)
+    peak_bytes: int = field(compare=False)
+    fn: Callable[..., None] = field(compare=False)
+    kwargs: dict[str, Any] = field(compare=False)
+    cancel: threading.Event = field(compare=False, default_factory=threading.Event)
+    submitted: float = field(compare=False, default_factory=time.perf_counter)
+    started: float | None = field(compare=False, default=None)
+
+    def rank(self, now: float) -> tuple[float, int]:
+        """Queue order: priority less the levels gained by waiting, then arrival."""
+        return self.priority - (now - self.submitted) / PRIORITY_AGING_S, self.seq
+
+
+class RunScheduler:
+    def __init__(self, store: RunStore, *, workers: int | None = None, memory_budget: int | None = None):
+        self.store = store
+        self.memory_budget = int(memory_budget or MEMORY_BUDGET_FRAC * physical_memory_bytes())
+        if workers is None:
+            by_cores = (os.cpu_count() or 1) // CORES_PER_RUN
+            by_memory = self.memory_budget // estimate_peak_bytes("medium")
+            workers = min(by_cores, by_memory)
+        self.workers = max(1, int(workers))
+        self.threads_per_run = max(1, (os.cpu_count() or 1) // self.workers)
+        # Node by node, so a slice spans as few sockets as possible.
+        cpus = [c for cs in numa_nodes().values() for c in cs] or list(range(os.cpu_count() or 1))
+        self._cpus = [cpus[w * self.threads_per_run:(w + 1) * self.threads_per_run] or None
+                      for w in range(self.workers)]
+        self._seconds = dict(DEFAULT_SECONDS)
+        self._queue: list[_Job] = []
+        self._running: dict[str, _Job] = {}
+        self._seq = itertools.count()
+        self._lock = threading.Condition()
+        self._threads = [threading.Thread(target=self._work, args=(i,), name=f"run-worker-{i}", daemon=True)
+                         for i in range(self.workers)]
+        for t in self._threads:
+            t.start()
+        print(f"[Scheduler] {self.workers} workers x {self.threads_per_run} threads, "
+              f"memory budget {self.memory_budget / 2**30:.1f} GB")
+
+    def submit(self, run_id: str, fn: Callable[..., None], kwargs: dict[str, Any], *,
+               quality: str, peak_bytes: int) -> None:
+        """
+        Queue fn(**kwargs, cancel=event, threads=n, cpus=slice); fn writes the
+        run's status from then on and must keep to n threads on the CPUs in
+        slice (None: no slice, do not pin).
+        """
+        job = _Job(QUALITY_PRIORITY.get(quality, 1), next(self._seq), run_id, quality, int(peak_bytes), fn, kwargs)
+        with self._lock:
+            self._queue.append(job)
+            self._publish_queue()
+            self._lock.notify_all()
+
+    def cancel(self, run_id: str) -> bool:
+        """Drops a queued run or asks a running one to stop; False if neither."""
+        with self._lock:
+            job = self._running.get(run_id)
+            if job is not None:
+                job.cancel.set()
+                return True
+            for i, job in enumerate(self._queue):
+                if job.run_id == run_id:
+                    self._queue.pop(i)
+                    self.store.write_status(run_id, state="cancelled", progress=0.0, message="Cancelled while queued")
+                    self._publish_queue()
+                    return True
+        return False
+
+    def _ordered(self) -> list[_Job]:
+        now = time.perf_counter()
+        return sorted(self._queue, key=lambda j: j.rank(now))
+
+    def _admissible(self) -> _Job | None:
+        """First queued job in (aged) priority order that fits the memory left, if any."""
+        used = sum(j.peak_bytes for j in self._running.values())
+        now = time.perf_counter()
+        for job in self._ordered():
+            if not self._running or used + job.peak_bytes <= self.memory_budget:
+                return job
+            if now - job.submitted >= MAX_WAIT_S:
+                return None  # waited long enough: hold the memory for it
+        return None
+
+    def _work(self, slot: int) -> None:
+        while True:
+            with self._lock:
+                job = self._admissible()
+                while job is None:
+                    self._lock.wait()
+                    job = self._admissible()
+                self._queue.remove(job)
+                job.started = time.perf_counter()
+                self._running[job.run_id] = job
+                self._publish_queue()
+            try:
+                job.fn(**job.kwargs, cancel=job.cancel, threads=self.threads_per_run, cpus=self._cpus[slot])
+            except Exception as ex:  # fn reports its own errors; this is the safety net
+                print(f"[Scheduler] Run {job.run_id} failed outside its error handling:\n{traceback.format_exc()}")
+                try:
+                    self.store.write_status(job.run_id, state="error", progress=1.0,
+                                            message=f"{type(ex).__name__}: {ex}")
+                except Exception:
+                    pass
+            finally:
+                with self._lock:
+                    del self._running[job.run_id]
+                    if not job.cancel.is_set():
+                        secs = time.perf_counter() - job.started
+                        self._seconds[job.quality] = 0.7 * self._seconds[job.quality] + 0.3 * secs
+                    self._publish_queue()
+                    self._lock.notify_all()
+
+    def _publish_queue(self) -> None:
+        """Writes position and ETA into the status of every queued run (lock held)."""
+        now = time.perf_counter()
+        # Seconds until each worker frees up, then hand the queue out in order.
+        free_at = [max(0.0, self._seconds[j.quality] - (now - j.started)) for j in self._running.values()]
+        free_at = sorted(free_at + [0.0] * (self.workers - len(free_at)))
+        for pos, job in enumerate(self._ordered(), start=1):
+            eta = heapq.heappop(free_at)
+            heapq.heappush(free_at, eta + self._seconds[job.quality])
+            self.store.write_status(
+                job.run_id,
+                state="queued",
+                progress=0.0,
+                message=f"Queued ({pos} of {len(self._queue)}, starts in ~{eta:.0f}s)",
+                extra={"queue": {"position": pos, "length": len(self._queue), "etaSeconds": round(eta, 1),
+                                 "peakBytes": job.peak_bytes}},
+            )
@@ -1,5 +1,8 @@
 from __future__ import annotations
 
+import os
+import threading
+import time
 import traceback
 from pathlib import Path
 from typing import Literal
@@ -7,16 +10,27 @@ from typing import Literal
 import numpy as np
 
 from .advect import advect_particles
+from .checkpoint import SolverCheckpoint, domain_key
 from .domain import build_domain_from_stl
-from .lbm_torch import LbmD3Q19Torch
+from .frame_archive import CHUNK_FRAMES, FrameArchiveWriter, quantization_step
+from .lbm_native import NATIVE_AVAILABLE, LbmD3Q19Native, fluid_native
+from .lbm_slabs import LbmD3Q19Slabs
+from .lbm_torch import TORCH_AVAILABLE, LbmD3Q19Torch, torch
 from .run_store import RunStore
+from .warm_start import WarmStartCache, solution_key
 
 
 Quality = Literal["low", "medium", "high"]
+Solver = Literal["auto", "torch", "native"]
+Precision = Literal["fp32", "fp16", "bf16"]
+Integrator = Literal["euler", "rk2", "rk4"]
 
 
-def _quality_params(quality: Quality):
+def quality_params(quality: Quality):
     """
+    Grid size, iteration budget and output sizes for a quality preset (the
+    scheduler sizes its memory estimate from these too).
+
     Quality parameters DRAMATICALLY INCREASED for RTX 5090!
     
     RTX 5090 has 32GB VRAM and massive compute - let's use it!
@@ -31,6 +45,7 @@ def _quality_params(quality: Quality):
             "frames": 300,        # Was 140 - more animation
             "particles": 15000,   # Was 2500 - 6x more particles!
             "nu_lbm": 0.08,       # Viscosity
+            "convergence_tol": 2e-5,  # Stop early once the flow has settled
         }
     if quality == "high":
         return {
@@ -39,6 +54,7 @@ def _quality_params(quality: Quality):
             "frames": 600,        # Was 360 - longer animation
             "particles": 80000,   # Was 12000 - massive particle count!
             "nu_lbm": 0.05,       # Lower viscosity = more turbulent
+            "convergence_tol": 5e-6,
         }
     # Medium
     return {
@@ -47,9 +63,95 @@ def _quality_params(quality: Quality):
         "frames": 450,            # Was 240 - more animation
         "particles": 40000,       # Was 6000 - 6x more!
         "nu_lbm": 0.06,           # Balanced viscosity
+        "convergence_tol": 1e-5,
     }
 
 
+# Convergence check: every CONVERGENCE_EVERY steps the solver reports the
+# relative velocity change of one step; once it drops below the quality's
+# convergence_tol (and at least MIN_ITERATIONS_FRAC of the budget has run)
+# the flow is considered settled. The fill level is still being transported
+# then, so from that point on the loop also compares it chunk to chunk and only
+# stops early once its relative change is below the tolerance as well.
+CONVERGENCE_EVERY = 25
+MIN_ITERATIONS_FRAC = 0.2
+
+# The LBM state is checkpointed at most every CHECKPOINT_EVERY_S seconds (at a
+# convergence-check boundary), so a run that dies late can be retried from
+# where it stopped instead of from rest. See sim/checkpoint.py.
+CHECKPOINT_EVERY_S = 20.0
+
+# A run warm-started from a cached solution (sim/warm_start.py) has a
+# meaningful residual from the first check, so it may stop much earlier.
+WARM_MIN_ITERATIONS_FRAC = 0.05
+
+# Partial results are published while the run is in progress: a coarse
+# velocity field (every PREVIEW_STRIDE-th cell) at most every PREVIEW_EVERY_S
+# seconds of LBM, then the particle frames chunk by chunk as they are advected.
+# The status carries what is ready under "stream".
+PREVIEW_EVERY_S = 10.0
+PREVIEW_STRIDE = 2
+
+
+def _frame_bounds(domain) -> tuple[np.ndarray, np.ndarray]:
+    """Box the particle frames stay in: advect_particles() respawns a particle
+    once it is more than the domain size outside the grid."""
+    lo = np.array([domain.x_coords[0], domain.y_coords[0], domain.z_coords[0]], dtype=np.float32)
+    hi = np.array([domain.x_coords[-1], domain.y_coords[-1], domain.z_coords[-1]], dtype=np.float32)
+    margin = float((hi - lo).max())
+    return lo - margin, hi + margin
+
+
+def _print_velocity_stats(domain, ux, uy, uz) -> None:
+    fluid = (~domain.solid).set_indices()
+    if not len(fluid):
+        return
+    ux, uy, uz = (u.reshape(-1)[fluid] for u in (ux, uy, uz))
+    speed = np.sqrt(ux**2 + uy**2 + uz**2)
+    print(f"[LBM] Final velocity field (fluid cells):")
+    print(f"  Speed - min: {speed.min():.6f}, max: {speed.max():.6f}, mean: {speed.mean():.6f}")
+    print(f"  ux: [{ux.min():.6f}, {ux.max():.6f}]")
+    print(f"  uy: [{uy.min():.6f}, {uy.max():.6f}]")
+    print(f"  uz: [{uz.min():.6f}, {uz.max():.6f}]")
+
+
+def _write_velocity_preview(path: Path, domain, lbm, iteration: int) -> None:
+    ux, uy, uz = lbm.velocity_cpu()
+    s = slice(None, None, PREVIEW_STRIDE)
+    tmp = path.with_name(path.stem + ".tmp.npz")
+    np.savez(
+        tmp,
+        x_coords=domain.x_coords[s].astype(np.float32),
+        y_coords=domain.y_coords[s].astype(np.float32),
+        z_coords=domain.z_coords[s].astype(np.float32),
+        ux=ux[s, s, s].astype(np.float32),
+        uy=uy[s, s, s].astype(np.float32),
+        uz=uz[s, s, s].astype(np.float32),
+        iteration=np.int64(iteration),
+    )
+    os.replace(tmp, path)
+
+
+class RunCancelled(Exception):
+    pass
+
+
+def _resolve_solver(solver: Solver) -> str:
+    """
+    Pick the LBM backend for "auto":
+    - torch when a CUDA GPU is visible (that's what it's tuned for)
+    - the native multicore engine on CPU-only boxes, if it's built
+    - torch on CPU as the last resort
+    """
+    if solver != "auto":
+        return solver
+    if TORCH_AVAILABLE and torch.cuda.is_available():
+        return "torch"
+    if NATIVE_AVAILABLE:
+        return "native"
+    return "torch"
+
+
 def simulate_run(
     *,
     store: RunStore,
@@ -59,6 +161,13 @@ def simulate_run(
     source_point_mm: np.ndarray,
     flow_gph: float,
     quality: Quality,
+    solver: Solver = "auto",
+    precision: Precision = "fp32",
+    integrator: Integrator = "euler",
+    ranks: int = 1,
+    cancel: threading.Event | None = None,
+    threads: int | None = None,
+    cpus: list[int] | None = None,
 ):
     """
     Run a complete CFD simulation:
@@ -66,11 +175,36 @@ def simulate_run(
     2. Run LBM solver with gravity body force
     3. Advect particles through velocity field
     4. Save results
+
+    ranks > 1 splits the native solver over that many processes (dense slabs
+    along x, see lbm_slabs.py); the torch solver ignores it.
+
+    Setting `cancel` (see scheduler.py) stops the run at the next LBM chunk or
+    frame batch with state "cancelled". `threads` caps the run's OpenMP threads
+    (native solver, voxelizer, SDF, advection) and torch's CPU threads, so
+    concurrent runs share the cores instead of each taking all of them.
+    `cpus` pins the native solver's threads to those CPUs (the run's own
+    slice, so concurrent runs do not pin onto the same cores).
     """
+    ckpt = None
+    lbm = None
+    t_run = time.perf_counter()
+
+    def check_cancel() -> None:
+        if cancel is not None and cancel.is_set():
+            raise RunCancelled()
+
     try:
+        if threads:
+            # OpenMP keeps the thread count per calling thread, so this only
+            # affects this run; torch's CPU pool is process-wide.
+            if NATIVE_AVAILABLE:
+                fluid_native.set_num_threads(int(threads))
+            if TORCH_AVAILABLE:
+                torch.set_num_threads(int(threads))
         store.write_status(run_id, state="running", progress=0.01, message="Loading STL mesh...")
 
-        params = _quality_params(quality)
+        params = quality_params(quality)
         nu_lbm = params.get("nu_lbm", 0.06)
         
         domain = build_domain_from_stl(
@@ -79,12 +213,37 @@ def simulate_run(
             gravity=gravity,
             source_point_mm=source_point_mm,
             nu_lbm=nu_lbm,  # Pass viscosity for gravity scaling
+            cache_dir=store.domain_cache_dir(),
         )
 
-        store.write_status(run_id, state="running", progress=0.10, message="Initializing GPU LBM solver...")
+        check_cancel()
+        backend = _resolve_solver(solver)
+        print(f"[Simulate] LBM backend: {backend} (requested: {solver})")
+        store.write_status(
+            run_id,
+            state="running",
+            progress=0.10,
+            message="Initializing native CPU LBM solver..." if backend == "native" else "Initializing GPU LBM solver...",
+        )
 
         # Create LBM solver WITH GRAVITY BODY FORCE
-        lbm = LbmD3Q19Torch(
+        solver_cls = LbmD3Q19Native if backend == "native" else LbmD3Q19Torch
+        solver_kw = {}
+        if backend == "native":
+            solver_kw["precision"] = precision
+            if cpus:
+                solver_kw["cpus"] = list(cpus)
+            if ranks > 1:
+                solver_cls = LbmD3Q19Slabs
+                solver_kw["ranks"] = min(int(ranks), domain.nx)
+                if threads:
+                    solver_kw["threads"] = max(1, int(threads) // solver_kw["ranks"])
+        else:
+            solver_kw.update(wall_links=domain.wall_links, inlet_cells=domain.inlet_cells,
+                             outlet_cells=domain.outlet_cells)
+            if precision != "fp32":
+                print(f"[Simulate] {precision} population storage is native-only - torch runs in fp32")
+        lbm = solver_cls(
             nx=domain.nx,
             ny=domain.ny,
             nz=domain.nz,
@@ -93,6 +252,7 @@ def simulate_run(
             inlet=domain.inlet,
             outlet=domain.outlet,
             gravity_lbm=domain.gravity_lbm,  # NEW: Pass gravity for body force!
+            **solver_kw,
         )
 
         inlet_speed_lbm = domain.inlet_speed_lbm(flow_gph=flow_gph, nu_lbm=lbm.nu)
@@ -102,28 +262,176 @@ def simulate_run(
         print(f"[Simulate] Running {params['iterations']} LBM iterations...")
 
         n_iter = int(params["iterations"])
-        for i in range(n_iter):
-            lbm.step(inlet_speed=float(inlet_speed_lbm))
-            if (i + 1) % max(1, n_iter // 20) == 0:
-                pct = 0.10 + 0.55 * (i + 1) / n_iter
+        tol = float(params["convergence_tol"])
+        min_iter = int(MIN_ITERATIONS_FRAC * n_iter)
+        report_every = max(1, n_iter // 20)
+        convergence = {
+            "tolerance": tol,
+            "checkEvery": CONVERGENCE_EVERY,
+            "maxIterations": n_iter,
+            "iterations": 0,
+            "converged": False,
+            "history": [],  # [iteration, residual] pairs
+        }
+        n_frames = int(params["frames"])
+        stream = {"framesReady": 0, "nFrames": n_frames}
+        conv_extra = {"convergence": convergence, "stream": stream}
+
+        ckpt_key = domain_key(
+            solid=domain.solid.words,
+            inlet=domain.inlet.words,
+            outlet=domain.outlet.words,
+            nu=float(lbm.nu),
+            gravity=np.asarray(domain.gravity_lbm, dtype=np.float32),
+            inlet_dir=np.asarray(domain.gravity_dir, dtype=np.float32),
+            inlet_speed=float(inlet_speed_lbm),
+            # Slab checkpoints have the dense layout whatever the rank count.
+            backend="native-dense" if solver_cls is LbmD3Q19Slabs else backend,
+            precision=precision if backend == "native" else "fp32",
+        )
+        # Slab ranks read and write the checkpoint file themselves.
+        slabs = isinstance(lbm, LbmD3Q19Slabs)
+        state = lbm.checkpoint_layout() if slabs else lbm.checkpoint_state()[0]
+        ckpt = SolverCheckpoint(store.checkpoint_path(ckpt_key), ckpt_key, (domain.nx, domain.ny, domain.nz), state)
+        del state
+
+        warm_cache = WarmStartCache(store.warm_start_dir())
+        warm_key = solution_key(stl_path, (domain.nx, domain.ny, domain.nz), domain.gravity_lbm, lbm.nu)
+        warm_info = None
+
+        done = 0
+        resumed = ckpt.load()
+        if resumed is not None:
+            iteration, parity, arrays = resumed
+            if slabs:
+                lbm.load_checkpoint(ckpt, iteration, parity)
+            else:
+                lbm.restore_checkpoint(arrays, iteration, parity)
+            del arrays
+            done = min(int(iteration), n_iter)
+            convergence["iterations"] = done
+            convergence["resumedFrom"] = done
+            print(f"[Checkpoint] Resuming LBM from iteration {done}/{n_iter} ({ckpt.path.name})")
+        else:
+            extent_mm = max(float(np.ptp(c)) for c in (domain.x_coords, domain.y_coords, domain.z_coords))
+            warm = warm_cache.lookup(warm_key, float(inlet_speed_lbm), domain.source_point_mm, extent_mm)
+            if warm is not None:
+                fields, warm_info = warm
+                lbm.init_from_fields(**fields)
+                del fields
+                min_iter = int(WARM_MIN_ITERATIONS_FRAC * n_iter)
+                convergence["warmStart"] = warm_info
+                print(f"[WarmStart] Starting from cached solution(s) {warm_info['entries']} (weights {warm_info['weights']})")
+
+        next_report = (done // report_every + 1) * report_every
+        t_lbm = last_ckpt = time.perf_counter()
+        last_preview = float("-inf")
+        fill_prev = None
+        while done < n_iter:
+            check_cancel()
+            chunk = min(CONVERGENCE_EVERY, n_iter - done)
+            residual = lbm.run(chunk, inlet_speed=float(inlet_speed_lbm), measure_residual=True)
+            done += chunk
+            convergence["iterations"] = done
+            convergence["history"].append([done, residual if np.isfinite(residual) else None])
+            converged = done >= min_iter and residual < tol
+            if converged:
+                fill_now = lbm.fill_level_cpu()
+                if fill_prev is not None:
+                    change = float(np.sqrt(np.sum((fill_now - fill_prev) ** 2) / max(np.sum(fill_now ** 2), 1e-30)))
+                    convergence["fillChange"] = change
+                converged = fill_prev is not None and change < tol
+                fill_prev = fill_now
+            else:
+                fill_prev = None
+            if done >= next_report or converged:
+                next_report = (done // report_every + 1) * report_every
+                pct = 0.10 + 0.55 * done / n_iter
                 store.write_status(
                     run_id,
                     state="running",
                     progress=pct,
-                    message=f"LBM solver: {i+1}/{n_iter} iterations",
+                    message=f"LBM solver: {done}/{n_iter} iterations (residual {residual:.1e})",
+                    extra=conv_extra,
                 )
+                if not converged and time.perf_counter() - last_preview >= PREVIEW_EVERY_S:
+                    _write_velocity_preview(store.preview_path(run_id), domain, lbm, done)
+                    stream["previewIteration"] = done
+                    last_preview = time.perf_counter()
+            if converged:
+                convergence["converged"] = True
+                print(f"[Simulate] Converged after {done}/{n_iter} iterations (residual {residual:.2e}, "
+                      f"fill change {convergence['fillChange']:.2e} < {tol:.0e})")
+                break
+            if done < n_iter and time.perf_counter() - last_ckpt >= CHECKPOINT_EVERY_S:
+                # Copies the state before returning; only the flush to disk overlaps the next chunks.
+                if slabs:
+                    lbm.save_checkpoint(ckpt, done)
+                else:
+                    state, parity = lbm.checkpoint_state()
+                    ckpt.save(done, parity, state)
+                last_ckpt = time.perf_counter()
+        else:
+            if "resumedFrom" not in convergence or done > convergence["resumedFrom"]:
+                print(f"[Simulate] Ran all {n_iter} iterations (final residual {residual:.2e}, tolerance {tol:.0e})")
+        ckpt.wait()
+
+        lbm_seconds = time.perf_counter() - t_lbm
+        convergence["seconds"] = round(lbm_seconds, 3)
+        start = "warm start" if warm_info else ("resumed" if "resumedFrom" in convergence else "cold start")
+        print(f"[Simulate] LBM time to {'convergence' if convergence['converged'] else 'max iterations'}: "
+              f"{done} iterations, {lbm_seconds:.1f} s ({start})")
+        if warm_info and warm_info["coldSeconds"]:
+            print(f"[WarmStart] Cold start took {warm_info['coldIterations']} iterations, {warm_info['coldSeconds']:.1f} s"
+                  f" - saved {100 * (1 - lbm_seconds / warm_info['coldSeconds']):.0f}% of the LBM time")
 
-        store.write_status(run_id, state="running", progress=0.68, message="Extracting velocity field...")
+        store.write_status(run_id, state="running", progress=0.68, message="Extracting velocity field...", extra=conv_extra)
         ux, uy, uz = lbm.velocity_cpu()
+        _print_velocity_stats(domain, ux, uy, uz)
         fill_level = lbm.fill_level_cpu()
+        if convergence["converged"]:
+            warm_cache.store(
+                warm_key,
+                {"rho": lbm.density_cpu(), "ux": ux, "uy": uy, "uz": uz, "fill": fill_level},
+                inlet_speed=float(inlet_speed_lbm),
+                source_point_mm=domain.source_point_mm,
+                flow_gph=flow_gph,
+                iterations=done,
+                seconds=None if "resumedFrom" in convergence else lbm_seconds,
+                warm_info=warm_info,
+            )
+        if slabs:
+            lbm.close()  # stops the slab worker processes
+        lbm = None  # frees the solver before advection
 
-        store.write_status(run_id, state="running", progress=0.72, message="Advecting particles...")
+        store.write_status(run_id, state="running", progress=0.72, message="Advecting particles...", extra=conv_extra)
         
         # Use the CLAMPED source point from domain, not the original user click!
         # This ensures particles spawn inside the fluid region
         clamped_source = domain.source_point_mm
         print(f"[Simulate] Using clamped source for advection: {clamped_source}")
         
+        lo, hi = _frame_bounds(domain)
+        n_particles = int(params["particles"])
+        writer = FrameArchiveWriter(store.frames_path(run_id), n_frames=n_frames, n_particles=n_particles, lo=lo, hi=hi)
+
+        def publish(block: np.ndarray) -> None:
+            check_cancel()
+            writer.append(block)
+            if writer.frames_written == stream["framesReady"]:
+                return  # still buffering the chunk
+            stream["framesReady"] = writer.frames_written
+            if "firstFrameSeconds" not in stream:
+                stream["firstFrameSeconds"] = round(time.perf_counter() - t_run, 3)
+                print(f"[Simulate] Time to first frame: {stream['firstFrameSeconds']:.1f}s")
+            store.write_status(
+                run_id,
+                state="running",
+                progress=0.72 + 0.2 * writer.frames_written / n_frames,
+                message=f"Advecting particles: {writer.frames_written}/{n_frames} frames",
+                extra=conv_extra,
+            )
+
         frames = advect_particles(
             x_coords=domain.x_coords,
             y_coords=domain.y_coords,
@@ -134,12 +442,23 @@ def simulate_run(
             solid=domain.solid,
             source_point_mm=clamped_source,  # Use clamped source!
             gravity_dir=domain.gravity_dir,
-            n_particles=int(params["particles"]),
-            n_frames=int(params["frames"]),
+            n_particles=n_particles,
+            n_frames=n_frames,
             fill_level=fill_level,
+            integrator=integrator,
+            frame_batch=CHUNK_FRAMES,
+            on_frames=publish,
+            source_cell=domain.source_cell,
         )
+        writer.close()
+        stream["framesReady"] = writer.frames_written
+        # runs shorter than one chunk only publish their frames on close
+        stream.setdefault("firstFrameSeconds", round(time.perf_counter() - t_run, 3))
+        print(f"[Simulate] Frames: {frames.nbytes / 1e6:.1f} MB float32 -> {writer.bytes_written / 1e6:.1f} MB"
+              f" in {writer.n_chunks} chunks ({frames.nbytes / max(1, writer.bytes_written):.1f}x,"
+              f" step {quantization_step(lo, hi):.4f} mm)")
 
-        store.write_status(run_id, state="running", progress=0.92, message="Saving results...")
+        store.write_status(run_id, state="running", progress=0.92, message="Saving results...", extra=conv_extra)
 
         out_path = store.result_path(run_id)
         np.savez_compressed(
@@ -147,12 +466,21 @@ def simulate_run(
             x_coords=domain.x_coords.astype(np.float32),
             y_coords=domain.y_coords.astype(np.float32),
             z_coords=domain.z_coords.astype(np.float32),
-            frames=frames.astype(np.float32),
-            solid=domain.solid.astype(np.uint8),
+            solid_packed=domain.solid.words,
             fill_level=fill_level.astype(np.float32),
         )
 
-        store.write_status(run_id, state="done", progress=1.0, message="Simulation complete!")
+        stream["totalSeconds"] = round(time.perf_counter() - t_run, 3)
+        print(f"[Simulate] Done in {stream['totalSeconds']:.1f}s (first frame after {stream['firstFrameSeconds']:.1f}s)")
+        store.write_status(run_id, state="done", progress=1.0, message="Simulation complete!", extra=conv_extra)
+        ckpt.close(delete=True)
+        ckpt = None
+
+    except RunCancelled:
+        print(f"[Simulate] Run {run_id} cancelled")
+        store.write_status(run_id, state="cancelled", progress=1.0, message="Cancelled")
+        if ckpt is not None:
+            ckpt.close()  # a resubmitted run resumes from it
 
     except Exception as ex:
         error_msg = f"{type(ex).__name__}: {ex}"
@@ -172,3 +500,9 @@ def simulate_run(
             message=error_msg,
             extra={"traceback": tb},
         )
+        if ckpt is not None:
+            ckpt.close()  # keep the file so a retry resumes from it
+
+    finally:
+        if isinstance(lbm, LbmD3Q19Slabs):
+            lbm.close()  # the worker processes must not outlive a failed or cancelled run
@@ -0,0 +1,141 @@
+"""
+Warm-start cache of converged LBM solutions.
+
+Re-running the same STL with a different flowGph or source point starts the
+solver from rest every time, although the converged flow barely changes. This
+cache keeps the converged macroscopic fields (rho, u, fill level) of finished
+runs, keyed by everything that fixes the lattice and its physics:
+
+    sha256(STL bytes, grid dims, gravity, viscosity)
+
+Within a key, entries differ in inlet speed and source point. A new run starts
+from the nearest entry; if two entries with the same source point bracket its
+inlet speed, their fields are blended linearly in inlet speed. The solver
+re-imposes the new inlet on the first step and relaxes from there.
+
+Layout: <root>/<key>/<entry>.npz (fields, float32) + <entry>.json (parameters
+and how long the run took to converge).
+"""
+from __future__ import annotations
+
+import hashlib
+import json
+import time
+from pathlib import Path
+
+import numpy as np
+
+# Entries kept per key (oldest evicted first). A high-quality entry is ~170 MB.
+MAX_ENTRIES_PER_KEY = 4
+
+FIELDS = ("rho", "ux", "uy", "uz", "fill")
+
+
+def solution_key(stl_path: str, dims, gravity, nu_lbm: float) -> str:
+    h = hashlib.sha256()
+    with open(stl_path, "rb") as f:
+        for block in iter(lambda: f.read(1 << 20), b""):
+            h.update(block)
+    h.update(np.asarray(dims, dtype=np.int64).tobytes())
+    h.update(np.asarray(gravity, dtype=np.float32).tobytes())
+    h.update(np.float32(nu_lbm).tobytes())
+    return h.hexdigest()
+
+
+class WarmStartCache:
+    def __init__(self, root: Path):
+        self.root = Path(root)
+
+    def _entries(self, key: str) -> list[dict]:
+        d = self.root / key
+        if not d.exists():
+            return []
+        entries = []
+        for p in d.glob("*.json"):
+            if not p.with_suffix(".npz").exists():
+                continue
+            meta = json.loads(p.read_text(encoding="utf-8"))
+            meta["path"] = p.with_suffix(".npz")
+            entries.append(meta)
+        return sorted(entries, key=lambda e: e["created"])
+
+    def lookup(self, key: str, inlet_speed: float, source_point_mm, extent_mm: float):
+        """
+        Fields to start a run from, or None if nothing is cached for this key.
+
+        Returns (fields, info): fields maps FIELDS to (nx, ny, nz) float32
+        arrays; info names the entries used, their blend weights and the cold
+        run's time to convergence (for the savings log).
+        """
+        entries = self._entries(key)
+        if not entries:
+            return None
+        src = np.asarray(source_point_mm, dtype=np.float64)
+
+        def source_dist(e):
+            return float(np.linalg.norm(np.asarray(e["sourcePointMm"]) - src)) / max(extent_mm, 1e-9)
+
+        def dist(e):
+            # Relative inlet-speed change plus source offset as a fraction of the model size.
+            return abs(e["inletSpeed"] - inlet_speed) / max(abs(inlet_speed), 1e-12) + source_dist(e)
+
+        nearest = min(entries, key=dist)
+        picks = [(nearest, 1.0)]
+        # Interpolate between the closest entries on either side of the inlet speed,
+        # as long as both were run from (almost) the same source point as the nearest.
+        same_src = [e for e in entries if abs(source_dist(e) - source_dist(nearest)) < 0.01]
+        below = [e for e in same_src if e["inletSpeed"] <= inlet_speed]
+        above = [e for e in same_src if e["inletSpeed"] > inlet_speed]
+        if below and above:
+            lo = max(below, key=lambda e: e["inletSpeed"])
+            hi = min(above, key=lambda e: e["inletSpeed"])
+            t = (inlet_speed - lo["inletSpeed"]) / (hi["inletSpeed"] - lo["inletSpeed"])
+            picks = [(lo, 1.0 - t), (hi, t)] if t > 0.0 else [(lo, 1.0)]
+
+        fields = None
+        for e, w in picks:
+            with np.load(e["path"]) as data:
+                if fields is None:
+                    fields = {name: w * data[name].astype(np.float32) for name in FIELDS}
+                else:
+                    for name in FIELDS:
+                        fields[name] += w * data[name]
+        info = {
+            "entries": [e["path"].stem for e, _ in picks],
+            "weights": [round(float(w), 4) for _, w in picks],
+            "coldIterations": nearest.get("coldIterations"),
+            "coldSeconds": nearest.get("coldSeconds"),
+        }
+        return fields, info
+
+    def store(self, key: str, fields: dict[str, np.ndarray], *, inlet_speed: float, source_point_mm,
+              flow_gph: float, iterations: int, seconds: float | None, warm_info: dict | None):
+        """
+        Add a converged solution. coldIterations/coldSeconds record how long a
+        start from rest took - inherited from the source entry for warm runs -
+        so later warm starts can report what they saved. seconds=None when
+        the time is unknown (a run resumed from a checkpoint).
+        """
+        d = self.root / key
+        d.mkdir(parents=True, exist_ok=True)
+        entry = f"e{int(time.time() * 1000)}"
+        np.savez(d / f"{entry}.npz", **{name: np.asarray(fields[name], dtype=np.float32) for name in FIELDS})
+        cold = warm_info or {"coldIterations": int(iterations), "coldSeconds": seconds}
+        meta = {
+            "created": time.time(),
+            "inletSpeed": float(inlet_speed),
+            "sourcePointMm": [float(v) for v in np.asarray(source_point_mm).ravel()],
+            "flowGph": float(flow_gph),
+            "iterations": int(iterations),
+            "seconds": seconds,
+            "coldIterations": cold["coldIterations"],
+            "coldSeconds": cold["coldSeconds"],
+        }
+        # Written last: an entry only counts once its json exists.
+        (d / f"{entry}.json").write_text(json.dumps(meta, indent=2), encoding="utf-8")
+
+        entries = self._entries(key)
+        for old in entries[:max(0, len(entries) - MAX_ENTRIES_PER_KEY)]:
+            old["path"].unlink(missing_ok=True)
+            old["path"].with_suffix(".json").unlink(missing_ok=True)
+        print(f"[WarmStart] Cached converged solution {entry} ({len(entries[-MAX_ENTRIES_PER_KEY:])} for this geometry)")
@@ -0,0 +1,193 @@
+"""
+Every collision kernel fluid_native supports (scalar / avx2 / avx512) has to
+match LbmD3Q19Torch.
+
+collide_block() runs on a random block of post-streaming populations with
+solid, inlet and outlet cells mixed in, and is compared against the torch
+solver's boundary -> macroscopic -> collide sequence on the same cells (and
+against a float32 numpy copy of it, which also runs without torch). Solid
+cells have to come out as they went in, with rho = 1 and u = 0: walls act on
+the links into them. The SIMD kernels do the scalar kernel's arithmetic in the
+same order, so differences stay at float32 rounding level (FMA contraction).
+
+The block cannot hold walls between cells, so a closed channel is also stepped
+by the torch solver and by both native lattices: all three bounce back
+half-way on wall links.
+
+Run from the backend folder:
+
+    python -m pytest tests
+"""
+from __future__ import annotations
+
+import numpy as np
+import pytest
+
+from sim.bitmask import as_bitmask
+from sim.domain_cache import LinkList
+from sim.lbm_native import NATIVE_AVAILABLE, fluid_native
+from sim.lbm_torch import TORCH_AVAILABLE, LbmD3Q19Torch, torch
+
+pytestmark = pytest.mark.skipif(not NATIVE_AVAILABLE, reason="fluid_native not built")
+needs_torch = pytest.mark.skipif(not TORCH_AVAILABLE, reason="torch not installed")
+
+ISAS = ["scalar", "avx2", "avx512"]
+OMEGA = 1.0 / (3.0 * 0.06 + 0.5)
+GRAVITY = np.array([2e-4, -1e-4, -3e-4], dtype=np.float32)
+INLET_SPEED = 0.05
+INLET_DIR = np.array([0.6, 0.0, -0.8], dtype=np.float32)
+CELLS = 10_003  # odd, so the SIMD kernels run their tails
+
+# Max abs difference allowed against the reference (populations ~ w_q ~ 0.03..0.33)
+TOLERANCE = 1e-6
+# Max abs velocity difference allowed between torch and a native lattice
+# after LINK_STEPS steps of the closed channel.
+LINK_TOLERANCE = 1e-5
+LINK_STEPS = 50
+
+
+def random_block(n: int, seed: int = 0):
+    """Populations near equilibrium plus noise, and per-cell masks (10% solid, 5% inlet, 5% outlet)."""
+    rng = np.random.default_rng(seed)
+    w = LbmD3Q19Torch._w_np.astype(np.float32)
+    f = (w[:, None] * (1.0 + 0.2 * rng.standard_normal((19, n)))).astype(np.float32)
+    kind = rng.random(n)
+    solid = kind < 0.10
+    inlet = (kind >= 0.10) & (kind < 0.15)
+    outlet = (kind >= 0.15) & (kind < 0.20)
+    return f, solid, inlet, outlet
+
+
+def native_collide(f, solid, inlet, outlet):
+    flags = (solid.astype(np.uint8) * 1) | (inlet.astype(np.uint8) * 2) | (outlet.astype(np.uint8) * 4)
+    d = INLET_DIR / np.linalg.norm(INLET_DIR)
+    return fluid_native.collide_block(
+        f, flags, OMEGA, GRAVITY.tolist(), (d * INLET_SPEED).astype(np.float32).tolist()
+    )
+
+
+def leave_solid(f_in, solid, f, rho, ux, uy, uz):
+    """What the kernel gives solid cells: their input populations, rho = 1 and u = 0."""
+    f = f.copy()
+    f[:, solid] = f_in[:, solid]
+    rho = np.where(solid, np.float32(1.0), rho)
+    ux, uy, uz = (np.where(solid, np.float32(0.0), u) for u in (ux, uy, uz))
+    return f, rho, ux, uy, uz
+
+
+def torch_reference(f, solid, inlet, outlet):
+    """Run the torch solver's per-cell phases on an (n, 1, 1) grid holding the block."""
+    n = f.shape[1]
+    # The block's cells are unrelated, so there are no wall links.
+    lbm = LbmD3Q19Torch(
+        nx=n, ny=1, nz=1, nu_lbm=0.06,
+        solid=solid.reshape(n, 1, 1), inlet=inlet.reshape(n, 1, 1), outlet=outlet.reshape(n, 1, 1),
+        gravity_lbm=GRAVITY,
+        wall_links=LinkList(offsets=np.zeros(20, dtype=np.int64), cells=np.zeros(0, dtype=np.int32)),
+    )
+    lbm.omega = OMEGA
+    lbm.set_inlet_direction(INLET_DIR)
+    lbm.f = torch.tensor(f.reshape(19, n, 1, 1), device=lbm.device)
+    lbm._apply_boundaries(inlet_speed=INLET_SPEED)
+    lbm._compute_macroscopic()
+    rho, ux, uy, uz = (t.reshape(n).cpu().numpy() for t in (lbm.rho, lbm.ux, lbm.uy, lbm.uz))
+    lbm._collide_with_forcing(inlet_speed=INLET_SPEED)
+    return leave_solid(f, solid, lbm.f.reshape(19, n).cpu().numpy(), rho, ux, uy, uz)
+
+
+def numpy_reference(f, solid, inlet, outlet):
+    """float32 numpy transcription of the same torch phases."""
+    c = LbmD3Q19Torch._c_np.astype(np.float32)
+    w = LbmD3Q19Torch._w_np.astype(np.float32)
+    cx, cy, cz = (c[:, k, None] for k in range(3))
+
+    def equilibrium(rho, ux, uy, uz):
+        usq = ux * ux + uy * uy + uz * uz
+        cu = cx * ux + cy * uy + cz * uz
+        return w[:, None] * rho * (1.0 + 3.0 * cu + 4.5 * cu * cu - 1.5 * usq)
+
+    f_in, f = f, f.copy()
+    d = INLET_DIR / np.linalg.norm(INLET_DIR)
+    u_in = [np.full(f.shape[1], np.float32(d[k] * INLET_SPEED)) for k in range(3)]
+    feq_in = equilibrium(np.float32(1.0), *u_in)
+    f[:, inlet] = feq_in[:, inlet]
+
+    rho = np.maximum(f.sum(axis=0), np.float32(1e-10))
+    ux = (f * cx).sum(axis=0) / rho + np.float32(0.5) * GRAVITY[0]
+    uy = (f * cy).sum(axis=0) / rho + np.float32(0.5) * GRAVITY[1]
+    uz = (f * cz).sum(axis=0) / rho + np.float32(0.5) * GRAVITY[2]
+    for u in (ux, uy, uz):
+        u[solid] = 0.0
+
+    omega = np.float32(OMEGA)
+    f = f - omega * (f - equilibrium(rho, ux, uy, uz))
+    cmu_g = (cx - ux) * GRAVITY[0] + (cy - uy) * GRAVITY[1] + (cz - uz) * GRAVITY[2]
+    cu = cx * ux + cy * uy + cz * uz
+    cg = cx * GRAVITY[0] + cy * GRAVITY[1] + cz * GRAVITY[2]
+    f = f + (np.float32(1.0) - np.float32(0.5) * omega) * w[:, None] * rho * (3.0 * cmu_g + 9.0 * cu * cg)
+    return leave_solid(f_in, solid, f.astype(np.float32), rho, ux, uy, uz)
+
+
+@pytest.fixture
+def kernel_isa():
+    """Select a kernel ISA for one test and restore the default after it."""
+    default = fluid_native.kernel_isa()
+
+    def select(isa: str):
+        if isa not in fluid_native.supported_kernel_isas():
+            pytest.skip(f"{isa} not supported here")
+        fluid_native.set_kernel_isa(isa)
+
+    yield select
+    fluid_native.set_kernel_isa(default)
+
+
+def assert_block_matches(got, want):
+    for name, a, b in zip(("f", "rho", "ux", "uy", "uz"), got, want):
+        np.testing.assert_allclose(np.asarray(a), b, rtol=0, atol=TOLERANCE, err_msg=name)
+
+
+@needs_torch
+@pytest.mark.parametrize("isa", ISAS)
+def test_collide_block_matches_torch(isa, kernel_isa):
+    kernel_isa(isa)
+    block = random_block(CELLS)
+    assert_block_matches(native_collide(*block), torch_reference(*block))
+
+
+@pytest.mark.parametrize("isa", ISAS)
+def test_collide_block_matches_numpy(isa, kernel_isa):
+    kernel_isa(isa)
+    block = random_block(CELLS)
+    assert_block_matches(native_collide(*block), numpy_reference(*block))
+
+
+def closed_channel(n: int = 32):
+    """bench_lbm's channel closed on every face, so no link wraps around the box."""
+    from bench.bench_lbm import synthetic_channel
+
+    solid, inlet, outlet, gravity = synthetic_channel(n)
+    solid[0] = solid[-1] = True
+    solid[:, :, -1] = True
+    return solid, inlet & ~solid, outlet & ~solid, gravity
+
+
+@needs_torch
+@pytest.mark.parametrize("sparse", [True, False], ids=["sparse", "dense"])
+def test_wall_links_match_torch(sparse):
+    solid, inlet, outlet, gravity = closed_channel()
+    nx, ny, nz = solid.shape
+    ref = LbmD3Q19Torch(nx=nx, ny=ny, nz=nz, nu_lbm=0.06, solid=solid, inlet=inlet, outlet=outlet,
+                        gravity_lbm=gravity)
+    ref.set_inlet_direction(INLET_DIR)
+    ref.run(LINK_STEPS, inlet_speed=INLET_SPEED)
+
+    masks = (as_bitmask(m).words for m in (solid, inlet, outlet))
+    e = fluid_native.LbmEngine(nx, ny, nz, 0.06, *masks, gravity.tolist(), sparse=sparse)
+    e.set_inlet_direction(INLET_DIR.tolist())
+    e.run(LINK_STEPS, INLET_SPEED, True)
+
+    fluid = ~solid
+    for name, want, got in zip(("ux", "uy", "uz"), (ref.ux, ref.uy, ref.uz), (e.ux(), e.uy(), e.uz())):
+        np.testing.assert_allclose(np.asarray(got)[fluid], np.asarray(want.cpu())[fluid],
+                                   rtol=0, atol=LINK_TOLERANCE, err_msg=name)
@@ -7,8 +7,8 @@ import type { OrbitControls as OrbitControlsImpl } from 'three-stdlib'
 import type { TransformControls as TransformControlsImpl } from 'three-stdlib'
 
 import './App.css'
-import { fetchRunResult, getRunStatus, startSimulation, type Quality, type RunStatus } from './api'
-import { parseNpz } from './npz'
+import { cancelRun, getRunStatus, startSimulation, type Quality, type RunStatus } from './api'
+import { FrameStream } from './frames'
 
 type Vec3 = [number, number, number]
 
@@ -384,6 +384,7 @@ export default function App() {
   const [flowGph, setFlowGph] = useState(200)
   const [quality, setQuality] = useState<Quality>('medium')
   const [status, setStatus] = useState<RunStatus | null>(null)
+  const [runId, setRunId] = useState<string | null>(null)
   const [particleFrames, setParticleFrames] = useState<{ data: Float32Array; shape: number[] } | null>(null)
   const [isPlaying, setIsPlaying] = useState(false)
   const [playbackSpeed, setPlaybackSpeed] = useState(1.0)
@@ -413,23 +414,26 @@ export default function App() {
       flowGph,
       quality,
     })
-      void runId
+    setRunId(runId)
 
+    // Frames are written in chunks while the particles are advected; start
+    // playing as soon as the first one is available.
+    const stream = new FrameStream(runId)
+    let framesShown = 0
     for (;;) {
       const s = await getRunStatus(runId)
       setStatus(s)
+      if (s.state === 'error' || s.state === 'cancelled') return
+      if ((s.stream?.framesReady ?? 0) > framesShown || s.state === 'done') {
+        const frames = await stream.update()
+        if (frames) {
+          framesShown = frames.shape[0]
+          setParticleFrames(frames)
+        }
+      }
       if (s.state === 'done') break
-      if (s.state === 'error') return
       await new Promise((r) => setTimeout(r, 800))
     }
-
-    const buf = await fetchRunResult(runId)
-    const npz = parseNpz(buf)
-    const frames = npz['frames']
-    if (!frames || !(frames.data instanceof Float32Array)) {
-      throw new Error('Result missing frames')
-    }
-    setParticleFrames({ data: frames.data, shape: frames.shape })
   }
 
   const gravityOptions: { value: typeof gravityPreset; label: string; desc: string }[] = [
@@ -557,6 +561,7 @@ export default function App() {
                 <span className={`status-value ${status.state}`}>
                   {status.state === 'done' ? '✓ Complete' : 
                    status.state === 'error' ? '✗ Error' :
+                   status.state === 'cancelled' ? '✗ Cancelled' :
                    status.state === 'running' ? '● Running' : '○ Queued'}
                 </span>
               </div>
@@ -566,6 +571,17 @@ export default function App() {
                     <div className="progress-fill" style={{ width: `${progressPct}%` }} />
                   </div>
                   <div className="progress-text">{status.message || `${progressPct}%`}</div>
+                  {runId && (
+                    <button className="btn btn-secondary" onClick={() => void cancelRun(runId)}>
+                      Cancel
+                    </button>
+                  )}
+                </div>
+              )}
+              {status.stream?.firstFrameSeconds !== undefined && (
+                <div className="progress-text">
+                  First frames after {status.stream.firstFrameSeconds.toFixed(1)}s
+                  {status.stream.totalSeconds !== undefined && ` of ${status.stream.totalSeconds.toFixed(1)}s`}
                 </div>
               )}
             </div>
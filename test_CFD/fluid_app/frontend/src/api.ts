@@ -1,12 +1,56 @@
 export type Quality = 'low' | 'medium' | 'high'
 
-export type RunState = 'queued' | 'running' | 'done' | 'error'
+export type RunState = 'queued' | 'running' | 'done' | 'error' | 'cancelled'
+
+export type Convergence = {
+  tolerance: number
+  checkEvery: number
+  maxIterations: number
+  iterations: number
+  converged: boolean
+  /** [iteration, residual] pairs; residual is null while the flow is at rest */
+  history: [number, number | null][]
+  /** Iteration a checkpointed run was resumed from */
+  resumedFrom?: number
+  /** Wall time of the LBM loop in seconds */
+  seconds?: number
+  /** Cached solutions the run started from (see backend sim/warm_start.py) */
+  warmStart?: {
+    entries: string[]
+    weights: number[]
+    coldIterations: number | null
+    coldSeconds: number | null
+  }
+}
+
+/** Partial results published while a run is in progress */
+export type ResultStream = {
+  /** LBM iteration of the coarse velocity preview (GET /api/run/{id}/preview) */
+  previewIteration?: number
+  /** Particle frames written so far (GET /api/run/{id}/frames) */
+  framesReady: number
+  nFrames: number
+  /** Seconds from the start of the run to the first playable frames */
+  firstFrameSeconds?: number
+  totalSeconds?: number
+}
+
+/** Place of a queued run in the scheduler (backend/sim/scheduler.py) */
+export type QueueInfo = {
+  position: number
+  length: number
+  etaSeconds: number
+  peakBytes: number
+}
 
 export type RunStatus = {
   state: RunState
   progress: number
   message: string
   traceback?: string
+  convergence?: Convergence
+  stream?: ResultStream
+  queue?: QueueInfo
 }
 
 export async function startSimulation(params: {
@@ -34,6 +78,14 @@ export async function startSimulation(params: {
   return (await res.json()) as { runId: string }
 }
 
+export async function cancelRun(runId: string): Promise<void> {
+  const res = await fetch(`/api/run/${encodeURIComponent(runId)}/cancel`, { method: 'POST' })
+  if (!res.ok) {
+    const text = await res.text()
+    throw new Error(`cancel failed (${res.status}): ${text}`)
+  }
+}
+
 export async function getRunStatus(runId: string): Promise<RunStatus> {
   const res = await fetch(`/api/run/${encodeURIComponent(runId)}/status`)
   if (!res.ok) {
@@ -51,3 +103,33 @@ export async function fetchRunResult(runId: string): Promise<ArrayBuffer> {
   }
   return await res.arrayBuffer()
 }
+
+/** Header and chunk index of a run's particle frames (backend sim/frame_archive.py) */
+export type FrameIndex = {
+  nFrames: number
+  nParticles: number
+  chunkFrames: number
+  /** Quantization box in mm */
+  lo: [number, number, number]
+  hi: [number, number, number]
+  /** Chunks written so far, in frame order */
+  chunks: { frames: number; bytes: number }[]
+}
+
+export async function fetchFrameIndex(runId: string): Promise<FrameIndex> {
+  const res = await fetch(`/api/run/${encodeURIComponent(runId)}/frames`)
+  if (!res.ok) {
+    const text = await res.text()
+    throw new Error(`frames failed (${res.status}): ${text}`)
+  }
+  return (await res.json()) as FrameIndex
+}
+
+export async function fetchFrameChunk(runId: string, chunk: number): Promise<ArrayBuffer> {
+  const res = await fetch(`/api/run/${encodeURIComponent(runId)}/frames/${chunk}`)
+  if (!res.ok) {
+    const text = await res.text()
+    throw new Error(`frame chunk failed (${res.status}): ${text}`)
+  }
+  return await res.arrayBuffer()
+}
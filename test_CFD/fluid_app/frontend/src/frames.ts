@@ -0,0 +1,63 @@
+import { unzlibSync } from 'fflate'
+
+import { fetchFrameChunk, fetchFrameIndex, type FrameIndex } from './api'
+
+/**
+ * Decode one chunk of particle frames: zlib, then the low bytes and the high
+ * bytes of 16-bit values. The chunk's first frame is absolute, the others are
+ * deltas to the previous frame (mod 2^16); values map linearly onto [lo, hi].
+ */
+export function decodeFrameChunk(payload: ArrayBuffer, index: FrameIndex, frames: number): Float32Array {
+  const planes = unzlibSync(new Uint8Array(payload))
+  const row = index.nParticles * 3
+  const n = frames * row
+  if (planes.length !== 2 * n) throw new Error('Frame chunk has the wrong size')
+
+  const low = planes.subarray(0, n)
+  const high = planes.subarray(n)
+  const lo = index.lo
+  const step = [0, 1, 2].map((k) => (index.hi[k] - index.lo[k]) / 65535)
+  const acc = new Uint16Array(row) // wraps mod 2^16 like the encoder
+  const out = new Float32Array(n)
+  for (let f = 0, i = 0; f < frames; f++) {
+    for (let j = 0; j < row; j++, i++) {
+      acc[j] += low[i] | (high[i] << 8)
+      const k = j % 3
+      out[i] = lo[k] + acc[j] * step[k]
+    }
+  }
+  return out
+}
+
+/**
+ * A run's frames, fetched chunk by chunk while the backend is still writing
+ * them. All chunks decode into one buffer sized for the whole run, so the
+ * array handed to the player keeps its identity as frames are added.
+ */
+export class FrameStream {
+  private readonly runId: string
+  private data: Float32Array | null = null
+  private chunksLoaded = 0
+  private framesLoaded = 0
+
+  constructor(runId: string) {
+    this.runId = runId
+  }
+
+  /** Fetch and decode the chunks written since the last call; null while there are none. */
+  async update(): Promise<{ data: Float32Array; shape: number[] } | null> {
+    const index = await fetchFrameIndex(this.runId)
+    const row = index.nParticles * 3
+    const data = this.data ?? (this.data = new Float32Array(index.nFrames * row))
+    const first = this.chunksLoaded
+    const fresh = index.chunks.slice(first)
+    const decoded = await Promise.all(
+      fresh.map(async (chunk, k) => decodeFrameChunk(await fetchFrameChunk(this.runId, first + k), index, chunk.frames)),
+    )
+    decoded.forEach((frames, k) => data.set(frames, (first + k) * index.chunkFrames * row))
+    this.chunksLoaded += fresh.length
+    this.framesLoaded += fresh.reduce((n, chunk) => n + chunk.frames, 0)
+    if (this.framesLoaded === 0) return null
+    return { data, shape: [this.framesLoaded, index.nParticles, 3] }
+  }
+}